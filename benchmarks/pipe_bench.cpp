@@ -0,0 +1,70 @@
+// Measures pipeline throughput with the kernel's default pipe size, a fixed larger size, and the
+// adaptive mode of CommandExecutor.
+//
+// Usage: RykeShellPipeBench [MiB] [stages] [fixed-size]
+//
+// The pipeline is `head -c N /dev/zero | cat | ... | cat > /dev/null`. Each cat moves data in
+// 128 KiB chunks, so with 64 KiB pipes every hop costs a context switch per half chunk.
+
+#include "ryke_shell.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace ryke;
+
+namespace {
+
+double runPipeline(const PipeSizing& sizing, long mebibytes, int stages) {
+    ShellOptions opts;
+    opts.monitor = false;
+    opts.pipeFusion = false; // the cat stages are the point of the exercise
+    opts.pipeSize = sizing;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+
+    Pipeline pipeline;
+    Command source;
+    source.args = {"head", "-c", std::to_string(mebibytes) + "M", "/dev/zero"};
+    pipeline.stages.push_back(source);
+    for (int i = 0; i < stages; ++i) {
+        Command relay;
+        relay.args = {"cat"};
+        pipeline.stages.push_back(relay);
+    }
+    pipeline.stages.back().outputFile = "/dev/null";
+
+    const auto start = std::chrono::steady_clock::now();
+    exec.execute({pipeline}, "head | cat");
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds > 0 ? static_cast<double>(mebibytes) / seconds : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const long mebibytes = argc > 1 ? std::atol(argv[1]) : 2048;
+    const int stages = argc > 2 ? std::atoi(argv[2]) : 3;
+    const auto fixed = parsePipeSizing(argc > 3 ? argv[3] : "1M");
+    if (mebibytes <= 0 || stages <= 0 || !fixed) {
+        std::cerr << "usage: RykeShellPipeBench [MiB] [stages] [fixed-size]\n";
+        return 2;
+    }
+
+    std::cout << "moving " << mebibytes << " MiB through " << stages << " cat stages (pipe-max-size "
+              << pipeMaxSize() << ")\n";
+    const std::vector<std::pair<std::string, PipeSizing>> runs{
+        {"default", PipeSizing{}},
+        {formatPipeSizing(*fixed), *fixed},
+        {"auto", PipeSizing{0, true}},
+    };
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto& [name, sizing] : runs) {
+        std::cout << std::left << std::setw(10) << name << runPipeline(sizing, mebibytes, stages) << " MiB/s\n";
+    }
+    return 0;
+}
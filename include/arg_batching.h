@@ -0,0 +1,48 @@
+#ifndef ARG_BATCHING_H
+#define ARG_BATCHING_H
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ryke {
+
+// Which commands may have an argument list that is too long for exec split into several runs,
+// xargs-style, and how many of those runs may go at once.
+struct ArgBatching {
+    bool all{false};                   // every external command
+    std::vector<std::string> commands; // otherwise only these, matched by basename
+    unsigned jobs{1};                  // runs in flight; 1 runs the chunks in order
+
+    [[nodiscard]] bool allows(const std::string& command) const;
+};
+
+// Accepts "all" or a comma-separated list of command names.
+bool parseArgBatching(const std::string& spec, ArgBatching& batching);
+std::string formatArgBatching(const ArgBatching& batching);
+
+// Bytes execve charges for a vector of strings: the text, its terminator and the pointer to it.
+std::size_t execBytes(const std::vector<std::string>& strings);
+std::size_t execBytes(char* const* strings);
+// Room left for arguments under ARG_MAX once the environment and some headroom are accounted for.
+std::size_t argumentBudget(char* const* envp);
+// The longest single argument the kernel takes (MAX_ARG_STRLEN).
+inline constexpr std::size_t kMaxArgumentLength = 32 * 4096;
+
+// Splits argv[fixed..size-trailing) into as few chunks as fit the budget, each led by argv[0..fixed)
+// and ended by the last `trailing` words. Returns nullopt when even one argument does not fit
+// next to the fixed ones.
+std::optional<std::vector<std::vector<std::string>>> splitArguments(const std::vector<std::string>& argv,
+                                                                    std::size_t fixed, std::size_t budget,
+                                                                    std::size_t trailing = 0);
+
+// Runs one process per chunk of `path`, at most `jobs` at a time, with the caller's stdio and
+// process group. Returns 0 when every run succeeded, 123 when one exited non-zero, 125 when one
+// was killed by a signal and 126/127 when one could not be started, following xargs.
+int runBatches(const std::string& path, const std::vector<std::vector<std::string>>& chunks,
+               char* const* envp, unsigned jobs);
+
+} // namespace ryke
+
+#endif //ARG_BATCHING_H
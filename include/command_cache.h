@@ -0,0 +1,70 @@
+#ifndef COMMAND_CACHE_H
+#define COMMAND_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ryke {
+
+// What a cached command produced.
+struct CachedResult {
+    int status{0};
+    std::string out;
+    std::string err;
+    std::time_t created{0};
+};
+
+// Memoized command output kept on disk, one file per key named by the key's digest. Entries are
+// evicted least recently used first once the directory grows past its byte cap; a hit refreshes
+// the entry's mtime, which is what the eviction order goes by. Hit and miss counts are kept in
+// the directory as well, so they add up across shells.
+class CommandCache {
+public:
+    struct Stats {
+        std::uint64_t hits{0};
+        std::uint64_t misses{0};
+        std::size_t entries{0};
+        std::uintmax_t bytes{0};
+    };
+
+    CommandCache(std::string directory, std::uintmax_t maxBytes);
+
+    // A result stored under the key and younger than `ttl` (0 never expires). Counts a hit or a miss.
+    std::optional<CachedResult> lookup(const std::string& key, std::chrono::seconds ttl);
+    // Writes the entry atomically, then evicts down to the cap. False when it could not be written.
+    bool store(const std::string& key, const CachedResult& result);
+    void clear();
+    [[nodiscard]] Stats stats() const;
+    void setMaxBytes(std::uintmax_t maxBytes);
+    [[nodiscard]] const std::string& directory() const;
+
+    // 128-bit hex digest of a key; the entry's file name.
+    static std::string digest(const std::string& key);
+
+private:
+    void count(bool hit) const;
+    void evict() const;
+
+    std::string directory_;
+    std::uintmax_t maxBytes_;
+};
+
+// Key material for one invocation: argv, the working directory, the named variables (nullopt when
+// unset) and each input file's size and mtime. Words are length-prefixed so no two argvs collide.
+std::string buildCacheKey(const std::vector<std::string>& argv, const std::string& cwd,
+                          const std::vector<std::pair<std::string, std::optional<std::string>>>& variables,
+                          const std::vector<std::string>& keyFiles);
+
+// Accepts seconds with an optional s, m, h or d suffix.
+std::optional<std::chrono::seconds> parseTtl(const std::string& spec);
+// Accepts a byte count with an optional K, M or G suffix.
+std::optional<std::uintmax_t> parseByteSize(const std::string& spec);
+
+} // namespace ryke
+
+#endif //COMMAND_CACHE_H
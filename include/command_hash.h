@@ -0,0 +1,48 @@
+#ifndef COMMAND_HASH_H
+#define COMMAND_HASH_H
+
+#include <ctime>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ryke {
+
+// Remembers where commands live on $PATH so launches skip the directory walk.
+// Entries are dropped when PATH changes or when a directory at or before the
+// one holding a command is modified, since that may add a shadowing executable.
+class CommandHash {
+public:
+    struct Entry {
+        std::string path;
+        std::size_t hits{0};
+        std::size_t dirIndex{0};
+        bool pinned{false}; // seeded with `hash -p`; never revalidated
+    };
+
+    std::optional<std::string> lookup(const std::string& name);
+    void remember(const std::string& name, const std::string& path);
+    bool forget(const std::string& name);
+    void clear();
+    [[nodiscard]] const std::unordered_map<std::string, Entry>& entries() const;
+
+private:
+    struct Directory {
+        std::string path;
+        timespec mtime{};
+        bool scanned{false};
+    };
+
+    void syncPath();
+    bool directoryChanged(std::size_t index);
+    std::optional<std::string> search(const std::string& name, std::size_t& dirIndex);
+
+    std::optional<std::string> pathValue_;
+    std::vector<Directory> directories_;
+    std::unordered_map<std::string, Entry> table_;
+};
+
+} // namespace ryke
+
+#endif //COMMAND_HASH_H
@@ -0,0 +1,58 @@
+#ifndef FD_WRITER_H
+#define FD_WRITER_H
+
+#include <cstddef>
+#include <memory>
+#include <streambuf>
+#include <vector>
+
+namespace ryke {
+
+// A stream buffer that writes straight to a descriptor through a large buffer, so the many small
+// `<<` writes of a builtin reach a file or pipe as a few big write(2) calls.
+class FdWriter : public std::streambuf {
+public:
+    static constexpr std::size_t kDefaultCapacity = 64 * 1024;
+
+    explicit FdWriter(int fd, std::size_t capacity = kDefaultCapacity);
+    ~FdWriter() override;
+
+    FdWriter(const FdWriter&) = delete;
+    FdWriter& operator=(const FdWriter&) = delete;
+
+    // Writes out everything buffered; false once a write has failed.
+    bool flush();
+    // errno of the first failed write, or 0. Output after a failure is dropped.
+    [[nodiscard]] int error() const;
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* data, std::streamsize count) override;
+    int sync() override;
+
+private:
+    bool writeAll(const char* data, std::size_t size);
+
+    int fd_;
+    std::vector<char> buffer_;
+    int error_{0};
+};
+
+// Sends std::cout through an FdWriter on stdout for the lifetime of the object, when stdout is not
+// a terminal. Interactive output stays on std::cout's own buffering so prompts still appear.
+class ScopedStdoutWriter {
+public:
+    ScopedStdoutWriter();
+    ~ScopedStdoutWriter();
+
+    ScopedStdoutWriter(const ScopedStdoutWriter&) = delete;
+    ScopedStdoutWriter& operator=(const ScopedStdoutWriter&) = delete;
+
+private:
+    std::streambuf* previous_{nullptr};
+    std::unique_ptr<FdWriter> writer_;
+};
+
+} // namespace ryke
+
+#endif //FD_WRITER_H
@@ -0,0 +1,33 @@
+#ifndef FILE_COPY_H
+#define FILE_COPY_H
+
+#include <cstdint>
+#include <string>
+
+namespace ryke {
+
+// How copyFd moved the data, fastest first.
+enum class CopyMethod { CopyFileRange, Sendfile, Splice, ReadWrite };
+
+struct CopyResult {
+    int error{0}; // errno of the failure, or 0
+    std::uint64_t bytes{0};
+    CopyMethod method{CopyMethod::ReadWrite}; // the method that moved the last bytes
+};
+
+// Copies everything from `in`'s current position to `out` inside the kernel when it allows it:
+// copy_file_range between regular files (which shares extents on filesystems with reflinks),
+// sendfile from a regular file to anything else, splice when either side is a pipe. Otherwise, and
+// for files whose size says nothing (procfs), data goes through a page-aligned read/write buffer.
+// A terminal on `in` is polled before each read, so a Ctrl-C the shell catches ends the copy with
+// EINTR rather than leaving a restarted read waiting.
+CopyResult copyFd(int in, int out);
+
+// Copies `from` to `to` as cp does: a new file gets from's permission bits less the umask, an
+// existing one is truncated and keeps its own. `force` removes a destination that cannot be opened
+// and tries again; `preserve` carries over mode, ownership and timestamps as well.
+bool copyFile(const std::string& from, const std::string& to, bool force, bool preserve, std::string& error);
+
+} // namespace ryke
+
+#endif //FILE_COPY_H
@@ -0,0 +1,55 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ryke {
+
+// A path, directory or glob to watch, split into the directory inotify watches and the pattern an
+// event's file name has to match there (empty matches everything).
+struct WatchSpec {
+    std::string directory;
+    std::string pattern;
+    bool recursive{false}; // subdirectories too, including ones created later
+};
+
+// `src/*.cpp` watches src for *.cpp, `src/**/*.h` watches src and below for *.h, a directory watches
+// everything in it, and a plain file watches its directory for that name, so editors that replace
+// the file by renaming a new one over it are still seen.
+WatchSpec parseWatchSpec(const std::string& word, bool recursive);
+
+// Change notifications for a set of WatchSpecs through one inotify descriptor.
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool add(const WatchSpec& spec, std::string& error);
+    // Non-blocking; readable when events are pending. -1 when inotify is unavailable.
+    [[nodiscard]] int fd() const;
+    // Reads whatever events are pending and returns the paths that match a spec. New directories
+    // under a recursive spec are watched from here on. An event queue overflow reports the
+    // watched directories themselves, since any of them may have changed.
+    std::vector<std::string> drain();
+
+private:
+    struct Watched {
+        std::string directory;
+        std::vector<std::size_t> specs;
+    };
+
+    bool watchDirectory(const std::string& directory, std::size_t spec, std::string& error);
+
+    int fd_{-1};
+    std::vector<WatchSpec> specs_;
+    std::unordered_map<int, Watched> watches_;
+};
+
+} // namespace ryke
+
+#endif //FILE_WATCHER_H
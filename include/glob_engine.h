@@ -0,0 +1,76 @@
+#ifndef GLOB_ENGINE_H
+#define GLOB_ENGINE_H
+
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ryke {
+
+struct GlobOptions {
+    bool nullglob{false}; // a pattern without matches expands to nothing instead of itself
+    bool dotglob{false};  // wildcards match names starting with '.'
+    bool nosort{false};   // keep directory order instead of sorting the matches
+};
+
+// Expands glob patterns in the shell process: `*`, `?`, `[...]` and a `**` segment that matches
+// any number of directories. Entry types come from readdir's d_type, so files are never stat'ed
+// and only symlinks or filesystems without d_type cost an extra call. Directory listings are
+// cached by device and inode against the directory's mtime, and `**` walks wide trees level by
+// level on a few threads.
+class GlobEngine {
+public:
+    explicit GlobEngine(unsigned walkThreads = 0); // 0 picks the number of online CPUs
+
+    GlobEngine(const GlobEngine&) = delete;
+    GlobEngine& operator=(const GlobEngine&) = delete;
+
+    // Appends the matches of pattern to out, or the pattern itself when nothing matches and
+    // nullglob is off. Returns the number of matches.
+    std::size_t expand(const std::string& pattern, const GlobOptions& options, std::vector<std::string>& out);
+    static bool hasMagic(const std::string& word);
+
+    [[nodiscard]] std::size_t cachedDirectories() const;
+    void clearCache();
+
+private:
+    struct Entry {
+        std::string name;
+        unsigned char type; // DT_* from readdir
+    };
+    struct Listing {
+        timespec mtime{};
+        std::vector<Entry> entries;
+    };
+    // A directory's identity, not the path it was reached by: `sub` means another directory after a cd.
+    struct DirectoryKey {
+        dev_t device;
+        ino_t inode;
+        bool operator==(const DirectoryKey&) const = default;
+    };
+    struct DirectoryKeyHash {
+        std::size_t operator()(const DirectoryKey& key) const {
+            return std::hash<ino_t>{}(key.inode) * 31 + std::hash<dev_t>{}(key.device);
+        }
+    };
+
+    std::shared_ptr<const Listing> list(const std::string& dir);
+    bool isDirectory(const std::string& dir, const Entry& entry, bool followLinks) const;
+    void matchSegment(const std::vector<std::string>& bases, const std::string& segment, bool needDirectory,
+                      const GlobOptions& options, std::vector<std::string>& out);
+    std::vector<std::string> directoryTree(const std::vector<std::string>& roots, const GlobOptions& options);
+    void subdirectories(const std::string& dir, const GlobOptions& options, std::vector<std::string>& out);
+
+    unsigned walkThreads_;
+    mutable std::mutex mutex_;
+    std::unordered_map<DirectoryKey, std::shared_ptr<const Listing>, DirectoryKeyHash> cache_;
+};
+
+} // namespace ryke
+
+#endif //GLOB_ENGINE_H
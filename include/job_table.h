@@ -0,0 +1,114 @@
+#ifndef JOB_TABLE_H
+#define JOB_TABLE_H
+
+#include "pipe_stats.h"
+#include "resource_limits.h"
+
+#include <chrono>
+#include <csignal>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ryke {
+
+// Resources consumed by a job's processes. Counters are summed across pipeline stages; max RSS
+// is that of the largest stage.
+struct ResourceUsage {
+    double wallSeconds{0};
+    double userSeconds{0};
+    double systemSeconds{0};
+    long maxRssKb{0};
+    long voluntarySwitches{0};
+    long involuntarySwitches{0};
+    long blockInputs{0};
+    long blockOutputs{0};
+
+    void add(const rusage& usage);
+};
+
+// What `time` prints unless -f, -p or $TIME say otherwise, and the usage line in `jobs -l`.
+inline constexpr const char* kDefaultUsageFormat =
+    "%es real  %Us user  %Ss sys  %MKB maxrss  %w/%c ctxsw  %I/%O blocks";
+
+// Expands GNU time(1) directives: %e %E %U %S %P %M %w %c %I %O %x %C, plus %% and \n, \t.
+std::string formatResourceUsage(const std::string& format, const ResourceUsage& usage,
+                                const std::string& command, int exitStatus);
+
+struct Job {
+    enum class Status {
+        Running,
+        Stopped,
+        Done
+    };
+
+    struct Process {
+        pid_t pid{-1};
+        int pidfd{-1}; // -1 when pidfd_open is unavailable; waits then fall back to P_PID
+        Status status{Status::Running};
+        int exitCode{0}; // exit status, 128+signal when killed, 128+stop signal while stopped
+        int termSignal{0}; // signal that killed the process, 0 when it exited
+    };
+
+    int id{};
+    pid_t pgid{};
+    std::string command;
+    Status status{Status::Running};
+    int exitCode{0};
+    std::vector<Process> processes;
+    std::chrono::steady_clock::time_point started{std::chrono::steady_clock::now()};
+    ResourceUsage usage; // covers processes that have exited; wall time is set once the job is Done
+    std::string coproc;        // coprocess name; empty for ordinary jobs
+    std::vector<int> heldFds;  // shell-side descriptors owned by the job, closed on release
+    std::vector<ResourceLimit> limits; // `ulimit ... cmd` prefix the job was started with
+    std::string limitHit;              // the resource limit that killed one of its processes, if any
+    std::shared_ptr<const PipeStats> pipeStats; // relay counters under `set -o pipestats`, else null
+};
+
+// Owns the shell's jobs and the pidfds of their processes. Jobs are indexed by id and every
+// live process by pid, so reaping a child and resolving `%n` never scan the table.
+class JobTable {
+public:
+    JobTable() = default;
+    ~JobTable();
+
+    JobTable(const JobTable&) = delete;
+    JobTable& operator=(const JobTable&) = delete;
+
+    // Builds an unregistered job and opens a pidfd for each process.
+    static Job makeJob(pid_t pgid, std::string command, const std::vector<pid_t>& pids);
+    static void release(Job& job);
+
+    // Registers the job under its id, or under the next free id when it has none.
+    Job& add(Job job);
+    // Hands out an id now for a job that is registered later, such as one waiting in a queue.
+    int reserveId();
+    Job* find(int id);
+    Job* findByPid(pid_t pid);
+    Job* current(); // the most recently started job that is still around
+    [[nodiscard]] std::vector<const Job*> ordered() const;
+    [[nodiscard]] std::size_t size() const;
+
+    // Blocks until every process of the job has finished or one of them stops.
+    void wait(Job& job);
+    // Collects exits of the job's processes without blocking; true once all have exited.
+    bool poll(Job& job);
+    // Collects pending state changes without blocking; returns the ids of jobs that finished.
+    std::vector<int> reap();
+    std::vector<Job> pruneDone(); // returns the released jobs
+
+private:
+    void apply(Job& job, Job::Process& process, const siginfo_t& info, const rusage& usage);
+    static void refresh(Job& job);
+
+    std::unordered_map<int, Job> jobs_;
+    std::unordered_map<pid_t, int> jobByPid_;
+    int nextId_{1};
+};
+
+} // namespace ryke
+
+#endif //JOB_TABLE_H
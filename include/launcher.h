@@ -0,0 +1,50 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <functional>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace ryke {
+
+// A descriptor operation replayed in the child, in order, before exec.
+struct FdAction {
+    int source{-1};
+    int target{-1};
+};
+
+struct SpawnRequest {
+    std::string path;                 // executable; searched in PATH when it contains no '/'
+    std::vector<std::string> argv;
+    pid_t pgid{0};                    // 0 starts a new process group led by the child
+    int terminalFd{-1};               // hand the terminal to the new group from the child when >= 0
+    std::vector<FdAction> fdActions;
+    char* const* envp{nullptr};       // environment for exec; nullptr passes the shell's environ
+    std::function<void()> childSetup; // work only a forked child can do; forces the fork engine
+    std::function<int()> childMain;   // run in the forked child instead of exec; returns its exit status
+};
+
+enum class SpawnEngine {
+    PosixSpawn,
+    Fork
+};
+
+struct SpawnResult {
+    pid_t pid{-1};
+    int error{0}; // errno of the failed launch step when pid == -1
+};
+
+// Starts a process described by the request. Exec failures are reported to the
+// caller through SpawnResult::error with either engine, so the parent can print
+// diagnostics without waiting on a child that never ran.
+SpawnResult spawnProcess(const SpawnRequest& request, SpawnEngine engine);
+
+// Replaces the calling process with the request's command, after the same descriptor, setup and
+// signal handling a forked child gets. The process group and terminal are left as they are.
+// Returns only when exec fails, with its errno; the descriptor actions have been applied by then.
+int execInPlace(const SpawnRequest& request);
+
+} // namespace ryke
+
+#endif //LAUNCHER_H
@@ -0,0 +1,44 @@
+#ifndef PIPE_STATS_H
+#define PIPE_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ryke {
+
+// Counters of one relay between two stages. Written by the relay thread, read by whoever reports
+// on the job, so every field is atomic and a report of a live job is a consistent-enough snapshot.
+struct LinkStats {
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::int64_t> starvedNs{0}; // waiting for the upstream stage to write
+    std::atomic<std::int64_t> blockedNs{0}; // waiting for the downstream stage to read
+    std::atomic<std::int64_t> starvedSinceNs{0}; // start of a starved wait still in progress, else 0
+    std::atomic<std::int64_t> blockedSinceNs{0}; // start of a blocked wait still in progress, else 0
+    std::atomic<std::int64_t> startNs{0};   // steady clock
+    std::atomic<std::int64_t> endNs{0};     // 0 while the relay runs
+};
+
+// Throughput of a pipeline run under `set -o pipestats`: link i carries the output of stage i.
+struct PipeStats {
+    std::vector<std::string> stages; // command text of each stage
+    std::deque<LinkStats> links;     // a deque, so links keep their address as more are added
+};
+
+// Moves everything from `input` to `output` with splice(2) on a shell thread, counting the bytes
+// and the time spent waiting on either side. Owns both descriptors and closes them when the
+// upstream stage reaches EOF or the downstream one stops reading.
+std::thread startRelay(int input, int output, std::shared_ptr<PipeStats> stats, std::size_t link);
+
+// One line per stage: bytes passed on, MB/s over the link's lifetime, and the share of that time
+// the relay was starved by the stage (it is slow) or held back by the next one (that one is slow).
+std::string formatPipeStats(const PipeStats& stats, const std::string& indent);
+
+} // namespace ryke
+
+#endif //PIPE_STATS_H
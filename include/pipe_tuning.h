@@ -0,0 +1,57 @@
+#ifndef PIPE_TUNING_H
+#define PIPE_TUNING_H
+
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+namespace ryke {
+
+// Capacity requested for the pipes of a pipeline. Larger pipes let a fast producer run ahead of
+// its consumer instead of being switched out every 64 KiB.
+struct PipeSizing {
+    long bytes{0};        // F_SETPIPE_SZ target; 0 keeps the kernel default
+    bool adaptive{false}; // grow a pipe each time its writer fills it, up to pipe-max-size
+};
+
+// Accepts "default", "auto", or a byte count with an optional K, M or G suffix.
+std::optional<PipeSizing> parsePipeSizing(const std::string& spec);
+std::string formatPipeSizing(const PipeSizing& sizing);
+
+// /proc/sys/fs/pipe-max-size, read once; 1 MiB when it cannot be read.
+long pipeMaxSize();
+// Sets the capacity of a pipe, clamped to pipe-max-size. Returns the resulting capacity, or -1.
+long resizePipe(int fd, long bytes);
+
+// Watches pipes on behalf of a running pipeline and doubles the capacity of any pipe found full,
+// which is when its writer blocks. Each pipe is watched through a duplicate of its read end that
+// is dropped as soon as the reading process exits, so writers still get EPIPE.
+class PipeGrower {
+public:
+    PipeGrower() = default;
+    ~PipeGrower();
+
+    PipeGrower(const PipeGrower&) = delete;
+    PipeGrower& operator=(const PipeGrower&) = delete;
+
+    // Keeps a duplicate of readFd until the process behind readerPid is gone.
+    void watch(int readFd, pid_t readerPid);
+    // Resolves reader pids to pidfds and hands the pipes to a watcher thread, which returns once
+    // every reader has exited. The caller joins it with the pipeline; not joinable when there was
+    // nothing to watch. Must run before the readers are reaped.
+    [[nodiscard]] std::thread start();
+
+private:
+    struct Watched {
+        int readFd{-1};
+        pid_t readerPid{-1};
+    };
+
+    std::vector<Watched> pending_;
+};
+
+} // namespace ryke
+
+#endif //PIPE_TUNING_H
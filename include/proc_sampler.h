@@ -0,0 +1,68 @@
+#ifndef PROC_SAMPLER_H
+#define PROC_SAMPLER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ryke {
+
+// One process group at the last sample, summed over the processes alive in it.
+struct GroupSample {
+    pid_t pgid{};
+    std::size_t processes{0};
+    long threads{0};
+    double cpuPercent{0}; // of one CPU since the previous sample, so two busy CPUs read 200
+    std::uint64_t rssBytes{0};
+    std::uint64_t readBytes{0};  // storage I/O of the live processes (/proc/<pid>/io)
+    std::uint64_t writeBytes{0};
+};
+
+// Samples /proc for every process in a set of process groups. A process's stat, statm and io files
+// are opened once and re-read with pread, and processes outside the groups are remembered and not
+// opened again, so a refresh costs one directory scan plus three reads per watched process.
+class ProcSampler {
+public:
+    explicit ProcSampler(std::string procRoot = "/proc");
+    ~ProcSampler();
+
+    ProcSampler(const ProcSampler&) = delete;
+    ProcSampler& operator=(const ProcSampler&) = delete;
+
+    // One entry per group of `pgids`, in that order. CPU use is measured from the previous call;
+    // a process seen for the first time contributes none until the next one.
+    std::vector<GroupSample> sample(const std::vector<pid_t>& pgids);
+    [[nodiscard]] std::size_t tracked() const;
+
+private:
+    struct Tracked {
+        int stat{-1};
+        int statm{-1};
+        int io{-1}; // -1 when the process's io file is not readable to us
+        pid_t pgid{};
+        std::uint64_t cpuTicks{0};
+    };
+
+    bool refresh(Tracked& process, GroupSample* group, double elapsedTicks);
+    void forget(pid_t pid);
+
+    std::string procRoot_;
+    std::unordered_map<pid_t, Tracked> tracked_;
+    std::unordered_set<pid_t> foreign_; // in no watched group the last time they were looked at
+    std::vector<pid_t> lastGroups_;
+    std::chrono::steady_clock::time_point lastSample_{};
+    long ticksPerSecond_;
+    long pageSize_;
+};
+
+// The `jobtop` table: a header and one row per job.
+std::string formatJobTopHeader();
+std::string formatJobTopRow(int jobId, const GroupSample& sample, const std::string& status, const std::string& command);
+
+} // namespace ryke
+
+#endif //PROC_SAMPLER_H
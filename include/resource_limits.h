@@ -0,0 +1,58 @@
+#ifndef RESOURCE_LIMITS_H
+#define RESOURCE_LIMITS_H
+
+#include <optional>
+#include <span>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+namespace ryke {
+
+// A limit `ulimit` knows by its option letter. Values are given and shown in `unit` bytes (or
+// seconds, or a plain count when unit is 1).
+struct LimitSpec {
+    char flag;
+    int resource;
+    const char* description;
+    const char* unitName;
+    rlim_t unit;
+};
+
+std::span<const LimitSpec> limitSpecs();
+const LimitSpec* findLimit(char flag);
+
+// A new soft and/or hard value for one resource; an unset side keeps its current value.
+struct ResourceLimit {
+    int resource{};
+    std::optional<rlim_t> soft;
+    std::optional<rlim_t> hard;
+};
+
+// What a run of `ulimit` option words asks for.
+struct UlimitRequest {
+    std::vector<ResourceLimit> set;
+    std::vector<const LimitSpec*> show;
+    bool all{false};
+    bool hard{false}; // -H: show or set hard limits
+    bool soft{false}; // -S: show or set soft limits; neither flag sets both and shows soft
+};
+
+// Reads options such as `-S -n 1024 -tv 10 unlimited` from words[index] on, and stops at the
+// first word that is neither an option nor a limit value. `hard` and `soft` as values resolve
+// against the calling process. On a bad option or value, returns nullopt and fills `error`.
+std::optional<UlimitRequest> parseUlimit(const std::vector<std::string>& words, std::size_t& index, std::string& error);
+
+std::string formatLimit(rlim_t value, const LimitSpec& spec);
+
+// Applies limits to the calling process. Returns 0 or the errno of the first limit refused; the
+// rest are still attempted. Safe between fork and exec: it neither allocates nor locks.
+int applyResourceLimits(const std::vector<ResourceLimit>& limits);
+
+// The resource limit that most likely ended a process killed by `signal`, given the limits its
+// job was started with on top of the shell's own; empty when no limit accounts for the signal.
+std::string describeLimitHit(int signal, const std::vector<ResourceLimit>& jobLimits);
+
+} // namespace ryke
+
+#endif //RESOURCE_LIMITS_H
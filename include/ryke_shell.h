@@ -1,6 +1,15 @@
 #ifndef RYKE_SHELL_H
 #define RYKE_SHELL_H
 
+#include "arg_batching.h"
+#include "command_hash.h"
+#include "glob_engine.h"
+#include "job_table.h"
+#include "pipe_tuning.h"
+#include "sched_attrs.h"
+#include "variable_store.h"
+
+#include <cstdint>
 #include <deque>
 #include <functional>
 #include <map>
@@ -11,6 +20,7 @@
 #include <ctime>
 #include <sys/types.h>
 #include <termios.h>
+#include <thread>
 #include <vector>
 
 namespace ryke {
@@ -22,6 +32,7 @@ enum class ChainCondition {
 };
 
 struct Command {
+    std::vector<std::pair<std::string, std::string>> assignments; // leading NAME=value words
     std::vector<std::string> args;
     std::optional<std::string> inputFile;
     std::optional<std::string> outputFile;
@@ -36,17 +47,40 @@ struct Command {
     bool heredocExpand{true};
     struct FdRedirection {
         int fd{1};
-        enum class Type { Truncate, Append, Dup } type{Type::Truncate};
-        std::string target; // file path for Truncate/Append
+        enum class Type { Truncate, Append, Dup, Read } type{Type::Truncate};
+        std::string target; // file path for Truncate/Append/Read
         int dupFd{1};       // target fd for Dup
     };
     std::vector<FdRedirection> fdRedirections;
+    // `<(cmd)` / `>(cmd)`: started alongside the stage and handed to it as a /dev/fd/N path.
+    struct ProcessSubstitution {
+        std::string command;            // text between the parentheses
+        bool output{false};             // >(cmd): cmd reads what the stage writes to the path
+        std::optional<std::size_t> arg; // index into args; unset when it is the target of `<`, `>` or `>>`
+    };
+    std::vector<ProcessSubstitution> processSubstitutions;
 };
 
 struct Pipeline {
     std::vector<Command> stages;
     ChainCondition condition{ChainCondition::None}; //Relation to the previous pipeline
     bool background{false};
+    std::optional<std::string> coproc; // coprocess name; its fds are published as NAME[0] (read) and NAME[1] (write)
+    std::optional<PipeSizing> pipeSize; // `pipesize SPEC pipeline`; overrides the pipesize option
+    std::optional<SchedAttrs> sched;    // `sched -c/-n/-i/-p ... pipeline`; layered over the set -o defaults
+    std::vector<ResourceLimit> limits;  // `ulimit -X N ... pipeline`; set in each child only
+};
+
+// Shell-held descriptors a pipeline is wired to instead of the shell's own stdio.
+// Stage redirections still take precedence over them.
+struct PipelineIo {
+    int input{-1};            // stdin of the first stage
+    int output{-1};           // stdout of the last stage
+    int error{-1};            // stderr of every stage
+    bool inheritGroup{false}; // keep stages in the caller's process group and leave the terminal alone
+    pid_t group{0};           // process group to join instead; 0 keeps the choice above
+    bool replaceShell{false}; // exec a lone external command in place of the shell instead of forking
+    std::shared_ptr<const Environment> environment; // exported variables to launch with; null takes the current ones
 };
 
 class History {
@@ -102,6 +136,18 @@ struct ShellOptions {
     bool historyIgnoreDups{true};
     bool historyIgnoreSpace{true};
     bool noglob{false};
+    bool nullglob{false};
+    bool dotglob{false};
+    bool nosort{false};    // leave glob matches in directory order
+    bool posixSpawn{true}; // launch stages with posix_spawn; fork() stays as the fallback engine
+    bool pipeFusion{true}; // fold `cat FILE |` and `| cat > FILE` stages into plain redirections
+    bool pipeStats{false}; // relay every inter-stage pipe through the shell and report per-stage throughput
+    bool tailExec{true};   // exec the last command of a script or -c string instead of forking it
+    unsigned maxJobs{0};   // background jobs allowed to run at once; later ones queue. 0 is no limit
+    std::uintmax_t cacheSize{64 * 1024 * 1024}; // byte cap of the `cache` store before LRU eviction
+    PipeSizing pipeSize;   // capacity of inter-stage and heredoc pipes
+    SchedAttrs sched;      // cpus/nice/ioprio/sched given to every launched job
+    ArgBatching argBatch;  // commands whose oversized argument lists run in E2BIG-safe batches
 };
 
 class Terminal {
@@ -154,53 +200,107 @@ private:
     struct Token {
         std::string text;
         bool quoted{false};
+        char substitution{0}; // '<' or '>' when the token is a whole `<(...)` / `>(...)`
     };
     [[nodiscard]] std::vector<Token> tokenize(const std::string& input) const;
     [[nodiscard]] std::vector<Token> expandBraces(const std::vector<Token>& tokens) const;
     [[nodiscard]] std::string unescape(const std::string& token) const;
 };
 
-struct Job {
-    enum class Status {
-        Running,
-        Stopped,
-        Done
-    };
-
-    int id{};
-    pid_t pgid{};
-    std::string command;
-    Status status{Status::Running};
-    int exitCode{0};
+// A pipeline whose processes have been started but not yet waited for.
+struct LaunchedPipeline {
+    Job job;                            // unregistered; its processes carry pidfds
+    std::optional<int> lastStageStatus; // set when the last stage left no process to wait for
+    std::vector<std::thread> heredocWriters; // shell threads serving the job: heredoc writers, pipestats relays, the pipe grower
+    bool monitor{false};
 };
 
 class CommandExecutor {
 public:
+    // How the executor reaches the shell's builtins without depending on the registry.
+    struct BuiltinHooks {
+        std::function<bool(const std::string& name)> contains;
+        std::function<int(const Command& command)> run;
+        // False hands a builtin's name to the external program instead (an option it lacks). Optional.
+        std::function<bool(const Command& command)> accepts{};
+        // True for builtins that leave the shell's state alone; `$(...)` runs only those in the shell itself.
+        std::function<bool(const Command& command)> readOnly{};
+    };
+
     CommandExecutor(pid_t shellPgid, int terminalFd, const ShellOptions* options,
                     std::function<void(const std::string&)> notifier);
 
-    int execute(const std::vector<Pipeline>& pipelines, const std::string& commandLine);
+    int execute(const std::vector<Pipeline>& pipelines, const std::string& commandLine, const PipelineIo& io = {});
+    // Starts a pipeline without waiting for it. A background pipeline runs even a builtin last
+    // stage in a child, so the call never blocks on the stages themselves.
+    LaunchedPipeline launch(const Pipeline& pipeline, const std::string& commandLine, const PipelineIo& io = {});
+    bool poll(LaunchedPipeline& launched); // true once every process has exited; never blocks
+    int finish(LaunchedPipeline& launched);
+    int capture(const std::vector<Pipeline>& pipelines, const std::string& commandLine, std::string& output);
+    int captureOutput(const std::function<int(int fd)>& producer, std::string& output);
     void reapBackground();
+    // Starts queued background jobs in the slots finished jobs have freed. Finished jobs are
+    // collected but not reported, so it is safe while the line editor is waiting for input.
+    void dispatchQueued();
+    // Blocks until every queued job has started, each as a running job exits.
+    void drainQueue();
+    // For a forked copy of the shell: drops the queued jobs inherited from the parent, which
+    // starts them itself, so running a command in the copy never dispatches them twice.
+    void forgetQueue() { queue_.clear(); }
+    // True while any job, stopped, running or queued, is still tracked after a reap.
+    bool hasJobs();
     void listJobs(std::ostream& os, bool verbose = false);
+    // Running and stopped jobs. Finished ones are collected but left for the prompt to report, so
+    // a monitor can call this on every refresh without printing over its own display.
+    std::vector<const Job*> liveJobs();
+    void listCoprocs(std::ostream& os);
     bool foregroundJob(int jobId);
     bool backgroundJob(int jobId);
+    // Applies scheduling attributes to a live job; nullopt when there is no such job, else 0 or an errno.
+    std::optional<int> rescheduleJob(int jobId, const SchedAttrs& attrs);
     void stopForeground();
+    CommandHash& commandHash();
+    GlobEngine& globber();
+    void setBuiltinHooks(BuiltinHooks hooks);
+    // Resources used by the most recent foreground pipeline, summed across its stages.
+    [[nodiscard]] const ResourceUsage& lastUsage() const;
 
 private:
-    int executePipeline(const Pipeline& pipeline, const std::string& commandLine);
+    // A background pipeline held back by `set -o maxjobs=N`, with the job id it will run under.
+    struct QueuedJob {
+        int id;
+        Pipeline pipeline;
+        std::string commandLine;
+        PipelineIo io;           // carries the environment exported when the job was submitted
+        std::string directory;   // working directory when it was submitted
+    };
+
+    int executePipeline(const Pipeline& pipeline, const std::string& commandLine, const PipelineIo& io);
+    [[nodiscard]] bool changesShell(const std::vector<Pipeline>& pipelines) const;
+    int startBackground(const Pipeline& pipeline, const std::string& commandLine, const PipelineIo& io,
+                        int id, bool announce);
+    void collectFinished();
+    int startQueued(QueuedJob& queued);
+    [[nodiscard]] std::size_t runningJobs() const;
+    int settle(LaunchedPipeline& launched);
+    int startCoproc(const Pipeline& pipeline, const std::string& commandLine);
+    void pruneJobs();
     void adoptTerminal(pid_t pgid);
     void restoreTerminal();
-    Job* findJob(int jobId);
-    Job* lastJob();
-    void pruneDone();
+    Job* resolveJob(int jobId);
 
     pid_t shellPgid_{};
     int terminalFd_{};
     const ShellOptions* options_{};
     std::function<void(const std::string&)> notify_;
     pid_t currentFgPgid_{0};
-    std::vector<Job> jobs_;
-    int nextJobId_{1};
+    JobTable jobs_;
+    std::deque<QueuedJob> queue_; // FIFO; the front starts first
+    std::vector<int> finished_;   // ids of jobs reaped but not yet reported
+    CommandHash commandHash_;
+    GlobEngine globber_;
+    BuiltinHooks builtins_;
+    ResourceUsage lastUsage_;
 };
 
 class Shell;
@@ -208,13 +308,22 @@ class Shell;
 class BuiltinCommand {
 public:
     virtual ~BuiltinCommand() = default;
-    virtual void run(const Command& command, Shell& shell) = 0;
+    virtual int run(const Command& command, Shell& shell) = 0; // returns the exit status
+    // Builtins that stand in for an external program return false for what only the program can do.
+    [[nodiscard]] virtual bool accepts(const Command&) const { return true; }
+    // True when running it cannot change the shell (cwd, variables, options, jobs, exit), so a
+    // command substitution may run it in the shell rather than in a forked subshell.
+    [[nodiscard]] virtual bool readOnly() const { return false; }
 };
 
 class CommandRegistry {
 public:
     void registerCommand(const std::string& name, std::unique_ptr<BuiltinCommand> handler);
-    bool tryHandle(const Command& command, Shell& shell) const;
+    std::optional<int> tryHandle(const Command& command, Shell& shell) const;
+    [[nodiscard]] bool contains(const std::string& name) const;
+    // Whether the shell runs this command itself: a builtin of that name that accepts its arguments.
+    [[nodiscard]] bool handles(const Command& command) const;
+    [[nodiscard]] bool readOnly(const Command& command) const;
 
 private:
     std::map<std::string, std::unique_ptr<BuiltinCommand>> handlers_;
@@ -227,15 +336,18 @@ public:
 
     std::string readLine();
     int interactiveListSelection(const std::vector<std::string>& items, const std::string& prompt);
+    // Called whenever a signal interrupts the wait for the next key.
+    void setIdleHandler(std::function<void()> handler);
 
 private:
     Terminal& terminal_;
     History& history_;
     const AutocompleteEngine& autocomplete_;
     std::function<std::string()> promptProvider_;
+    std::function<void()> idleHandler_;
 
     static std::size_t visibleLength(const std::string& text);
-    static int readKey();
+    int readKey();
 };
 
 struct ShellConfig {
@@ -246,6 +358,7 @@ struct ShellConfig {
     std::string historyFile;
     std::string aliasFile;
     std::string configFile;
+    std::string cacheDir; // where `cache` keeps its entries
 };
 
 class Shell {
@@ -253,7 +366,11 @@ public:
     explicit Shell(ShellConfig config = {});
     ~Shell();
     int run();
-    int runScript(const std::string& path);
+    // A top-level run is the script or -c string the shell was started for. Its final command may
+    // replace the shell process (see ShellOptions::tailExec), and it starts every queued job
+    // before returning.
+    int runScript(const std::string& path, bool topLevel = false);
+    int runCommandString(const std::string& text, bool topLevel = false);
 
     History& history();
     AliasStore& aliases();
@@ -263,6 +380,7 @@ public:
     InputReader& inputReader();
     CommandRegistry& registry();
     const ShellConfig& config() const;
+    [[nodiscard]] const std::string& cacheDirectory() const;
     ShellOptions& options();
     void requestExit(int status = 0);
     std::string promptTemplate() const;
@@ -270,6 +388,7 @@ public:
 
     std::string buildPrompt() const;
     std::string expandInput(const std::string& input) const;
+    std::string substituteCommand(const std::string& commandText);
     std::string resolveAlias(const std::string& token) const;
     void saveState();
     void loadState();
@@ -294,8 +413,11 @@ private:
     std::string historyFile_;
     std::string aliasFile_;
     std::string configFile_;
+    std::string cacheDir_;
     ShellOptions options_;
 
+    int runLines(std::string text, bool topLevel);
+    bool mayReplaceShell(const std::vector<Pipeline>& pipelines);
     void setupSignalHandlers();
     static void sigintHandler(int sig);
     static void sigtstpHandler(int sig);
@@ -0,0 +1,41 @@
+#ifndef SCHED_ATTRS_H
+#define SCHED_ATTRS_H
+
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace ryke {
+
+// Scheduling attributes given to every process of a job. They are set in the child between fork
+// and exec, so the command starts with them and everything it forks inherits them, without a
+// taskset/nice/ionice wrapper exec per stage. Unset fields leave the shell's own values alone.
+struct SchedAttrs {
+    std::vector<int> cpus;     // CPU affinity; empty inherits the shell's mask
+    std::optional<int> nice;   // absolute nice value, -20..19
+    std::optional<int> ioprio; // ioprio_set value: class << 13 | level
+    std::optional<int> policy; // SCHED_OTHER, SCHED_BATCH or SCHED_IDLE
+
+    [[nodiscard]] bool empty() const;
+    void merge(const SchedAttrs& over); // fields set in `over` win
+};
+
+// Sets one attribute from its textual form: cpus=0-3,6  nice=10  ioprio=idle|be:N|rt:N|none
+// sched=other|batch|idle. Returns false, leaving attrs untouched, on an unknown name or bad value.
+bool setSchedAttr(SchedAttrs& attrs, const std::string& name, const std::string& value);
+// The textual form of one attribute, or an empty string when it is unset.
+std::string formatSchedAttr(const SchedAttrs& attrs, const std::string& name);
+
+inline constexpr const char* kSchedAttrNames[] = {"cpus", "nice", "ioprio", "sched"};
+
+// Applies the attributes to one process (0 is the caller). Returns 0 or the errno of the first
+// attribute that could not be set; the remaining ones are still attempted.
+int applySchedAttrs(const SchedAttrs& attrs, pid_t pid = 0);
+// Applies them to a running job: nice and ioprio through its process group, affinity and policy
+// to each of its processes.
+int applySchedAttrsToJob(const SchedAttrs& attrs, pid_t pgid, const std::vector<pid_t>& pids);
+
+} // namespace ryke
+
+#endif //SCHED_ATTRS_H
@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <functional>
 #include <string>
 
 namespace ryke {
@@ -9,6 +10,11 @@ void displaySplashArt();
 std::string expandTilde(const std::string& path);
 class ShellOptions;
 
+// Runs the text of a $(...) substitution and returns its raw output. The shell installs one
+// that goes through its own parser, executor and builtins; without it a standalone executor is used.
+using CommandSubstitution = std::function<std::string(const std::string& command)>;
+void setCommandSubstitution(CommandSubstitution handler);
+
 std::string expandVariables(const std::string& input, const ShellOptions* options = nullptr);
 
 } // namespace ryke
@@ -0,0 +1,86 @@
+#ifndef VARIABLE_STORE_H
+#define VARIABLE_STORE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ryke {
+
+// An exec-ready environment: "NAME=value" strings and the null-terminated array pointing at them.
+class Environment {
+public:
+    explicit Environment(std::vector<std::string> entries);
+
+    Environment(const Environment&) = delete;
+    Environment& operator=(const Environment&) = delete;
+
+    [[nodiscard]] char* const* envp() const { return pointers_.data(); }
+    [[nodiscard]] const std::vector<std::string>& entries() const { return entries_; }
+
+private:
+    std::vector<std::string> entries_;
+    std::vector<char*> pointers_;
+};
+
+// `base` with `overrides` applied on top; `base` itself when there are none.
+std::shared_ptr<const Environment> overrideEnvironment(const std::shared_ptr<const Environment>& base,
+                                                       const std::vector<std::pair<std::string, std::string>>& overrides);
+
+// The shell's variables, kept apart from the process environment. Only exported variables reach
+// launched commands, through an Environment that is built on first use after a change and then
+// shared by every launch until the next one. Launches still holding an older snapshot keep it
+// alive, so a change never rewrites an array a child is being started with.
+class VariableStore {
+public:
+    struct Variable {
+        std::string value;
+        bool exported{false};
+    };
+
+    VariableStore() = default;
+    explicit VariableStore(char** environment); // imports NAME=value entries as exported variables
+
+    [[nodiscard]] const std::string* find(std::string_view name) const;
+    // Keeps the export flag of an existing variable; a new one is local to the shell.
+    void set(const std::string& name, std::string value);
+    void exportVariable(const std::string& name, std::optional<std::string> value = std::nullopt);
+    bool unset(const std::string& name);
+    [[nodiscard]] bool isExported(std::string_view name) const;
+    [[nodiscard]] std::vector<std::pair<std::string, Variable>> sorted() const;
+
+    std::shared_ptr<const Environment> environment();
+    // The exported variables with `overrides` applied on top, for `NAME=value cmd`. The cached
+    // environment is copied only for commands that carry such assignments.
+    std::shared_ptr<const Environment> environment(const std::vector<std::pair<std::string, std::string>>& overrides);
+    [[nodiscard]] std::uint64_t version() const { return version_; }
+
+private:
+    struct Hash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+    };
+
+    void changed(bool exported);
+
+    std::unordered_map<std::string, Variable, Hash, std::equal_to<>> variables_;
+    std::shared_ptr<const Environment> environment_;
+    std::uint64_t version_{0};
+};
+
+// [A-Za-z_][A-Za-z0-9_]*
+bool isVariableName(std::string_view name);
+
+// The store of the running shell, seeded from environ on first use. Like environ it is shared by
+// the whole process and is only touched from the thread that runs commands.
+VariableStore& shellVariables();
+
+} // namespace ryke
+
+#endif //VARIABLE_STORE_H
@@ -0,0 +1,165 @@
+#include "arg_batching.h"
+#include "launcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ryke {
+
+namespace {
+
+constexpr std::size_t kHeadroom = 4096; // left free below ARG_MAX, as xargs does
+
+std::string basename(const std::string& path) {
+    const auto slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// xargs' reading of one run's wait status.
+int batchStatus(int status) {
+    if (WIFSIGNALED(status)) {
+        return 125;
+    }
+    const int code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    return code == 0 ? 0 : code == 126 || code == 127 ? code : 123;
+}
+
+} // namespace
+
+bool ArgBatching::allows(const std::string& command) const {
+    return all || std::ranges::find(commands, basename(command)) != commands.end();
+}
+
+bool parseArgBatching(const std::string& spec, ArgBatching& batching) {
+    if (spec.empty()) {
+        return false;
+    }
+    if (spec == "all") {
+        batching.all = true;
+        batching.commands.clear();
+        return true;
+    }
+    std::vector<std::string> commands;
+    std::size_t start = 0;
+    while (start <= spec.size()) {
+        const std::size_t comma = std::min(spec.find(',', start), spec.size());
+        if (comma == start) {
+            return false;
+        }
+        commands.push_back(spec.substr(start, comma - start));
+        start = comma + 1;
+    }
+    batching.all = false;
+    batching.commands = std::move(commands);
+    return true;
+}
+
+std::string formatArgBatching(const ArgBatching& batching) {
+    if (batching.all) {
+        return "all";
+    }
+    std::string out;
+    for (const auto& command : batching.commands) {
+        out += (out.empty() ? "" : ",") + command;
+    }
+    return out.empty() ? "off" : out;
+}
+
+std::size_t execBytes(const std::vector<std::string>& strings) {
+    std::size_t bytes = sizeof(char*);
+    for (const auto& s : strings) {
+        bytes += s.size() + 1 + sizeof(char*);
+    }
+    return bytes;
+}
+
+std::size_t execBytes(char* const* strings) {
+    std::size_t bytes = sizeof(char*);
+    for (char* const* s = strings; s && *s; ++s) {
+        bytes += std::char_traits<char>::length(*s) + 1 + sizeof(char*);
+    }
+    return bytes;
+}
+
+std::size_t argumentBudget(char* const* envp) {
+    const long argMax = sysconf(_SC_ARG_MAX);
+    const std::size_t limit = argMax > 0 ? static_cast<std::size_t>(argMax) : 128 * 1024;
+    const std::size_t used = execBytes(envp) + kHeadroom;
+    return limit > used ? limit - used : 0;
+}
+
+std::optional<std::vector<std::vector<std::string>>> splitArguments(const std::vector<std::string>& argv,
+                                                                    std::size_t fixed, std::size_t budget,
+                                                                    std::size_t trailing) {
+    fixed = std::min(fixed, argv.size());
+    trailing = std::min(trailing, argv.size() - fixed);
+    const auto tailStart = argv.end() - static_cast<std::ptrdiff_t>(trailing);
+    const std::vector<std::string> lead(argv.begin(), argv.begin() + static_cast<std::ptrdiff_t>(fixed));
+    const std::vector<std::string> tail(tailStart, argv.end());
+    // The terminating pointer is already counted once in the lead's bytes.
+    const std::size_t fixedBytes = execBytes(lead) + execBytes(tail) - sizeof(char*);
+
+    std::vector<std::vector<std::string>> chunks;
+    std::vector<std::string> chunk = lead;
+    std::size_t bytes = fixedBytes;
+    for (std::size_t i = fixed; i < argv.size() - trailing; ++i) {
+        const std::size_t cost = argv[i].size() + 1 + sizeof(char*);
+        if (argv[i].size() + 1 > kMaxArgumentLength || fixedBytes + cost > budget) {
+            return std::nullopt;
+        }
+        if (bytes + cost > budget) {
+            chunk.insert(chunk.end(), tail.begin(), tail.end());
+            chunks.push_back(std::move(chunk));
+            chunk = lead;
+            bytes = fixedBytes;
+        }
+        chunk.push_back(argv[i]);
+        bytes += cost;
+    }
+    chunk.insert(chunk.end(), tail.begin(), tail.end());
+    chunks.push_back(std::move(chunk));
+    return chunks;
+}
+
+int runBatches(const std::string& path, const std::vector<std::vector<std::string>>& chunks,
+               char* const* envp, unsigned jobs) {
+    jobs = std::max(jobs, 1U);
+    int worst = 0;
+    unsigned running = 0;
+    auto reapOne = [&]() {
+        int status = 0;
+        while (waitpid(-1, &status, 0) == -1) {
+            if (errno != EINTR) {
+                running = 0;
+                return;
+            }
+        }
+        --running;
+        worst = std::max(worst, batchStatus(status));
+    };
+
+    for (const auto& chunk : chunks) {
+        if (running == jobs) {
+            reapOne();
+        }
+        SpawnRequest request;
+        request.path = path;
+        request.argv = chunk;
+        request.pgid = getpgrp();
+        request.envp = envp;
+        const SpawnResult result = spawnProcess(request, SpawnEngine::PosixSpawn);
+        if (result.pid < 0) {
+            worst = std::max(worst, result.error == ENOENT ? 127 : 126);
+            break;
+        }
+        ++running;
+    }
+    while (running > 0) {
+        reapOne();
+    }
+    return worst;
+}
+
+} // namespace ryke
@@ -111,12 +111,12 @@ std::vector<std::string> AutocompleteEngine::getExecutableNames(const std::strin
             executables.push_back(b);
         }
     }
-    const char* pathEnv = getenv("PATH");
-    if (!pathEnv) {
+    const std::string* pathVar = shellVariables().find("PATH");
+    if (!pathVar) {
         return executables;
     }
 
-    std::istringstream iss(pathEnv);
+    std::istringstream iss(*pathVar);
     std::string dir;
     while (std::getline(iss, dir, ':')) {
         DIR* dp = opendir(dir.c_str());
@@ -0,0 +1,287 @@
+#include "command_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ryke {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr const char* kMagic = "rykecache 1";
+constexpr const char* kCountersFile = "counters";
+constexpr std::size_t kDigestLength = 32;
+
+std::uint64_t fnv1a(const std::string& text, std::uint64_t hash) {
+    for (const unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool isEntryName(const std::string& name) {
+    return name.size() == kDigestLength && std::ranges::all_of(name, [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); });
+}
+
+void appendWord(std::string& key, const std::string& word) {
+    key += std::to_string(word.size());
+    key += ':';
+    key += word;
+}
+
+struct EntryFile {
+    fs::path path;
+    std::uintmax_t size;
+    fs::file_time_type used;
+};
+
+std::vector<EntryFile> listEntries(const std::string& directory) {
+    std::vector<EntryFile> entries;
+    std::error_code ec;
+    for (const auto& item : fs::directory_iterator(directory, ec)) {
+        std::error_code itemError;
+        if (!isEntryName(item.path().filename().string()) || !item.is_regular_file(itemError)) {
+            continue;
+        }
+        const auto size = item.file_size(itemError);
+        const auto used = item.last_write_time(itemError);
+        if (!itemError) {
+            entries.push_back(EntryFile{item.path(), size, used});
+        }
+    }
+    return entries;
+}
+
+std::optional<std::uint64_t> parseCount(const std::string& spec, std::size_t& digits) {
+    digits = 0;
+    while (digits < spec.size() && std::isdigit(static_cast<unsigned char>(spec[digits]))) {
+        ++digits;
+    }
+    if (digits == 0 || digits > 15 || spec.size() > digits + 1) {
+        return std::nullopt;
+    }
+    return std::stoull(spec.substr(0, digits));
+}
+
+} // namespace
+
+CommandCache::CommandCache(std::string directory, std::uintmax_t maxBytes)
+    : directory_(std::move(directory)), maxBytes_(maxBytes) {}
+
+std::optional<CachedResult> CommandCache::lookup(const std::string& key, std::chrono::seconds ttl) {
+    const fs::path path = fs::path(directory_) / digest(key);
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    CachedResult result;
+    std::size_t keySize = 0;
+    std::size_t outSize = 0;
+    std::size_t errSize = 0;
+    if (!in || !std::getline(in, magic) || magic != kMagic ||
+        !(in >> result.status >> result.created >> keySize >> outSize >> errSize) || in.get() != '\n') {
+        count(false);
+        return std::nullopt;
+    }
+
+    std::string storedKey(keySize, '\0');
+    result.out.resize(outSize);
+    result.err.resize(errSize);
+    in.read(storedKey.data(), static_cast<std::streamsize>(keySize));
+    in.read(result.out.data(), static_cast<std::streamsize>(outSize));
+    in.read(result.err.data(), static_cast<std::streamsize>(errSize));
+    const bool expired = ttl.count() > 0 && std::time(nullptr) - result.created >= ttl.count();
+    // A digest collision or a truncated file is a miss like any other.
+    if (!in || storedKey != key || expired) {
+        std::error_code ec;
+        fs::remove(path, ec);
+        count(false);
+        return std::nullopt;
+    }
+
+    // Marks the entry as the most recently used one for eviction.
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    count(true);
+    return result;
+}
+
+bool CommandCache::store(const std::string& key, const CachedResult& result) {
+    const std::string name = digest(key);
+    std::string header = std::string(kMagic) + '\n' + std::to_string(result.status) + ' ' +
+                         std::to_string(result.created) + ' ' + std::to_string(key.size()) + ' ' +
+                         std::to_string(result.out.size()) + ' ' + std::to_string(result.err.size()) + '\n';
+    if (header.size() + key.size() + result.out.size() + result.err.size() > maxBytes_) {
+        return false;
+    }
+
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    // Written aside and renamed into place, so a concurrent reader never sees half an entry.
+    const fs::path temp = fs::path(directory_) / ("." + name + "." + std::to_string(getpid()));
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out << header << key << result.out << result.err;
+        if (!out.flush()) {
+            fs::remove(temp, ec);
+            return false;
+        }
+    }
+    fs::rename(temp, fs::path(directory_) / name, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    evict();
+    return true;
+}
+
+void CommandCache::clear() {
+    for (const auto& entry : listEntries(directory_)) {
+        std::error_code ec;
+        fs::remove(entry.path, ec);
+    }
+    std::error_code ec;
+    fs::remove(fs::path(directory_) / kCountersFile, ec);
+}
+
+CommandCache::Stats CommandCache::stats() const {
+    Stats stats;
+    std::ifstream counters(fs::path(directory_) / kCountersFile);
+    counters >> stats.hits >> stats.misses;
+    for (const auto& entry : listEntries(directory_)) {
+        ++stats.entries;
+        stats.bytes += entry.size;
+    }
+    return stats;
+}
+
+void CommandCache::setMaxBytes(std::uintmax_t maxBytes) {
+    maxBytes_ = maxBytes;
+}
+
+const std::string& CommandCache::directory() const {
+    return directory_;
+}
+
+std::string CommandCache::digest(const std::string& key) {
+    char buffer[kDigestLength + 1];
+    std::snprintf(buffer, sizeof(buffer), "%016llx%016llx",
+                  static_cast<unsigned long long>(fnv1a(key, 14695981039346656037ULL)),
+                  static_cast<unsigned long long>(fnv1a(key, 0x6c62272e07bb0142ULL)));
+    return buffer;
+}
+
+// Counters are read, bumped and renamed back; concurrent shells may lose an increment, never the file.
+void CommandCache::count(bool hit) const {
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (ec) {
+        return;
+    }
+    const fs::path path = fs::path(directory_) / kCountersFile;
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    {
+        std::ifstream in(path);
+        in >> hits >> misses;
+    }
+    (hit ? hits : misses) += 1;
+    const fs::path temp = fs::path(directory_) / (std::string(".") + kCountersFile + "." + std::to_string(getpid()));
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        out << hits << ' ' << misses << '\n';
+    }
+    fs::rename(temp, path, ec);
+}
+
+void CommandCache::evict() const {
+    std::vector<EntryFile> entries = listEntries(directory_);
+    std::uintmax_t total = 0;
+    for (const auto& entry : entries) {
+        total += entry.size;
+    }
+    if (total <= maxBytes_) {
+        return;
+    }
+    std::ranges::sort(entries, {}, &EntryFile::used);
+    for (const auto& entry : entries) {
+        if (total <= maxBytes_) {
+            break;
+        }
+        std::error_code ec;
+        if (fs::remove(entry.path, ec)) {
+            total -= entry.size;
+        }
+    }
+}
+
+std::string buildCacheKey(const std::vector<std::string>& argv, const std::string& cwd,
+                          const std::vector<std::pair<std::string, std::optional<std::string>>>& variables,
+                          const std::vector<std::string>& keyFiles) {
+    std::string key = "argv";
+    for (const auto& word : argv) {
+        appendWord(key, word);
+    }
+    key += "\ncwd";
+    appendWord(key, cwd);
+    key += "\nenv";
+    for (const auto& [name, value] : variables) {
+        appendWord(key, name);
+        key += value ? "=" : "!";
+        appendWord(key, value.value_or(""));
+    }
+    key += "\nfiles";
+    for (const auto& file : keyFiles) {
+        appendWord(key, file);
+        struct stat st {};
+        if (stat(file.c_str(), &st) == 0) {
+            key += std::to_string(st.st_size) + '@' + std::to_string(st.st_mtim.tv_sec) + '.' +
+                   std::to_string(st.st_mtim.tv_nsec) + ';';
+        } else {
+            key += "missing;";
+        }
+    }
+    return key;
+}
+
+std::optional<std::chrono::seconds> parseTtl(const std::string& spec) {
+    std::size_t digits = 0;
+    const auto value = parseCount(spec, digits);
+    if (!value) {
+        return std::nullopt;
+    }
+    const char unit = digits < spec.size() ? spec[digits] : 's';
+    switch (unit) {
+        case 's': return std::chrono::seconds(*value);
+        case 'm': return std::chrono::minutes(*value);
+        case 'h': return std::chrono::hours(*value);
+        case 'd': return std::chrono::hours(*value * 24);
+        default: return std::nullopt;
+    }
+}
+
+std::optional<std::uintmax_t> parseByteSize(const std::string& spec) {
+    std::size_t digits = 0;
+    const auto value = parseCount(spec, digits);
+    if (!value) {
+        return std::nullopt;
+    }
+    if (digits == spec.size()) {
+        return *value;
+    }
+    switch (std::toupper(static_cast<unsigned char>(spec[digits]))) {
+        case 'K': return *value * 1024;
+        case 'M': return *value * 1024 * 1024;
+        case 'G': return *value * 1024 * 1024 * 1024;
+        default: return std::nullopt;
+    }
+}
+
+} // namespace ryke
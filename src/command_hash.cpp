@@ -0,0 +1,133 @@
+#include "command_hash.h"
+#include "variable_store.h"
+
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ryke {
+
+namespace {
+
+bool isExecutableFile(const std::string& path) {
+    struct stat st {};
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(path.c_str(), X_OK) == 0;
+}
+
+} // namespace
+
+std::optional<std::string> CommandHash::lookup(const std::string& name) {
+    if (name.empty() || name.find('/') != std::string::npos) {
+        return std::nullopt;
+    }
+    syncPath();
+
+    if (auto it = table_.find(name); it != table_.end()) {
+        if (it->second.pinned) {
+            ++it->second.hits;
+            return it->second.path;
+        }
+        const std::size_t dirIndex = it->second.dirIndex;
+        bool valid = true;
+        for (std::size_t i = 0; i <= dirIndex && i < directories_.size(); ++i) {
+            if (directoryChanged(i)) {
+                valid = false;
+                break;
+            }
+        }
+        if (valid) {
+            if (auto cached = table_.find(name); cached != table_.end()) {
+                ++cached->second.hits;
+                return cached->second.path;
+            }
+        }
+    }
+
+    std::size_t dirIndex = 0;
+    auto found = search(name, dirIndex);
+    if (found) {
+        table_[name] = Entry{*found, 1, dirIndex, false};
+    }
+    return found;
+}
+
+void CommandHash::remember(const std::string& name, const std::string& path) {
+    syncPath();
+    table_[name] = Entry{path, 0, 0, true};
+}
+
+bool CommandHash::forget(const std::string& name) {
+    return table_.erase(name) > 0;
+}
+
+void CommandHash::clear() {
+    table_.clear();
+    directories_.clear();
+    pathValue_.reset();
+}
+
+const std::unordered_map<std::string, CommandHash::Entry>& CommandHash::entries() const {
+    return table_;
+}
+
+void CommandHash::syncPath() {
+    const std::string* pathVar = shellVariables().find("PATH");
+    const std::string current = pathVar ? *pathVar : "/bin:/usr/bin";
+    if (pathValue_ && *pathValue_ == current) {
+        return;
+    }
+
+    pathValue_ = current;
+    table_.clear();
+    directories_.clear();
+    std::size_t start = 0;
+    while (start <= current.size()) {
+        const std::size_t colon = current.find(':', start);
+        const std::size_t end = colon == std::string::npos ? current.size() : colon;
+        std::string dir = current.substr(start, end - start);
+        directories_.push_back(Directory{dir.empty() ? "." : std::move(dir), {}, false});
+        if (colon == std::string::npos) {
+            break;
+        }
+        start = colon + 1;
+    }
+}
+
+// Re-stats one PATH directory. A change drops every cached entry found at or after it,
+// because a new file there can shadow them and a removed one may be among them.
+bool CommandHash::directoryChanged(std::size_t index) {
+    Directory& dir = directories_[index];
+    struct stat st {};
+    timespec mtime{};
+    if (stat(dir.path.c_str(), &st) == 0) {
+        mtime = st.st_mtim;
+    }
+
+    const bool changed = dir.scanned && (mtime.tv_sec != dir.mtime.tv_sec || mtime.tv_nsec != dir.mtime.tv_nsec);
+    dir.mtime = mtime;
+    dir.scanned = true;
+    if (changed) {
+        std::erase_if(table_, [&](const auto& item) {
+            return !item.second.pinned && item.second.dirIndex >= index;
+        });
+    }
+    return changed;
+}
+
+std::optional<std::string> CommandHash::search(const std::string& name, std::size_t& dirIndex) {
+    for (std::size_t i = 0; i < directories_.size(); ++i) {
+        directoryChanged(i);
+        std::string candidate = directories_[i].path;
+        if (candidate.back() != '/') {
+            candidate += '/';
+        }
+        candidate += name;
+        if (isExecutableFile(candidate)) {
+            dirIndex = i;
+            return candidate;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace ryke
@@ -1,19 +1,38 @@
 #include "commands.h"
+#include "command_cache.h"
+#include "file_copy.h"
+#include "file_watcher.h"
+#include "launcher.h"
+#include "proc_sampler.h"
 #include "utils.h"
 
 #include <algorithm>
+#include <cctype>
 #include <cerrno>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <dirent.h>
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <poll.h>
 #include <pwd.h>
 #include <ranges>
 #include <sstream>
+#include <string_view>
+#include <signal.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -23,35 +42,56 @@ void CommandRegistry::registerCommand(const std::string& name, std::unique_ptr<B
     handlers_[name] = std::move(handler);
 }
 
-bool CommandRegistry::tryHandle(const Command& command, Shell& shell) const {
+std::optional<int> CommandRegistry::tryHandle(const Command& command, Shell& shell) const {
     if (command.args.empty()) {
-        return false;
+        return std::nullopt;
     }
 
     const std::string& name = command.args.front();
     if (const auto it = handlers_.find(name); it != handlers_.end()) {
-        it->second->run(command, shell);
-        return true;
+        return it->second->run(command, shell);
+    }
+    return std::nullopt;
+}
+
+bool CommandRegistry::contains(const std::string& name) const {
+    return handlers_.contains(name);
+}
+
+bool CommandRegistry::handles(const Command& command) const {
+    if (command.args.empty()) {
+        return false;
+    }
+    const auto it = handlers_.find(command.args.front());
+    return it != handlers_.end() && it->second->accepts(command);
+}
+
+bool CommandRegistry::readOnly(const Command& command) const {
+    if (command.args.empty()) {
+        return false;
     }
-    return false;
+    const auto it = handlers_.find(command.args.front());
+    return it != handlers_.end() && it->second->readOnly();
 }
 
 namespace {
 
 class ExitCommand : public BuiltinCommand {
 public:
-    void run(const Command& /*command*/, Shell& shell) override {
+    int run(const Command& /*command*/, Shell& shell) override {
         shell.saveState();
         shell.requestExit(0);
+        return 0;
     }
 };
 
 class CdCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& /*shell*/) override {
+    int run(const Command& command, Shell& /*shell*/) override {
         std::string target;
         if (command.args.size() == 1) {
-            const char* home = getenv("HOME");
+            const std::string* homeVar = shellVariables().find("HOME");
+            const char* home = homeVar ? homeVar->c_str() : nullptr;
             if (!home) {
                 if (auto* pw = getpwuid(getuid())) {
                     home = pw->pw_dir;
@@ -64,31 +104,45 @@ public:
 
         if (chdir(target.c_str()) != 0) {
             std::cerr << "cd: " << strerror(errno) << '\n';
+            return 1;
         }
+        return 0;
     }
 };
 
 class PwdCommand : public BuiltinCommand {
 public:
-    void run(const Command& /*command*/, Shell& /*shell*/) override {
+    int run(const Command& /*command*/, Shell& /*shell*/) override {
         char cwd[1024];
-        if (getcwd(cwd, sizeof(cwd))) {
-            std::cout << cwd << '\n';
-        } else {
+        if (!getcwd(cwd, sizeof(cwd))) {
             std::cerr << "pwd: " << strerror(errno) << '\n';
+            return 1;
         }
+        std::cout << cwd << '\n';
+        return 0;
     }
+
+    [[nodiscard]] bool readOnly() const override { return true; }
 };
 
 class HistoryCommand : public BuiltinCommand {
 public:
-    void run(const Command& /*command*/, Shell& shell) override {
+    int run(const Command& /*command*/, Shell& shell) override {
         if (shell.history().empty()) {
             std::cout << "No commands in history.\n";
-            return;
+            return 0;
         }
 
         const auto& entries = shell.history().entries();
+        if (!isatty(STDOUT_FILENO)) {
+            // Feeding a pipe or file: print the list instead of the interactive picker.
+            std::size_t number = 1;
+            for (const auto& e : entries) {
+                std::cout << std::setw(5) << std::right << number++ << "  " << e.command << '\n';
+            }
+            return 0;
+        }
+
         std::vector<std::string> items;
         items.reserve(entries.size());
         for (const auto& e : entries) {
@@ -96,35 +150,28 @@ public:
         }
         const int selected = shell.inputReader().interactiveListSelection(items, "Command History");
         if (selected < 0 || selected >= static_cast<int>(items.size())) {
-            return;
+            return 0;
         }
 
         const std::string input = items[static_cast<std::size_t>(selected)];
         const std::string expanded = shell.expandInput(input);
         const std::vector<Pipeline> pipelines = shell.parser().parse(expanded);
         if (pipelines.empty()) {
-            return;
-        }
-
-        const Pipeline& first = pipelines.front();
-        const bool singleBuiltin = pipelines.size() == 1 && first.stages.size() == 1;
-        if (singleBuiltin && shell.registry().tryHandle(first.stages.front(), shell)) {
-            return;
+            return 0;
         }
-
-        shell.executor().execute(pipelines, input);
+        return shell.executor().execute(pipelines, input);
     }
 };
 
 class AliasCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& shell) override {
+    int run(const Command& command, Shell& shell) override {
         auto& aliasStore = shell.aliases();
         if (command.args.size() == 1) {
             for (const auto& [name, value] : aliasStore.all()) {
                 std::cout << "alias " << name << "='" << value << "'\n";
             }
-            return;
+            return 0;
         }
 
         for (std::size_t i = 1; i < command.args.size(); ++i) {
@@ -138,31 +185,34 @@ public:
                 aliasStore.set(name, value);
             }
         }
+        return 0;
     }
 };
 
 class ThemeCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& shell) override {
+    int run(const Command& command, Shell& shell) override {
         if (command.args.size() < 2) {
             std::cout << "Usage: theme [color]\n";
-            return;
+            return 1;
         }
 
         const std::string& color = command.args[1];
         if (!shell.promptTheme().applyColor(color)) {
             std::cerr << "Unknown color: " << color << '\n';
+            return 1;
         }
+        return 0;
     }
 };
 
 class PromptCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& shell) override {
+    int run(const Command& command, Shell& shell) override {
         if (command.args.size() == 1) {
             std::cout << "Current template: " << shell.promptTemplate() << "\n";
             std::cout << "Placeholders: {user}, {host}, {cwd}, {color}, {cwdcolor}, {reset}\n";
-            return;
+            return 0;
         }
 
         if (command.args.size() >= 2) {
@@ -173,33 +223,126 @@ public:
             }
             shell.setPromptTemplate(oss.str());
         }
+        return 0;
     }
 };
 
+// Wraps text in single quotes so the shell reads it back verbatim; embedded quotes become '\''.
+std::string shellQuote(const std::string& text) {
+    std::string quoted = "'";
+    for (const char c : text) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + '\'';
+}
+
 class ExportCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& /*shell*/) override {
+    int run(const Command& command, Shell& /*shell*/) override {
+        VariableStore& variables = shellVariables();
         if (command.args.size() < 2) {
-            std::cerr << "No variable provided. Use: export VAR=value\n";
-            return;
+            for (const auto& [name, variable] : variables.sorted()) {
+                if (variable.exported) {
+                    std::cout << "export " << name << '=' << shellQuote(variable.value) << '\n';
+                }
+            }
+            return 0;
         }
 
-        const std::string& assignment = command.args[1];
-        if (const auto eqPos = assignment.find('='); eqPos != std::string::npos) {
-            const std::string var = assignment.substr(0, eqPos);
-            const std::string value = assignment.substr(eqPos + 1);
-            if (setenv(var.c_str(), value.c_str(), 1) != 0) {
-                std::cerr << "Failed to set environment variable " << var << '\n';
+        int status = 0;
+        for (std::size_t i = 1; i < command.args.size(); ++i) {
+            const std::string& arg = command.args[i];
+            const auto eqPos = arg.find('=');
+            const std::string var = arg.substr(0, eqPos);
+            if (!isVariableName(var)) {
+                std::cerr << "export: `" << arg << "': not a valid identifier\n";
+                status = 1;
+            } else if (eqPos != std::string::npos) {
+                variables.exportVariable(var, arg.substr(eqPos + 1));
+            } else {
+                variables.exportVariable(var);
+            }
+        }
+        return status;
+    }
+};
+
+class UnsetCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& /*shell*/) override {
+        for (std::size_t i = 1; i < command.args.size(); ++i) {
+            shellVariables().unset(command.args[i]);
+        }
+        return 0;
+    }
+};
+
+class HashCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& shell) override {
+        CommandHash& hash = shell.executor().commandHash();
+        if (command.args.size() == 1) {
+            if (hash.entries().empty()) {
+                std::cout << "hash: hash table empty\n";
+                return 0;
+            }
+            std::vector<std::pair<std::string, const CommandHash::Entry*>> rows;
+            for (const auto& [name, entry] : hash.entries()) {
+                rows.emplace_back(name, &entry);
+            }
+            std::ranges::sort(rows, {}, &decltype(rows)::value_type::first);
+            std::cout << "hits\tcommand\n";
+            for (const auto& [name, entry] : rows) {
+                std::cout << std::setw(4) << std::right << entry->hits << "\t" << entry->path << '\n';
+            }
+            return 0;
+        }
+
+        const std::string& flag = command.args[1];
+        int status = 0;
+        if (flag == "-r") {
+            hash.clear();
+        } else if (flag == "-p") {
+            if (command.args.size() != 4) {
+                std::cerr << "hash: usage: hash -p path name\n";
+                return 1;
+            }
+            hash.remember(command.args[3], command.args[2]);
+        } else if (flag == "-d") {
+            for (std::size_t i = 2; i < command.args.size(); ++i) {
+                if (!hash.forget(command.args[i])) {
+                    std::cerr << "hash: " << command.args[i] << ": not found\n";
+                    status = 1;
+                }
+            }
+        } else if (flag == "-t") {
+            for (std::size_t i = 2; i < command.args.size(); ++i) {
+                if (const auto path = hash.lookup(command.args[i])) {
+                    std::cout << *path << '\n';
+                } else {
+                    std::cerr << "hash: " << command.args[i] << ": not found\n";
+                    status = 1;
+                }
             }
         } else {
-            std::cerr << "Invalid format. Use VAR=value\n";
+            for (std::size_t i = 1; i < command.args.size(); ++i) {
+                if (!hash.lookup(command.args[i])) {
+                    std::cerr << "hash: " << command.args[i] << ": not found\n";
+                    status = 1;
+                }
+            }
         }
+        return status;
     }
 };
 
 class LsCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& /*shell*/) override {
+    int run(const Command& command, Shell& /*shell*/) override {
         std::string directory = ".";
         if (command.args.size() > 1) {
             directory = command.args[1];
@@ -208,7 +351,7 @@ public:
         DIR* dir = opendir(directory.c_str());
         if (!dir) {
             std::cerr << "ls: cannot access '" << directory << "': " << strerror(errno) << '\n';
-            return;
+            return 1;
         }
 
         dirent* entry;
@@ -251,67 +394,1252 @@ public:
         if (count % 8 != 0) {
             std::cout << '\n';
         }
+        return 0;
     }
+
+    [[nodiscard]] bool readOnly() const override { return true; }
 };
 
 class JobsCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& shell) override {
+    int run(const Command& command, Shell& shell) override {
         bool verbose = false;
         if (command.args.size() > 1 && command.args[1] == "-l") {
             verbose = true;
         }
         shell.executor().listJobs(std::cout, verbose);
+        return 0;
     }
 };
 
 class FgCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& shell) override {
+    int run(const Command& command, Shell& shell) override {
         int jobId = -1;
         if (command.args.size() > 1) {
             try {
                 jobId = std::stoi(command.args[1]);
             } catch (...) {
                 std::cerr << "fg: invalid job id\n";
-                return;
+                return 1;
             }
         }
         if (!shell.executor().foregroundJob(jobId)) {
             std::cerr << "fg: no such job\n";
+            return 1;
         }
+        return 0;
     }
 };
 
 class BgCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& shell) override {
+    int run(const Command& command, Shell& shell) override {
         int jobId = -1;
         if (command.args.size() > 1) {
             try {
                 jobId = std::stoi(command.args[1]);
             } catch (...) {
                 std::cerr << "bg: invalid job id\n";
-                return;
+                return 1;
             }
         }
         if (!shell.executor().backgroundJob(jobId)) {
             std::cerr << "bg: no such job\n";
+            return 1;
+        }
+        return 0;
+    }
+};
+
+// Reads `-c CPUS -n NICE -i IOPRIO -p POLICY` pairs from args[index]; stops at the first other word.
+bool parseSchedFlags(const Command& command, std::size_t& index, SchedAttrs& attrs, const char* builtin) {
+    while (index < command.args.size() && command.args[index].size() == 2 && command.args[index][0] == '-' &&
+           std::isalpha(static_cast<unsigned char>(command.args[index][1]))) {
+        const char flag = command.args[index][1];
+        const char* name = flag == 'c' ? "cpus" : flag == 'n' ? "nice" : flag == 'i' ? "ioprio" : flag == 'p' ? "sched" : nullptr;
+        if (!name || index + 1 >= command.args.size()) {
+            std::cerr << builtin << ": " << command.args[index] << ": unknown option or missing value\n";
+            return false;
+        }
+        if (!setSchedAttr(attrs, name, command.args[index + 1])) {
+            std::cerr << builtin << ": " << name << ": invalid value " << command.args[index + 1] << '\n';
+            return false;
+        }
+        index += 2;
+    }
+    return true;
+}
+
+// A valid `sched ... cmd` prefix is taken apart by the parser, so this only sees a bare `sched`
+// (show the defaults) or a prefix it refused.
+class SchedCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& shell) override {
+        if (command.args.size() == 1) {
+            for (const char* name : kSchedAttrNames) {
+                const std::string value = formatSchedAttr(shell.options().sched, name);
+                std::cout << name << '=' << (value.empty() ? "default" : value) << '\n';
+            }
+            return 0;
+        }
+        std::size_t index = 1;
+        SchedAttrs attrs;
+        if (parseSchedFlags(command, index, attrs, "sched")) {
+            std::cerr << "sched: usage: sched [-c cpus] [-n nice] [-i idle|be:N|rt:N] [-p other|batch|idle] command [args...]\n";
+        }
+        return 2;
+    }
+};
+
+class ReniceCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& shell) override {
+        SchedAttrs attrs;
+        std::size_t index = 1;
+        // `renice 10 %1` is `renice -n 10 %1`.
+        if (index < command.args.size() && setSchedAttr(attrs, "nice", command.args[index])) {
+            ++index;
+        }
+        if (!parseSchedFlags(command, index, attrs, "renice")) {
+            return 2;
+        }
+        if (attrs.empty() || index == command.args.size()) {
+            std::cerr << "renice: usage: renice [-n] nice [-c cpus] [-i ioprio] [-p policy] %job|pid...\n";
+            return 2;
+        }
+
+        int status = 0;
+        for (; index < command.args.size(); ++index) {
+            const std::string& target = command.args[index];
+            std::optional<int> error;
+            try {
+                if (target.front() == '%') {
+                    const bool current = target == "%" || target == "%+" || target == "%%";
+                    error = shell.executor().rescheduleJob(current ? -1 : std::stoi(target.substr(1)), attrs);
+                    if (!error) {
+                        std::cerr << "renice: " << target << ": no such job\n";
+                        status = 1;
+                        continue;
+                    }
+                } else {
+                    error = applySchedAttrs(attrs, static_cast<pid_t>(std::stoi(target)));
+                }
+            } catch (...) {
+                std::cerr << "renice: " << target << ": expected %job or pid\n";
+                status = 1;
+                continue;
+            }
+            if (*error != 0) {
+                std::cerr << "renice: " << target << ": " << strerror(*error) << '\n';
+                status = 1;
+            }
+        }
+        return status;
+    }
+};
+
+// Shell-wide limits, inherited by everything started afterwards. `ulimit ... cmd` is a per-job
+// prefix handled by the parser and never reaches this builtin.
+class UlimitCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& /*shell*/) override {
+        std::size_t index = 1;
+        std::string error;
+        auto request = parseUlimit(command.args, index, error);
+        if (!request) {
+            std::cerr << "ulimit: " << error << '\n';
+            return 2;
+        }
+        if (index < command.args.size()) {
+            std::cerr << "ulimit: " << command.args[index] << ": invalid limit\n";
+            return 2;
+        }
+        if (request->set.empty() && request->show.empty() && !request->all) {
+            request->show.push_back(findLimit('f'));
+        }
+
+        int status = 0;
+        if (const int rc = applyResourceLimits(request->set); rc != 0) {
+            std::cerr << "ulimit: " << strerror(rc) << '\n';
+            status = 1;
+        }
+
+        std::vector<const LimitSpec*> shown;
+        if (request->all) {
+            for (const auto& spec : limitSpecs()) {
+                shown.push_back(&spec);
+            }
+        } else {
+            shown = request->show;
+        }
+        const bool labelled = shown.size() > 1;
+        for (const LimitSpec* spec : shown) {
+            rlimit current{};
+            getrlimit(spec->resource, &current);
+            const std::string value = formatLimit(request->hard ? current.rlim_max : current.rlim_cur, *spec);
+            if (labelled) {
+                const std::string unit = *spec->unitName ? std::string("(") + spec->unitName + ", -" + spec->flag + ")"
+                                                          : std::string("(-") + spec->flag + ")";
+                std::cout << std::left << std::setw(20) << spec->description << std::setw(16) << unit << value << '\n';
+            } else {
+                std::cout << value << '\n';
+            }
+        }
+        return status;
+    }
+};
+
+class TimeCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& shell) override {
+        const std::string* timeVar = shellVariables().find("TIME");
+        std::string format = timeVar ? *timeVar : kDefaultUsageFormat;
+
+        std::size_t i = 1;
+        for (; i < command.args.size(); ++i) {
+            const std::string& arg = command.args[i];
+            if (arg == "-f" && i + 1 < command.args.size()) {
+                format = command.args[++i];
+            } else if (arg == "-p") {
+                format = "real %e\nuser %U\nsys %S";
+            } else if (arg == "--") {
+                ++i;
+                break;
+            } else {
+                break;
+            }
+        }
+        if (i == command.args.size()) {
+            std::cerr << "time: usage: time [-p] [-f format] command [args...]\n";
+            return 1;
+        }
+
+        // The command's stdio is already this stage's stdio, so only its words are carried over.
+        Pipeline pipeline;
+        Command timed;
+        timed.args.assign(command.args.begin() + static_cast<std::ptrdiff_t>(i), command.args.end());
+        pipeline.stages.push_back(timed);
+        std::string line;
+        for (const auto& word : timed.args) {
+            line += (line.empty() ? "" : " ") + word;
+        }
+
+        const int status = shell.executor().execute({pipeline}, line);
+        std::cerr << formatResourceUsage(format, shell.executor().lastUsage(), line, status) << '\n';
+        return status;
+    }
+};
+
+// Catches Ctrl-C for a builtin that loops until it is interrupted, where the shell's own handler
+// would only print a newline: blocking calls return EINTR and interrupted() turns true.
+class InterruptGuard {
+public:
+    InterruptGuard() {
+        flag_ = 0;
+        struct sigaction onInterrupt{};
+        onInterrupt.sa_handler = [](int) { flag_ = 1; };
+        sigemptyset(&onInterrupt.sa_mask);
+        sigaction(SIGINT, &onInterrupt, &previous_);
+    }
+    ~InterruptGuard() { sigaction(SIGINT, &previous_, nullptr); }
+
+    InterruptGuard(const InterruptGuard&) = delete;
+    InterruptGuard& operator=(const InterruptGuard&) = delete;
+
+    [[nodiscard]] bool interrupted() const { return flag_ != 0; }
+
+private:
+    static inline volatile sig_atomic_t flag_ = 0;
+    struct sigaction previous_{};
+};
+
+// True when every option word (up to `--`) is a cluster of the given letters; GNU tools take
+// options after operands too, so the whole line counts.
+bool onlyOptions(const Command& command, std::string_view letters) {
+    for (std::size_t i = 1; i < command.args.size() && command.args[i] != "--"; ++i) {
+        const std::string& arg = command.args[i];
+        if (arg.size() > 1 && arg.front() == '-' &&
+            arg.find_first_not_of(letters, 1) != std::string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Splits the words after the command name into option letters and glob-expanded operands.
+std::vector<std::string> operands(const Command& command, Shell& shell, std::string& flags) {
+    const ShellOptions& options = shell.options();
+    std::vector<std::string> words;
+    bool endOfOptions = false;
+    for (std::size_t i = 1; i < command.args.size(); ++i) {
+        const std::string& arg = command.args[i];
+        if (!endOfOptions && arg == "--") {
+            endOfOptions = true;
+        } else if (!endOfOptions && arg.size() > 1 && arg.front() == '-') {
+            flags += arg.substr(1);
+        } else if (options.noglob) {
+            words.push_back(arg);
+        } else {
+            shell.executor().globber().expand(arg, GlobOptions{options.nullglob, options.dotglob, options.nosort}, words);
+        }
+    }
+    return words;
+}
+
+// cat that copies each file to stdout inside the kernel where it can (see copyFd). Numbering,
+// squeezing and the other formatting options are left to the real cat.
+class CatCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& shell) override {
+        std::string flags;
+        std::vector<std::string> files = operands(command, shell, flags);
+        if (files.empty()) {
+            files.emplace_back("-");
+        }
+        std::cout.flush();
+
+        struct stat output{};
+        const bool outputIsFile = fstat(STDOUT_FILENO, &output) == 0 && S_ISREG(output.st_mode);
+        int status = 0;
+        for (const auto& file : files) {
+            const bool standardInput = file == "-";
+            const int fd = standardInput ? STDIN_FILENO : open(file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1) {
+                std::cerr << "cat: " << file << ": " << strerror(errno) << '\n';
+                status = 1;
+                continue;
+            }
+            struct stat input{};
+            fstat(fd, &input);
+            CopyResult result;
+            if (S_ISDIR(input.st_mode)) {
+                result.error = EISDIR;
+            } else if (outputIsFile && input.st_dev == output.st_dev && input.st_ino == output.st_ino) {
+                std::cerr << "cat: " << file << ": input file is output file\n";
+                status = 1;
+            } else {
+                result = copyFd(fd, STDOUT_FILENO);
+            }
+            if (!standardInput) {
+                close(fd);
+            }
+            if (result.error == EINTR) {
+                return 130;
+            }
+            if (result.error != 0) {
+                std::cerr << "cat: " << file << ": " << strerror(result.error) << '\n';
+                status = 1;
+                if (result.error == EPIPE) {
+                    break;
+                }
+            }
+        }
+        return status;
+    }
+
+    [[nodiscard]] bool accepts(const Command& command) const override {
+        return onlyOptions(command, "u");
+    }
+
+    [[nodiscard]] bool readOnly() const override { return true; }
+};
+
+// cp for regular files (-f, -p); recursive and archive copies go to the real cp.
+class CpCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& shell) override {
+        std::string flags;
+        const std::vector<std::string> words = operands(command, shell, flags);
+        if (words.empty()) {
+            std::cerr << "cp: missing file operand\n";
+            return 1;
+        }
+        if (words.size() == 1) {
+            std::cerr << "cp: missing destination file operand after '" << words.front() << "'\n";
+            return 1;
+        }
+        const bool force = flags.find('f') != std::string::npos;
+        const bool preserve = flags.find('p') != std::string::npos;
+        const std::string& destination = words.back();
+        std::error_code ec;
+        const bool intoDirectory = std::filesystem::is_directory(destination, ec);
+        if (words.size() > 2 && !intoDirectory) {
+            std::cerr << "cp: target '" << destination << "' is not a directory\n";
+            return 1;
+        }
+
+        int status = 0;
+        for (std::size_t i = 0; i + 1 < words.size(); ++i) {
+            std::string target = destination;
+            if (intoDirectory) {
+                const std::string name = std::filesystem::path(words[i]).lexically_normal().filename().string();
+                target = (target.back() == '/' ? target : target + "/") +
+                         (name.empty() ? std::filesystem::path(words[i]).parent_path().filename().string() : name);
+            }
+            std::string error;
+            if (!copyFile(words[i], target, force, preserve, error)) {
+                std::cerr << "cp: " << error << '\n';
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    [[nodiscard]] bool accepts(const Command& command) const override {
+        return onlyOptions(command, "fp");
+    }
+
+    [[nodiscard]] bool readOnly() const override { return true; }
+};
+
+class CacheCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& shell) override {
+        CommandCache cache(shell.cacheDirectory(), shell.options().cacheSize);
+        std::chrono::seconds ttl{0};
+        std::vector<std::string> keyFiles;
+        std::vector<std::pair<std::string, std::optional<std::string>>> variables;
+
+        std::size_t i = 1;
+        for (; i < command.args.size(); ++i) {
+            const std::string& arg = command.args[i];
+            if (arg == "--stats") {
+                const CommandCache::Stats stats = cache.stats();
+                std::cout << "cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.entries
+                          << " entries, " << stats.bytes << " of " << shell.options().cacheSize << " bytes in "
+                          << cache.directory() << '\n';
+                return 0;
+            }
+            if (arg == "--clear") {
+                cache.clear();
+                return 0;
+            }
+            if (arg == "-t" && i + 1 < command.args.size()) {
+                const auto parsed = parseTtl(command.args[++i]);
+                if (!parsed) {
+                    std::cerr << "cache: " << command.args[i] << ": invalid ttl\n";
+                    return 2;
+                }
+                ttl = *parsed;
+            } else if (arg == "-k" && i + 1 < command.args.size()) {
+                keyFiles.push_back(command.args[++i]);
+            } else if (arg == "-e" && i + 1 < command.args.size()) {
+                const std::string& name = command.args[++i];
+                const std::string* value = shellVariables().find(name);
+                variables.emplace_back(name, value ? std::optional<std::string>(*value) : std::nullopt);
+            } else if (arg == "--") {
+                ++i;
+                break;
+            } else {
+                break;
+            }
+        }
+        if (i == command.args.size()) {
+            std::cerr << "cache: usage: cache [-t TTL] [-k file]... [-e VAR]... [--] command [args...]\n"
+                         "       cache --stats | --clear\n";
+            return 2;
+        }
+
+        const std::vector<std::string> argv(command.args.begin() + static_cast<std::ptrdiff_t>(i), command.args.end());
+        std::error_code ec;
+        const std::string key = buildCacheKey(argv, std::filesystem::current_path(ec).string(), variables, keyFiles);
+        if (auto hit = cache.lookup(key, ttl)) {
+            // Replayed from the store: no process at all.
+            std::cout << hit->out;
+            std::cerr << hit->err;
+            return hit->status;
+        }
+
+        CachedResult result;
+        result.created = std::time(nullptr);
+        result.status = runTeed(shell, argv, result.out, result.err);
+        // An interrupted or killed command did not produce its real output, and 126/127 mean it never
+        // launched (not found, not executable): replaying that would hide a later install or chmod.
+        if (result.status < 126) {
+            cache.store(key, result);
+        }
+        return result.status;
+    }
+
+private:
+    // Runs the command with its stdout and stderr passed through live and copied into the strings.
+    static int runTeed(Shell& shell, const std::vector<std::string>& argv, std::string& out, std::string& err) {
+        int outPipe[2] = {-1, -1};
+        int errPipe[2] = {-1, -1};
+        if (pipe2(outPipe, O_CLOEXEC) == -1 || pipe2(errPipe, O_CLOEXEC) == -1) {
+            perror("cache: pipe");
+            if (outPipe[0] != -1) {
+                close(outPipe[0]);
+                close(outPipe[1]);
+            }
+            return 1;
+        }
+        auto tee = [](int from, int to, std::string& copy) {
+            char buffer[65536];
+            ssize_t n;
+            while ((n = read(from, buffer, sizeof(buffer))) > 0 || (n == -1 && errno == EINTR)) {
+                if (n > 0) {
+                    copy.append(buffer, static_cast<std::size_t>(n));
+                    (void)!write(to, buffer, static_cast<std::size_t>(n));
+                }
+            }
+        };
+        std::cout.flush();
+        std::thread outReader(tee, outPipe[0], STDOUT_FILENO, std::ref(out));
+        std::thread errReader(tee, errPipe[0], STDERR_FILENO, std::ref(err));
+
+        Pipeline pipeline;
+        Command cached;
+        cached.args = argv;
+        pipeline.stages.push_back(cached);
+        std::string line;
+        for (const auto& word : argv) {
+            line += (line.empty() ? "" : " ") + word;
+        }
+        PipelineIo io;
+        io.output = outPipe[1];
+        io.error = errPipe[1];
+        io.inheritGroup = true;
+        const int status = shell.executor().execute({pipeline}, line, io);
+
+        close(outPipe[1]);
+        close(errPipe[1]);
+        outReader.join();
+        errReader.join();
+        close(outPipe[0]);
+        close(errPipe[0]);
+        return status;
+    }
+};
+
+class WatchCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& shell) override {
+        int debounceMs = 200;
+        bool recursive = false;
+        bool initialRun = true;
+        std::size_t i = 1;
+        for (; i < command.args.size(); ++i) {
+            const std::string& arg = command.args[i];
+            if (arg == "-d" && i + 1 < command.args.size()) {
+                char* end = nullptr;
+                const long value = std::strtol(command.args[++i].c_str(), &end, 10);
+                if (*end != '\0' || value < 0 || value > 60000) {
+                    std::cerr << "watch: " << command.args[i] << ": invalid debounce\n";
+                    return 2;
+                }
+                debounceMs = static_cast<int>(value);
+            } else if (arg == "-r") {
+                recursive = true;
+            } else if (arg == "-n") {
+                initialRun = false;
+            } else {
+                break;
+            }
+        }
+        const auto separator = std::find(command.args.begin() + static_cast<std::ptrdiff_t>(i), command.args.end(), "--");
+        if (separator == command.args.begin() + static_cast<std::ptrdiff_t>(i) || separator == command.args.end() ||
+            separator + 1 == command.args.end()) {
+            std::cerr << "watch: usage: watch [-d ms] [-r] [-n] path|glob... -- 'command line'\n";
+            return 2;
+        }
+
+        FileWatcher watcher;
+        for (auto it = command.args.begin() + static_cast<std::ptrdiff_t>(i); it != separator; ++it) {
+            std::string error;
+            if (!watcher.add(parseWatchSpec(*it, recursive), error)) {
+                std::cerr << "watch: " << error << '\n';
+                return 1;
+            }
+        }
+        std::string line;
+        for (auto it = separator + 1; it != command.args.end(); ++it) {
+            line += (line.empty() ? "" : " ") + *it;
+        }
+
+        InterruptGuard interrupt;
+
+        Run current;
+        int status = 0;
+        if (initialRun) {
+            current = start(shell, line);
+        }
+        while (!interrupt.interrupted()) {
+            std::vector<pollfd> fds{pollfd{watcher.fd(), POLLIN, 0}};
+            if (current.pid > 0 && current.pidfd != -1) {
+                fds.push_back(pollfd{current.pidfd, POLLIN, 0});
+            }
+            const bool needsTimeout = current.pid > 0 && current.pidfd == -1;
+            if (::poll(fds.data(), fds.size(), needsTimeout ? 50 : -1) == -1 && errno != EINTR) {
+                perror("watch: poll");
+                status = 1;
+                break;
+            }
+            if (current.pid > 0 && reaped(current, WNOHANG)) {
+                status = current.status;
+                if (status != 0) {
+                    std::cerr << "watch: exit " << status << '\n';
+                }
+            }
+            if (!(fds[0].revents & POLLIN)) {
+                continue;
+            }
+
+            // A burst of saves (editor swap files, a build writing many outputs) becomes one run: keep
+            // reading until the watched paths have been quiet for the whole debounce window.
+            std::vector<std::string> changed = watcher.drain();
+            pollfd quiet{watcher.fd(), POLLIN, 0};
+            while (!interrupt.interrupted() && ::poll(&quiet, 1, debounceMs) != 0) {
+                for (auto& path : watcher.drain()) {
+                    if (std::ranges::find(changed, path) == changed.end()) {
+                        changed.push_back(std::move(path));
+                    }
+                }
+            }
+            if (changed.empty() || interrupt.interrupted()) {
+                continue;
+            }
+            if (current.pid > 0) {
+                cancel(current);
+            }
+            std::cerr << "watch: " << changed.front();
+            if (changed.size() > 1) {
+                std::cerr << " (+" << changed.size() - 1 << " more)";
+            }
+            std::cerr << " changed\n";
+            current = start(shell, line);
+        }
+
+        if (current.pid > 0) {
+            cancel(current);
+        }
+        return interrupt.interrupted() ? 130 : status;
+    }
+
+private:
+    struct Run {
+        pid_t pid{-1};
+        int pidfd{-1};
+        int status{0};
+    };
+
+    // Each run is a fork of the shell in a process group of its own, so cancelling it reaches
+    // everything the command line started, pipelines and their children included.
+    static Run start(Shell& shell, const std::string& line) {
+        const std::vector<Pipeline> pipelines = shell.parser().parse(shell.expandInput(line));
+        Run run;
+        if (pipelines.empty()) {
+            return run;
+        }
+        std::cout.flush();
+        SpawnRequest request;
+        request.path = "rykeshell";
+        request.argv = {"watch"};
+        request.pgid = 0;
+        request.childMain = [&shell, &pipelines, &line]() {
+            shell.executor().forgetQueue();
+            PipelineIo io;
+            io.inheritGroup = true;
+            const int status = shell.executor().execute(pipelines, line, io);
+            std::cout.flush();
+            std::fflush(nullptr);
+            return status;
+        };
+        const SpawnResult result = spawnProcess(request, SpawnEngine::Fork);
+        if (result.pid < 0) {
+            std::cerr << "watch: " << strerror(result.error) << '\n';
+            return run;
+        }
+        run.pid = result.pid;
+#ifdef SYS_pidfd_open
+        run.pidfd = static_cast<int>(syscall(SYS_pidfd_open, run.pid, 0));
+#endif
+        return run;
+    }
+
+    static bool reaped(Run& run, int flags) {
+        int raw = 0;
+        pid_t pid;
+        while ((pid = waitpid(run.pid, &raw, flags)) == -1 && errno == EINTR) {
+        }
+        if (pid == 0) {
+            return false;
+        }
+        run.status = pid == -1 ? 1 : WIFEXITED(raw) ? WEXITSTATUS(raw) : 128 + WTERMSIG(raw);
+        if (run.pidfd != -1) {
+            close(run.pidfd);
+        }
+        run.pid = -1;
+        run.pidfd = -1;
+        return true;
+    }
+
+    // SIGTERM to the run's whole group, then SIGKILL if it is still there after a grace period.
+    static void cancel(Run& run) {
+        kill(-run.pid, SIGTERM);
+        kill(-run.pid, SIGCONT);
+        for (int waited = 0; waited < 1000 && !reaped(run, WNOHANG); waited += 10) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (run.pid > 0) {
+            kill(-run.pid, SIGKILL);
+            reaped(run, 0);
         }
     }
 };
 
+// A top(1) for the shell's own jobs. On a terminal the table is redrawn in place and only the
+// lines that changed are rewritten; elsewhere every refresh is printed as a block of its own.
+class JobTopCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& shell) override {
+        double delay = 1.0;
+        long count = 0;
+        for (std::size_t i = 1; i < command.args.size(); ++i) {
+            const std::string& arg = command.args[i];
+            char* end = nullptr;
+            if (arg == "-d" && i + 1 < command.args.size()) {
+                delay = std::strtod(command.args[++i].c_str(), &end);
+                if (*end == '\0' && delay >= 0.05 && delay <= 3600) {
+                    continue;
+                }
+            } else if (arg == "-n" && i + 1 < command.args.size()) {
+                count = std::strtol(command.args[++i].c_str(), &end, 10);
+                if (*end == '\0' && count > 0) {
+                    continue;
+                }
+            }
+            std::cerr << "jobtop: usage: jobtop [-d seconds] [-n count]\n";
+            return 2;
+        }
+
+        CommandExecutor& executor = shell.executor();
+        ProcSampler sampler;
+        if (executor.liveJobs().empty()) {
+            std::cerr << "jobtop: no jobs\n";
+            return 1;
+        }
+        sampler.sample(groupsOf(executor.liveJobs())); // the baseline CPU use is measured from
+
+        InterruptGuard interrupt;
+        const bool terminal = isatty(STDOUT_FILENO);
+        if (terminal) {
+            std::cout << "\033[?25l";
+        }
+        std::vector<std::string> shown;
+        for (long frame = 0; count == 0 || frame < count; ++frame) {
+            ::poll(nullptr, 0, static_cast<int>(delay * 1000));
+            if (interrupt.interrupted()) {
+                break;
+            }
+            const std::vector<const Job*> jobs = executor.liveJobs();
+            if (jobs.empty()) {
+                break;
+            }
+            const std::vector<GroupSample> samples = sampler.sample(groupsOf(jobs));
+            std::size_t processes = 0;
+            for (const auto& sample : samples) {
+                processes += sample.processes;
+            }
+            char summary[96];
+            std::snprintf(summary, sizeof(summary), "jobtop: %zu jobs, %zu processes, every %.2gs", jobs.size(),
+                          processes, delay);
+            std::vector<std::string> lines{summary, formatJobTopHeader()};
+            for (std::size_t i = 0; i < jobs.size(); ++i) {
+                const char* status = jobs[i]->status == Job::Status::Stopped ? "Stopped" : "Running";
+                lines.push_back(formatJobTopRow(jobs[i]->id, samples[i], status, jobs[i]->command));
+            }
+            draw(lines, shown, terminal);
+        }
+        if (terminal) {
+            std::cout << "\033[?25h" << std::flush;
+        }
+        return interrupt.interrupted() ? 130 : 0;
+    }
+
+private:
+    static std::vector<pid_t> groupsOf(const std::vector<const Job*>& jobs) {
+        std::vector<pid_t> groups;
+        groups.reserve(jobs.size());
+        for (const Job* job : jobs) {
+            groups.push_back(job->pgid);
+        }
+        return groups;
+    }
+
+    // Moves up over the previous frame and rewrites only the lines that differ from it. Lines are
+    // cut to the terminal width, since a wrapped one would throw off the cursor movement.
+    static void draw(std::vector<std::string> lines, std::vector<std::string>& shown, bool terminal) {
+        std::string out;
+        if (!terminal) {
+            for (const auto& line : lines) {
+                out += line + '\n';
+            }
+            std::cout << out << '\n' << std::flush;
+            return;
+        }
+        winsize size{};
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0) {
+            for (auto& line : lines) {
+                line.resize(std::min<std::size_t>(line.size(), size.ws_col - 1U));
+            }
+        }
+        if (!shown.empty()) {
+            out += "\033[" + std::to_string(shown.size()) + "A";
+        }
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            if (i < shown.size() && shown[i] == lines[i]) {
+                out += "\033[B";
+            } else {
+                out += "\r" + lines[i] + "\033[K\n";
+            }
+        }
+        if (lines.size() < shown.size()) {
+            out += "\033[J";
+        }
+        std::cout << out << std::flush;
+        shown = std::move(lines);
+    }
+};
+
+class ParallelCommand : public BuiltinCommand {
+public:
+    int run(const Command& command, Shell& shell) override {
+        Options opts;
+        std::vector<std::string> words;
+        std::vector<std::string> inputs;
+        if (!parseArguments(command, shell, opts, words, inputs)) {
+            std::cerr << "parallel: usage: parallel [-j N] [-k] [-q] [--fail-fast] [--summary] [-a file] "
+                         "command [{}] [::: args...]\n";
+            return 1;
+        }
+
+        bool argsFromStdin = false;
+        if (!opts.haveInputs) {
+            // Read from the descriptor itself: std::cin would stay at EOF for the next `... | parallel`.
+            if (opts.argFile.empty()) {
+                readLines(STDIN_FILENO, inputs);
+                argsFromStdin = true;
+            } else if (const int fd = open(opts.argFile.c_str(), O_RDONLY | O_CLOEXEC); fd != -1) {
+                readLines(fd, inputs);
+                close(fd);
+            } else {
+                std::cerr << "parallel: cannot open " << opts.argFile << ": " << strerror(errno) << '\n';
+                return 1;
+            }
+        }
+
+        std::vector<Task> tasks;
+        tasks.reserve(inputs.size());
+        for (const auto& input : inputs) {
+            Task task;
+            task.text = buildCommandText(words, input, opts.quoteWords);
+            task.pipelines = shell.parser().parse(task.text);
+            for (auto& pipeline : task.pipelines) {
+                pipeline.background = true; // keeps even builtin stages off the shell's thread
+            }
+            tasks.push_back(std::move(task));
+        }
+
+        int nullFd = -1;
+        if (argsFromStdin) {
+            nullFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        }
+        const int failures = runTasks(shell.executor(), tasks, opts, nullFd);
+        if (nullFd != -1) {
+            close(nullFd);
+        }
+
+        if (opts.summary) {
+            std::cerr << "parallel: seq  status     wall  command\n";
+            for (std::size_t i = 0; i < tasks.size(); ++i) {
+                const Task& task = tasks[i];
+                std::cerr << "parallel: " << std::setw(3) << std::right << i + 1 << "  "
+                          << std::setw(7) << std::left
+                          << (task.cancelled && task.status != 0 ? "killed" : task.state == Task::State::Done ? std::to_string(task.status) : "skipped")
+                          << std::setw(6) << std::right << std::fixed << std::setprecision(2) << task.wallSeconds << "s  "
+                          << task.text << '\n';
+            }
+        }
+        if (failures > 0) {
+            std::cerr << "parallel: " << failures << " of " << tasks.size() << " tasks failed\n";
+        }
+        return std::min(failures, 101);
+    }
+
+private:
+    struct Options {
+        std::size_t jobs{1};
+        bool keepOrder{false};
+        bool failFast{false};
+        bool summary{false};
+        bool quoteWords{false}; // -q: keep each template word whole instead of re-splitting the joined line
+        bool haveInputs{false};
+        std::string argFile;
+    };
+
+    struct Task {
+        enum class State { Pending, Running, Done, Skipped };
+        std::string text;
+        std::vector<Pipeline> pipelines;
+        std::size_t next{0};
+        State state{State::Pending};
+        bool cancelled{false}; // stopped by --fail-fast after another task failed; not a failure of its own
+        std::optional<LaunchedPipeline> current;
+        int status{0};
+        int outRead{-1};
+        int errRead{-1};
+        int outWrite{-1};
+        int errWrite{-1};
+        std::string out;
+        std::string err;
+        std::chrono::steady_clock::time_point started;
+        double wallSeconds{0};
+    };
+
+    static bool parseArguments(const Command& command, Shell& shell, Options& opts, std::vector<std::string>& words,
+                               std::vector<std::string>& inputs) {
+        const long online = sysconf(_SC_NPROCESSORS_ONLN);
+        opts.jobs = online > 0 ? static_cast<std::size_t>(online) : 1;
+
+        std::size_t i = 1;
+        for (; i < command.args.size(); ++i) {
+            const std::string& arg = command.args[i];
+            if (arg == "-k") {
+                opts.keepOrder = true;
+            } else if (arg == "-q") {
+                opts.quoteWords = true;
+            } else if (arg == "--fail-fast") {
+                opts.failFast = true;
+            } else if (arg == "--summary") {
+                opts.summary = true;
+            } else if (arg == "-a" && i + 1 < command.args.size()) {
+                opts.argFile = command.args[++i];
+            } else if (arg.starts_with("-j")) {
+                const std::string value = arg.size() > 2 ? arg.substr(2) : (i + 1 < command.args.size() ? command.args[++i] : "");
+                try {
+                    const long n = std::stol(value);
+                    if (n < 1) {
+                        return false;
+                    }
+                    opts.jobs = static_cast<std::size_t>(n);
+                } catch (...) {
+                    return false;
+                }
+            } else if (arg == "--") {
+                ++i;
+                break;
+            } else {
+                break;
+            }
+        }
+
+        for (; i < command.args.size(); ++i) {
+            if (command.args[i] == ":::") {
+                opts.haveInputs = true;
+                for (++i; i < command.args.size(); ++i) {
+                    expandInput(shell, command.args[i], inputs);
+                }
+                break;
+            }
+            words.push_back(command.args[i]);
+        }
+        return !words.empty();
+    }
+
+    static void expandInput(Shell& shell, const std::string& arg, std::vector<std::string>& inputs) {
+        const ShellOptions& options = shell.options();
+        if (options.noglob) {
+            inputs.push_back(arg);
+            return;
+        }
+        shell.executor().globber().expand(arg, GlobOptions{options.nullglob, options.dotglob, options.nosort}, inputs);
+    }
+
+    static void readLines(int fd, std::vector<std::string>& inputs) {
+        std::string text;
+        char buffer[64 * 1024];
+        ssize_t n;
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0 || (n == -1 && errno == EINTR)) {
+            if (n > 0) {
+                text.append(buffer, static_cast<std::size_t>(n));
+            }
+        }
+        std::size_t start = 0;
+        while (start < text.size()) {
+            const std::size_t end = std::min(text.find('\n', start), text.size());
+            if (end > start) {
+                inputs.push_back(text.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+    }
+
+    // Substitutes the input for every `{}` in the template, or appends it when there is none. The
+    // words are joined into one line for CommandParser, so `'a {} | b'` may hold a whole pipeline.
+    static std::string buildCommandText(const std::vector<std::string>& words, const std::string& input, bool quoteWords) {
+        std::string text;
+        bool substituted = false;
+        for (const auto& word : words) {
+            if (!text.empty()) {
+                text += ' ';
+            }
+            std::string expanded;
+            for (std::size_t pos = 0;;) {
+                const std::size_t marker = word.find("{}", pos);
+                if (marker == std::string::npos) {
+                    expanded.append(word, pos);
+                    break;
+                }
+                expanded.append(word, pos, marker - pos).append(quoteWords ? input : shellQuote(input));
+                substituted = true;
+                pos = marker + 2;
+            }
+            text += quoteWords ? shellQuote(expanded) : expanded;
+        }
+        if (!substituted) {
+            text += ' ' + shellQuote(input);
+        }
+        return text;
+    }
+
+    static bool openOutput(Task& task) {
+        int outPipe[2];
+        int errPipe[2];
+        if (pipe2(outPipe, O_CLOEXEC) == -1) {
+            return false;
+        }
+        if (pipe2(errPipe, O_CLOEXEC) == -1) {
+            close(outPipe[0]);
+            close(outPipe[1]);
+            return false;
+        }
+        fcntl(outPipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(errPipe[0], F_SETFL, O_NONBLOCK);
+        task.outRead = outPipe[0];
+        task.outWrite = outPipe[1];
+        task.errRead = errPipe[0];
+        task.errWrite = errPipe[1];
+        return true;
+    }
+
+    static void drain(int& fd, std::string& sink, bool closeAfter) {
+        if (fd == -1) {
+            return;
+        }
+        char buffer[16 * 1024];
+        while (true) {
+            const ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                sink.append(buffer, static_cast<std::size_t>(n));
+            } else if (n == -1 && errno == EINTR) {
+                continue;
+            } else {
+                break;
+            }
+        }
+        if (closeAfter) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    // Launches the task's next pipeline that its && / || chain allows. Pipelines that leave no
+    // process behind (a failed redirection, an unknown command) settle on the spot.
+    static void advance(CommandExecutor& executor, Task& task, int inputFd) {
+        PipelineIo io;
+        io.input = inputFd;
+        io.output = task.outWrite;
+        io.error = task.errWrite;
+        io.inheritGroup = true;
+
+        while (task.next < task.pipelines.size()) {
+            const Pipeline& pipeline = task.pipelines[task.next];
+            const bool chained = task.next > 0;
+            ++task.next;
+            if (chained && ((pipeline.condition == ChainCondition::And && task.status != 0) ||
+                            (pipeline.condition == ChainCondition::Or && task.status == 0))) {
+                continue;
+            }
+            task.current = executor.launch(pipeline, task.text, io);
+            if (!task.current->job.processes.empty()) {
+                return;
+            }
+            task.status = executor.finish(*task.current);
+            task.current.reset();
+        }
+
+        task.state = Task::State::Done;
+        task.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - task.started).count();
+        closeFd(task.outWrite);
+        closeFd(task.errWrite);
+        drain(task.outRead, task.out, true);
+        drain(task.errRead, task.err, true);
+    }
+
+    static void closeFd(int& fd) {
+        if (fd != -1) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    static void emit(Task& task) {
+        std::cout << task.out << std::flush;
+        std::cerr << task.err << std::flush;
+        task.out.clear();
+        task.err.clear();
+    }
+
+    static int runTasks(CommandExecutor& executor, std::vector<Task>& tasks, const Options& opts, int inputFd) {
+        std::size_t nextToStart = 0;
+        std::size_t nextToEmit = 0;
+        std::vector<std::size_t> running; // indices of the tasks in flight; wakeups only look at these
+        std::vector<std::size_t> finished; // done since the last round of output
+        int failures = 0;
+        bool halted = false;
+
+        // Counts a finished task; the first failure under --fail-fast stops the others.
+        auto settled = [&](Task& task) {
+            if (task.status == 0 || task.cancelled) {
+                return;
+            }
+            ++failures;
+            if (!opts.failFast || halted) {
+                return;
+            }
+            halted = true;
+            for (const std::size_t index : running) {
+                Task& other = tasks[index];
+                other.cancelled = true;
+                for (const auto& process : other.current->job.processes) {
+                    if (process.status != Job::Status::Done) {
+                        kill(process.pid, SIGTERM);
+                    }
+                }
+            }
+        };
+
+        while (true) {
+            while (!halted && running.size() < opts.jobs && nextToStart < tasks.size()) {
+                const std::size_t index = nextToStart++;
+                Task& task = tasks[index];
+                task.started = std::chrono::steady_clock::now();
+                if (!openOutput(task)) {
+                    perror("parallel: pipe");
+                    task.state = Task::State::Skipped;
+                    halted = true;
+                    break;
+                }
+                task.state = Task::State::Running;
+                advance(executor, task, inputFd);
+                if (task.state == Task::State::Running) {
+                    running.push_back(index);
+                } else {
+                    finished.push_back(index);
+                    settled(task);
+                }
+            }
+
+            // Finished tasks are printed whole, either as they finish or in input order with -k.
+            if (opts.keepOrder) {
+                while (nextToEmit < tasks.size() && tasks[nextToEmit].state != Task::State::Running &&
+                       tasks[nextToEmit].state != Task::State::Pending) {
+                    emit(tasks[nextToEmit++]);
+                }
+            } else {
+                for (const std::size_t index : finished) {
+                    emit(tasks[index]);
+                }
+            }
+            finished.clear();
+
+            if (halted && failures > 0) {
+                for (auto& task : tasks) {
+                    if (task.state == Task::State::Pending) {
+                        task.state = Task::State::Skipped;
+                    }
+                }
+            }
+            if (running.empty() && (halted || nextToStart == tasks.size())) {
+                break;
+            }
+
+            // Sleep until a task writes output or one of its processes exits (its pidfd turns readable).
+            std::vector<pollfd> fds;
+            bool needsTimeout = false;
+            for (const std::size_t index : running) {
+                const Task& task = tasks[index];
+                fds.push_back(pollfd{task.outRead, POLLIN, 0});
+                fds.push_back(pollfd{task.errRead, POLLIN, 0});
+                for (const auto& process : task.current->job.processes) {
+                    if (process.status == Job::Status::Done) {
+                        continue;
+                    }
+                    if (process.pidfd == -1) {
+                        needsTimeout = true;
+                    } else {
+                        fds.push_back(pollfd{process.pidfd, POLLIN, 0});
+                    }
+                }
+            }
+            if (::poll(fds.data(), fds.size(), needsTimeout ? 10 : -1) == -1 && errno != EINTR) {
+                perror("parallel: poll");
+                break;
+            }
+
+            for (std::size_t i = 0; i < running.size();) {
+                Task& task = tasks[running[i]];
+                drain(task.outRead, task.out, false);
+                drain(task.errRead, task.err, false);
+                if (!executor.poll(*task.current)) {
+                    ++i;
+                    continue;
+                }
+                task.status = executor.finish(*task.current);
+                task.current.reset();
+                advance(executor, task, inputFd);
+                if (task.state != Task::State::Done) {
+                    ++i;
+                    continue;
+                }
+                finished.push_back(running[i]);
+                running.erase(running.begin() + static_cast<std::ptrdiff_t>(i));
+                settled(task);
+            }
+        }
+        return failures;
+    }
+};
+
+class CoprocCommand : public BuiltinCommand {
+public:
+    // `coproc cmd ...` is recognised by the parser; a bare `coproc` lands here and lists them.
+    int run(const Command& command, Shell& shell) override {
+        if (command.args.size() > 1) {
+            std::cerr << "coproc: usage: coproc [NAME] { pipeline } | coproc command [args...]\n";
+            return 1;
+        }
+        shell.executor().listCoprocs(std::cout);
+        return 0;
+    }
+};
+
 class HelpCommand : public BuiltinCommand {
 public:
-    void run(const Command& /*command*/, Shell& /*shell*/) override {
-        std::cout << "Built-ins: cd, pwd, history, alias, prompt, theme, set, ls, export, "
-                     "jobs, fg, bg, source, plugin, exit, help\n";
+    int run(const Command& /*command*/, Shell& /*shell*/) override {
+        std::cout << "Built-ins: cd, pwd, history, alias, prompt, theme, set, ls, export, unset, "
+                     "hash, jobs, jobtop, fg, bg, coproc, sched, renice, ulimit, time, cat, cp, cache, watch, parallel, source, plugin, exit, help\n";
+        return 0;
     }
+
+    [[nodiscard]] bool readOnly() const override { return true; }
 };
 
 class SetCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& shell) override {
+    int run(const Command& command, Shell& shell) override {
         auto toggle = [&](const std::string& name, bool enable) {
             shell.applyOption(name, enable);
         };
@@ -326,9 +1654,25 @@ public:
                       << "notify=" << shell.options().notify << " "
                       << "history-ignore-dups=" << shell.options().historyIgnoreDups << " "
                       << "history-ignore-space=" << shell.options().historyIgnoreSpace << " "
-                      << "noglob=" << shell.options().noglob
-                      << '\n';
-            return;
+                      << "noglob=" << shell.options().noglob << " "
+                      << "nullglob=" << shell.options().nullglob << " "
+                      << "dotglob=" << shell.options().dotglob << " "
+                      << "nosort=" << shell.options().nosort << " "
+                      << "posix-spawn=" << shell.options().posixSpawn << " "
+                      << "pipe-fusion=" << shell.options().pipeFusion << " "
+                      << "pipestats=" << shell.options().pipeStats << " "
+                      << "tail-exec=" << shell.options().tailExec << " "
+                      << "maxjobs=" << shell.options().maxJobs << " "
+                      << "cache-size=" << shell.options().cacheSize << " "
+                      << "pipesize=" << formatPipeSizing(shell.options().pipeSize) << " "
+                      << "argbatch=" << formatArgBatching(shell.options().argBatch) << " "
+                      << "argbatch-jobs=" << shell.options().argBatch.jobs;
+            for (const char* name : kSchedAttrNames) {
+                const std::string value = formatSchedAttr(shell.options().sched, name);
+                std::cout << ' ' << name << '=' << (value.empty() ? "default" : value);
+            }
+            std::cout << '\n';
+            return 0;
         }
 
         for (std::size_t i = 1; i < command.args.size(); ++i) {
@@ -357,32 +1701,34 @@ public:
                 toggle("noglob", false);
             }
         }
+        return 0;
     }
 };
 
 class SourceCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& shell) override {
+    int run(const Command& command, Shell& shell) override {
         if (command.args.size() < 2) {
             std::cerr << "source: filename required\n";
-            return;
+            return 1;
         }
         shell.runScript(command.args[1]);
+        return 0;
     }
 };
 
 class PluginCommand : public BuiltinCommand {
 public:
-    void run(const Command& command, Shell& shell) override {
+    int run(const Command& command, Shell& shell) override {
         if (command.args.size() < 3 || command.args[1] != "load") {
             std::cerr << "plugin: usage: plugin load <path>\n";
-            return;
+            return 1;
         }
         const std::string& path = command.args[2];
         void* handle = dlopen(path.c_str(), RTLD_LAZY);
         if (!handle) {
             std::cerr << "plugin: " << dlerror() << '\n';
-            return;
+            return 1;
         }
         using RegisterFn = void(*)(Shell&);
         dlerror();
@@ -390,9 +1736,10 @@ public:
         if (const char* err = dlerror()) {
             std::cerr << "plugin: " << err << '\n';
             dlclose(handle);
-            return;
+            return 1;
         }
         fn(shell);
+        return 0;
     }
 };
 
@@ -408,9 +1755,22 @@ void registerBuiltinCommands(CommandRegistry& registry) {
     registry.registerCommand("prompt", std::make_unique<PromptCommand>());
     registry.registerCommand("ls", std::make_unique<LsCommand>());
     registry.registerCommand("export", std::make_unique<ExportCommand>());
+    registry.registerCommand("unset", std::make_unique<UnsetCommand>());
+    registry.registerCommand("hash", std::make_unique<HashCommand>());
     registry.registerCommand("jobs", std::make_unique<JobsCommand>());
     registry.registerCommand("fg", std::make_unique<FgCommand>());
     registry.registerCommand("bg", std::make_unique<BgCommand>());
+    registry.registerCommand("coproc", std::make_unique<CoprocCommand>());
+    registry.registerCommand("sched", std::make_unique<SchedCommand>());
+    registry.registerCommand("renice", std::make_unique<ReniceCommand>());
+    registry.registerCommand("ulimit", std::make_unique<UlimitCommand>());
+    registry.registerCommand("time", std::make_unique<TimeCommand>());
+    registry.registerCommand("cat", std::make_unique<CatCommand>());
+    registry.registerCommand("cp", std::make_unique<CpCommand>());
+    registry.registerCommand("cache", std::make_unique<CacheCommand>());
+    registry.registerCommand("watch", std::make_unique<WatchCommand>());
+    registry.registerCommand("jobtop", std::make_unique<JobTopCommand>());
+    registry.registerCommand("parallel", std::make_unique<ParallelCommand>());
     registry.registerCommand("set", std::make_unique<SetCommand>());
     registry.registerCommand("source", std::make_unique<SourceCommand>());
     registry.registerCommand("plugin", std::make_unique<PluginCommand>());
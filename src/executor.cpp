@@ -1,16 +1,26 @@
 #include "ryke_shell.h"
+#include "fd_writer.h"
+#include "launcher.h"
 #include "utils.h"
 
 #include <algorithm>
+#include <chrono>
 #include <csignal>
 #include <cerrno>
+#include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <fcntl.h>
-#include <glob.h>
+#include <filesystem>
 #include <iostream>
+#include <optional>
+#include <pthread.h>
 #include <ranges>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -18,34 +28,449 @@ namespace ryke {
 
 namespace {
 
-std::vector<char*> buildArgv(const Command& command, bool enableGlob) {
-    std::vector<char*> args;
+// Where the words produced by matching globs sit in an expanded argv: [first, end).
+struct GlobSpan {
+    std::size_t first{0};
+    std::size_t end{0};
+};
+
+// Globs are expanded here in the shell, so the listings they read stay cached for the next command.
+// `span` receives the range from the first to the last word produced by a matching glob, or an
+// empty range at args.size() when nothing matched.
+std::vector<std::string> expandArguments(const Command& command, GlobEngine* globber, const GlobOptions& options,
+                                         GlobSpan& span) {
+    std::vector<std::string> args;
+    args.reserve(command.args.size());
+    span.first = std::string::npos;
+    span.end = 0;
     for (const auto& arg : command.args) {
-        if (enableGlob) {
-            glob_t globResults{};
-            if (const int globRet = glob(arg.c_str(), GLOB_NOCHECK | GLOB_TILDE, nullptr, &globResults); globRet == 0) {
-                for (std::size_t i = 0; i < globResults.gl_pathc; ++i) {
-                    args.push_back(strdup(globResults.gl_pathv[i]));
-                }
-            } else {
-                args.push_back(strdup(arg.c_str()));
-            }
-            globfree(&globResults);
-        } else {
-            args.push_back(strdup(arg.c_str()));
+        if (!globber) {
+            args.push_back(arg);
+            continue;
+        }
+        const std::size_t before = args.size();
+        if (globber->expand(arg, options, args) > 0) {
+            span.first = std::min(span.first, before);
+            span.end = args.size();
         }
     }
-    args.push_back(nullptr);
+    if (span.first == std::string::npos) {
+        span.first = span.end = args.size();
+    }
     return args;
 }
 
+void closeFd(int& fd) {
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
 void closePipe(int pipeFd[2]) {
-    if (pipeFd[0] != -1) {
-        close(pipeFd[0]);
+    closeFd(pipeFd[0]);
+    closeFd(pipeFd[1]);
+}
+
+// Opens the stage's redirection targets in the shell and turns them into dup2 actions for the
+// child. Files are applied before descriptor dups so duplication targets see updated fds.
+bool openRedirections(const Command& command, bool noclobber, std::vector<FdAction>& actions, std::vector<int>& opened) {
+    if (command.inputFile) {
+        const int fd = open(command.inputFile->c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            perror("open");
+            return false;
+        }
+        opened.push_back(fd);
+        actions.push_back(FdAction{fd, STDIN_FILENO});
+    }
+
+    std::vector<Command::FdRedirection> redirs = command.fdRedirections;
+    if (command.outputFile) {
+        redirs.push_back(Command::FdRedirection{1, Command::FdRedirection::Type::Truncate, *command.outputFile, 1});
+    } else if (command.appendFile) {
+        redirs.push_back(Command::FdRedirection{1, Command::FdRedirection::Type::Append, *command.appendFile, 1});
+    }
+    if (command.stderrFile) {
+        redirs.push_back(Command::FdRedirection{2, Command::FdRedirection::Type::Truncate, *command.stderrFile, 2});
+    } else if (command.stderrAppendFile) {
+        redirs.push_back(Command::FdRedirection{2, Command::FdRedirection::Type::Append, *command.stderrAppendFile, 2});
+    } else if (command.mergeStderr) {
+        redirs.push_back(Command::FdRedirection{2, Command::FdRedirection::Type::Dup, "", 1});
+    }
+
+    for (const auto& r : redirs) {
+        if (r.type == Command::FdRedirection::Type::Dup) continue;
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+        if (r.type == Command::FdRedirection::Type::Read) {
+            flags = O_RDONLY | O_CLOEXEC;
+        } else if (r.type == Command::FdRedirection::Type::Append) {
+            flags |= O_APPEND;
+        } else {
+            // Like bash, noclobber protects regular files only; /dev/null and /dev/fd/N stay writable.
+            struct stat st {};
+            const bool special = stat(r.target.c_str(), &st) == 0 && !S_ISREG(st.st_mode);
+            flags |= noclobber && !special ? O_EXCL : O_TRUNC;
+        }
+        const int fd = open(r.target.c_str(), flags, 0644);
+        if (fd == -1) {
+            perror("open");
+            return false;
+        }
+        opened.push_back(fd);
+        actions.push_back(FdAction{fd, r.fd});
+    }
+    for (const auto& r : redirs) {
+        if (r.type == Command::FdRedirection::Type::Dup) {
+            actions.push_back(FdAction{r.dupFd, r.fd});
+        }
+    }
+    return true;
+}
+
+bool hasRedirections(const Command& command) {
+    return command.inputFile || command.outputFile || command.appendFile || command.stderrFile ||
+           command.stderrAppendFile || command.mergeStderr || command.heredocDelimiter || command.heredocData ||
+           command.hereString || !command.fdRedirections.empty() || !command.processSubstitutions.empty();
+}
+
+bool writesStdout(const Command& command) {
+    return command.outputFile || command.appendFile || command.mergeStderr ||
+           std::ranges::any_of(command.fdRedirections, [](const auto& r) { return r.fd == STDOUT_FILENO; });
+}
+
+bool readsStdin(const Command& command) {
+    return command.inputFile || command.heredocDelimiter || command.heredocData || command.hereString ||
+           std::ranges::any_of(command.fdRedirections, [](const auto& r) { return r.fd == STDIN_FILENO; });
+}
+
+// A `cat` stage whose only job is moving bytes: `cat FILE` with a readable regular file and no
+// redirections of its own. Anything else (flags, several files, globs, fifos) keeps its process.
+std::optional<std::string> plainCatSource(const Command& command) {
+    if (command.args.size() != 2 || command.args[0] != "cat" || hasRedirections(command)) {
+        return std::nullopt;
+    }
+    const std::string& file = command.args[1];
+    if (file.empty() || file.front() == '-' || file.find_first_of("*?[") != std::string::npos) {
+        return std::nullopt;
+    }
+    struct stat st {};
+    if (stat(file.c_str(), &st) == -1 || !S_ISREG(st.st_mode) || access(file.c_str(), R_OK) == -1) {
+        return std::nullopt;
+    }
+    return file;
+}
+
+bool isBareCat(const Command& command) {
+    return command.args.size() == 1 && command.args[0] == "cat";
+}
+
+// Rewrites stages that only copy data into redirections on their neighbours, so they cost
+// neither a process nor a trip through an extra pipe:
+//   cat FILE | cmd ...   ->  cmd < FILE ...
+//   ... | cat | ...      ->  ... | ...
+//   ... cmd | cat > OUT  ->  ... cmd > OUT        (also `>>`)
+// A trailing bare `| cat` is left alone; it is commonly used to hide the terminal from cmd.
+// catStatus is set when the trailing cat went away: the pipeline must still end with its status.
+std::vector<std::string> fuseCatStages(Pipeline& pipeline, bool& catStatus) {
+    std::vector<std::string> notes;
+    auto& stages = pipeline.stages;
+
+    if (stages.size() > 1 && !stages[1].args.empty() && !readsStdin(stages[1])) {
+        if (auto file = plainCatSource(stages.front())) {
+            stages[1].inputFile = std::move(*file);
+            notes.push_back("cat " + *stages[1].inputFile + " -> stdin of " + stages[1].args.front());
+            stages.erase(stages.begin());
+        }
+    }
+
+    for (std::size_t i = 1; i + 1 < stages.size();) {
+        if (isBareCat(stages[i]) && !hasRedirections(stages[i])) {
+            notes.push_back("dropped pass-through cat after " + stages[i - 1].args.front());
+            stages.erase(stages.begin() + static_cast<std::ptrdiff_t>(i));
+        } else {
+            ++i;
+        }
+    }
+
+    if (stages.size() > 1) {
+        Command& last = stages.back();
+        Command& feeder = stages[stages.size() - 2];
+        const bool onlyOutput = (last.outputFile || last.appendFile) && !last.inputFile && !last.stderrFile &&
+                                !last.stderrAppendFile && !last.mergeStderr && !last.heredocDelimiter &&
+                                !last.heredocData && !last.hereString && last.fdRedirections.empty() &&
+                                last.processSubstitutions.empty(); // `cat > >(cmd)` names no file to move
+        if (isBareCat(last) && onlyOutput && !writesStdout(feeder) && !feeder.args.empty() &&
+            feeder.processSubstitutions.empty()) {
+            feeder.outputFile = std::move(last.outputFile);
+            feeder.appendFile = std::move(last.appendFile);
+            const std::string& target = feeder.outputFile ? *feeder.outputFile : *feeder.appendFile;
+            notes.push_back("cat > " + target + " -> stdout of " + feeder.args.front());
+            stages.pop_back();
+            catStatus = true;
+        }
+    }
+    return notes;
+}
+
+std::string heredocBody(const Command& command, const ShellOptions* options) {
+    std::string data;
+    if (command.hereString) {
+        data = *command.hereString;
+    } else if (command.heredocData) {
+        data = *command.heredocData;
+    } else {
+        std::string line;
+        while (true) {
+            std::cout << "> ";
+            std::cout.flush();
+            if (!std::getline(std::cin, line)) {
+                break;
+            }
+            std::string_view view(line);
+            if (command.heredocStripTabs) {
+                view.remove_prefix(std::min(view.find_first_not_of('\t'), view.size()));
+            }
+            if (view == *command.heredocDelimiter) {
+                break;
+            }
+            data.append(view).push_back('\n');
+        }
     }
-    if (pipeFd[1] != -1) {
-        close(pipeFd[1]);
+    if (command.heredocExpand) {
+        try {
+            data = expandVariables(data, options);
+        } catch (...) {
+            // ignore expansion errors in heredoc
+        }
+    }
+    return data;
+}
+
+bool writeAll(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        const ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
     }
+    return true;
+}
+
+// Returns a descriptor the stage reads the document from. The body goes into a sealed memfd in a
+// single pass, so the shell never blocks on a full pipe; where memfd is unavailable a writer
+// thread feeds a pipe instead.
+int openHeredoc(std::string data, const PipeSizing& sizing, std::vector<std::thread>& writers) {
+    const int memFd = memfd_create("rykeshell-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memFd != -1) {
+        if (writeAll(memFd, data.data(), data.size()) && lseek(memFd, 0, SEEK_SET) == 0) {
+            fcntl(memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+            return memFd;
+        }
+        close(memFd);
+    }
+
+    int pipeFd[2] = {-1, -1};
+    if (pipe2(pipeFd, O_CLOEXEC) == -1) {
+        return -1;
+    }
+    // The whole body is known up front, so the adaptive size is one that holds all of it.
+    if (sizing.adaptive && data.size() > 65536) {
+        resizePipe(pipeFd[1], static_cast<long>(data.size()));
+    } else if (sizing.bytes > 0) {
+        resizePipe(pipeFd[1], sizing.bytes);
+    }
+    writers.emplace_back([fd = pipeFd[1], body = std::move(data)]() {
+        // A reader that exits early must surface as EPIPE here, not as SIGPIPE to the shell.
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+        writeAll(fd, body.data(), body.size());
+        close(fd);
+    });
+    return pipeFd[0];
+}
+
+// Applies a stage's descriptor actions to the shell itself for the lifetime of the object, so a
+// builtin can run in-process with the same stdio a launched child would have had.
+class ScopedFdActions {
+public:
+    explicit ScopedFdActions(const std::vector<FdAction>& actions) {
+        flushStreams();
+        for (const auto& action : actions) {
+            const bool saved = std::ranges::any_of(saved_, [&](const Saved& s) { return s.target == action.target; });
+            if (!saved) {
+                saved_.push_back(Saved{action.target, fcntl(action.target, F_DUPFD_CLOEXEC, 10)});
+            }
+            if (action.source != action.target) {
+                dup2(action.source, action.target);
+            }
+        }
+    }
+
+    ~ScopedFdActions() {
+        flushStreams();
+        for (auto it = saved_.rbegin(); it != saved_.rend(); ++it) {
+            if (it->copy != -1) {
+                dup2(it->copy, it->target);
+                close(it->copy);
+            } else {
+                close(it->target);
+            }
+        }
+    }
+
+    ScopedFdActions(const ScopedFdActions&) = delete;
+    ScopedFdActions& operator=(const ScopedFdActions&) = delete;
+
+private:
+    struct Saved {
+        int target;
+        int copy;
+    };
+
+    static void flushStreams() {
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+    }
+
+    std::vector<Saved> saved_;
+};
+
+// Exports a builtin's `NAME=value` prefix for the lifetime of the object, then puts back whatever
+// the shell had before, so `HOME=/tmp cd` behaves like the same prefix on an external command.
+class ScopedAssignments {
+public:
+    explicit ScopedAssignments(const std::vector<std::pair<std::string, std::string>>& assignments) {
+        VariableStore& variables = shellVariables();
+        for (const auto& [name, value] : assignments) {
+            const std::string* previous = variables.find(name);
+            saved_.push_back(Saved{name, previous ? std::optional<std::string>(*previous) : std::nullopt,
+                                   variables.isExported(name)});
+            variables.exportVariable(name, value);
+        }
+    }
+
+    ~ScopedAssignments() {
+        VariableStore& variables = shellVariables();
+        for (auto it = saved_.rbegin(); it != saved_.rend(); ++it) {
+            variables.unset(it->name);
+            if (it->value && it->exported) {
+                variables.exportVariable(it->name, std::move(*it->value));
+            } else if (it->value) {
+                variables.set(it->name, std::move(*it->value));
+            }
+        }
+    }
+
+    ScopedAssignments(const ScopedAssignments&) = delete;
+    ScopedAssignments& operator=(const ScopedAssignments&) = delete;
+
+private:
+    struct Saved {
+        std::string name;
+        std::optional<std::string> value;
+        bool exported;
+    };
+
+    std::vector<Saved> saved_;
+};
+
+// Starts the pipelines behind a stage's `<(...)` and `>(...)` words in the stage's process group
+// and rewrites the words to /dev/fd/N. The stage keeps N open through an fd action onto itself;
+// the shell's copy is closed along with the stage's other opened descriptors.
+bool startSubstitutions(CommandExecutor& executor, Command& command, pid_t& pgid, std::vector<pid_t>& childPids,
+                        std::vector<std::thread>& writers, std::vector<FdAction>& actions, std::vector<int>& opened) {
+    for (const auto& substitution : command.processSubstitutions) {
+        int pipeFd[2] = {-1, -1};
+        if (pipe2(pipeFd, O_CLOEXEC) == -1) {
+            perror("process substitution");
+            return false;
+        }
+        const int stageEnd = substitution.output ? pipeFd[1] : pipeFd[0];
+        const int innerEnd = substitution.output ? pipeFd[0] : pipeFd[1];
+        PipelineIo io;
+        (substitution.output ? io.input : io.output) = innerEnd;
+        io.group = pgid;
+
+        const std::vector<Pipeline> pipelines = CommandParser{}.parse(substitution.command);
+        if (pipelines.size() == 1 && !pipelines.front().coproc) {
+            Pipeline inner = pipelines.front();
+            inner.background = true; // never run a builtin in the shell itself while the stage waits to start
+            LaunchedPipeline launched = executor.launch(inner, substitution.command, io);
+            for (const auto& process : launched.job.processes) {
+                childPids.push_back(process.pid);
+            }
+            if (pgid == 0) {
+                pgid = launched.job.pgid;
+            }
+            for (auto& writer : launched.heredocWriters) {
+                writers.push_back(std::move(writer));
+            }
+            JobTable::release(launched.job); // the consuming job opens its own pidfds
+        } else if (!pipelines.empty()) {
+            // A list such as `a && b` runs in a forked copy of the shell, as a subshell would.
+            SpawnRequest request;
+            request.pgid = pgid;
+            request.argv = {"rykeshell"};
+            request.path = "rykeshell";
+            request.childMain = [&executor, &pipelines, &substitution, io]() mutable {
+                executor.forgetQueue();
+                io.group = 0;
+                io.inheritGroup = true;
+                const int status = executor.execute(pipelines, substitution.command, io);
+                std::cout.flush();
+                std::fflush(nullptr);
+                return status;
+            };
+            const SpawnResult result = spawnProcess(request, SpawnEngine::Fork);
+            if (result.pid > 0) {
+                childPids.push_back(result.pid);
+                pgid = pgid == 0 ? result.pid : pgid;
+            }
+        }
+        close(innerEnd);
+
+        actions.push_back(FdAction{stageEnd, stageEnd});
+        opened.push_back(stageEnd);
+        const std::string path = "/dev/fd/" + std::to_string(stageEnd);
+        if (substitution.arg) {
+            command.args[*substitution.arg] = path;
+        } else if (!substitution.output) {
+            command.inputFile = path;
+        } else if (command.appendFile) {
+            command.appendFile = path;
+        } else {
+            command.outputFile = path;
+        }
+    }
+    command.processSubstitutions.clear();
+    return true;
+}
+
+// For a forked child before exec: no allocation, since another thread may have held the malloc
+// lock at fork time.
+void reportChildError(const char* what, int error) {
+    const char* reason = strerror(error);
+    (void)!write(STDERR_FILENO, "ryke: ", 6);
+    (void)!write(STDERR_FILENO, what, strlen(what));
+    (void)!write(STDERR_FILENO, ": ", 2);
+    (void)!write(STDERR_FILENO, reason, strlen(reason));
+    (void)!write(STDERR_FILENO, "\n", 1);
+}
+
+void joinWriters(std::vector<std::thread>& writers) {
+    for (auto& writer : writers) {
+        if (writer.joinable()) {
+            writer.join();
+        }
+    }
+    writers.clear();
 }
 
 } // namespace
@@ -54,9 +479,10 @@ CommandExecutor::CommandExecutor(pid_t shellPgid, int terminalFd, const ShellOpt
                                  std::function<void(const std::string&)> notifier)
     : shellPgid_(shellPgid), terminalFd_(terminalFd), options_(options), notify_(std::move(notifier)) {}
 
-int CommandExecutor::execute(const std::vector<Pipeline>& pipelines, const std::string& commandLine) {
+int CommandExecutor::execute(const std::vector<Pipeline>& pipelines, const std::string& commandLine, const PipelineIo& io) {
     int lastStatus = 0;
     bool hasPrevious = false;
+    dispatchQueued();
 
     if (options_ && options_->xtrace) {
         std::cerr << "+ " << commandLine << '\n';
@@ -70,7 +496,7 @@ int CommandExecutor::execute(const std::vector<Pipeline>& pipelines, const std::
             continue;
         }
 
-        lastStatus = executePipeline(pipeline, commandLine);
+        lastStatus = executePipeline(pipeline, commandLine, io);
         hasPrevious = true;
     }
 
@@ -78,57 +504,145 @@ int CommandExecutor::execute(const std::vector<Pipeline>& pipelines, const std::
 }
 
 void CommandExecutor::reapBackground() {
-    int status = 0;
-    pid_t pid;
-    while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0) {
-        const pid_t pgid = getpgid(pid);
-        if (pgid == -1) {
-            continue;
+    collectFinished();
+    for (const int id : finished_) {
+        if (options_ && options_->notify && notify_) {
+            const Job* job = jobs_.find(id);
+            notify_("job [" + std::to_string(id) + "] done" +
+                    (job && !job->limitHit.empty() ? " (" + job->limitHit + ")" : ""));
         }
-        for (auto& job : jobs_) {
-            if (job.pgid != pgid) {
-                continue;
-            }
-            if (WIFEXITED(status)) {
-                job.status = Job::Status::Done;
-                job.exitCode = WEXITSTATUS(status);
-            } else if (WIFSIGNALED(status)) {
-                job.status = Job::Status::Done;
-                job.exitCode = 128 + WTERMSIG(status);
-            } else if (WIFSTOPPED(status)) {
-                job.status = Job::Status::Stopped;
-            } else if (WIFCONTINUED(status)) {
-                job.status = Job::Status::Running;
-            }
-            if (job.status == Job::Status::Done && options_ && options_->notify && notify_) {
-                notify_("job [" + std::to_string(job.id) + "] done");
+    }
+    finished_.clear();
+    dispatchQueued();
+}
+
+void CommandExecutor::collectFinished() {
+    const std::vector<int> reaped = jobs_.reap();
+    finished_.insert(finished_.end(), reaped.begin(), reaped.end());
+}
+
+// Background jobs that hold a `maxjobs` slot. Stopped jobs and coprocesses do not.
+std::size_t CommandExecutor::runningJobs() const {
+    return static_cast<std::size_t>(std::ranges::count_if(jobs_.ordered(), [](const Job* job) {
+        return job->status == Job::Status::Running && job->coproc.empty();
+    }));
+}
+
+void CommandExecutor::dispatchQueued() {
+    if (queue_.empty()) {
+        return;
+    }
+    collectFinished();
+    const unsigned limit = options_ ? options_->maxJobs : 0;
+    while (!queue_.empty() && (limit == 0 || runningJobs() < limit)) {
+        QueuedJob next = std::move(queue_.front());
+        queue_.pop_front();
+        startQueued(next);
+    }
+}
+
+void CommandExecutor::drainQueue() {
+    dispatchQueued();
+    while (!queue_.empty()) {
+        // Sleeps until some child has exited, leaving it for the job table to collect.
+        siginfo_t info{};
+        if (waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) == -1 && errno == ECHILD) {
+            // Nothing left running to wait for, so the rest can start regardless of the limit.
+            while (!queue_.empty()) {
+                QueuedJob next = std::move(queue_.front());
+                queue_.pop_front();
+                startQueued(next);
             }
         }
+        dispatchQueued();
     }
 }
 
+// Launches a queued job from the directory it was submitted in, so its globs, redirections and
+// relative paths resolve there, and then returns the shell to its own directory.
+int CommandExecutor::startQueued(QueuedJob& queued) {
+    const int home = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (!queued.directory.empty() && chdir(queued.directory.c_str()) == -1) {
+        std::cerr << '[' << queued.id << "] " << queued.directory << ": " << strerror(errno) << '\n';
+        if (home != -1) {
+            close(home);
+        }
+        return 1;
+    }
+    const int status = queued.pipeline.background
+        ? startBackground(queued.pipeline, queued.commandLine, queued.io, queued.id, false)
+        : executePipeline(queued.pipeline, queued.commandLine, queued.io);
+    if (home != -1) {
+        if (fchdir(home) == -1) {
+            perror("fchdir");
+        }
+        close(home);
+    }
+    return status;
+}
+
+bool CommandExecutor::hasJobs() {
+    reapBackground();
+    return !queue_.empty() || std::ranges::any_of(jobs_.ordered(), [](const Job* job) { return job->status != Job::Status::Done; });
+}
+
+std::vector<const Job*> CommandExecutor::liveJobs() {
+    collectFinished();
+    dispatchQueued();
+    std::vector<const Job*> live = jobs_.ordered();
+    std::erase_if(live, [](const Job* job) { return job->status == Job::Status::Done; });
+    return live;
+}
+
 void CommandExecutor::listJobs(std::ostream& os, bool verbose) {
-    pruneDone();
-    for (const auto& job : jobs_) {
+    reapBackground();
+    for (const Job* job : jobs_.ordered()) {
         std::string status;
-        switch (job.status) {
+        switch (job->status) {
             case Job::Status::Running: status = "Running"; break;
             case Job::Status::Stopped: status = "Stopped"; break;
             case Job::Status::Done: status = "Done"; break;
         }
+        if (!job->limitHit.empty()) {
+            status += " (" + job->limitHit + ")";
+        }
         if (verbose) {
-            os << '[' << job.id << "] " << job.pgid << ' ' << status << " " << job.command << '\n';
+            os << '[' << job->id << "] " << job->pgid << ' ' << status << " " << job->command << '\n';
+            ResourceUsage usage = job->usage;
+            if (job->status != Job::Status::Done) {
+                usage.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job->started).count();
+            }
+            os << "    " << formatResourceUsage(kDefaultUsageFormat, usage, job->command, job->exitCode) << '\n';
+            if (job->pipeStats) {
+                os << formatPipeStats(*job->pipeStats, "    ");
+            }
         } else {
-            os << '[' << job.id << "] " << status << " " << job.command << '\n';
+            os << '[' << job->id << "] " << status << " " << job->command << '\n';
         }
     }
+    // Queued jobs have no process group yet; their position says how many start before them.
+    std::size_t position = 0;
+    for (const QueuedJob& queued : queue_) {
+        os << '[' << queued.id << "] " << (verbose ? "- " : "") << "Queued (" << ++position << ") "
+           << queued.commandLine << '\n';
+    }
+    // Finished jobs are listed once, with their final usage, and then forgotten.
+    pruneJobs();
 }
 
 bool CommandExecutor::foregroundJob(int jobId) {
     if (options_ && !options_->monitor) {
         return false;
     }
-    Job* job = jobId == -1 ? lastJob() : findJob(jobId);
+    // A queued job brought to the foreground skips the queue and runs now.
+    if (const auto queued = std::ranges::find(queue_, jobId, &QueuedJob::id); queued != queue_.end()) {
+        QueuedJob next = std::move(*queued);
+        queue_.erase(queued);
+        next.pipeline.background = false;
+        startQueued(next);
+        return true;
+    }
+    Job* job = resolveJob(jobId);
     if (!job) {
         return false;
     }
@@ -139,19 +653,10 @@ bool CommandExecutor::foregroundJob(int jobId) {
         kill(-job->pgid, SIGCONT);
     }
 
-    int status = 0;
-    waitpid(-job->pgid, &status, WUNTRACED);
+    jobs_.wait(*job);
     restoreTerminal();
     currentFgPgid_ = 0;
-
-    if (WIFSTOPPED(status)) {
-        job->status = Job::Status::Stopped;
-        return true;
-    }
-
-    job->status = Job::Status::Done;
-    job->exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : (WIFSIGNALED(status) ? 128 + WTERMSIG(status) : status);
-    pruneDone();
+    pruneJobs();
     return true;
 }
 
@@ -159,244 +664,637 @@ bool CommandExecutor::backgroundJob(int jobId) {
     if (options_ && !options_->monitor) {
         return false;
     }
-    Job* job = jobId == -1 ? lastJob() : findJob(jobId);
+    Job* job = resolveJob(jobId);
     if (!job) {
         return false;
     }
     if (job->status == Job::Status::Stopped) {
         kill(-job->pgid, SIGCONT);
+        for (auto& process : job->processes) {
+            if (process.status == Job::Status::Stopped) {
+                process.status = Job::Status::Running;
+            }
+        }
         job->status = Job::Status::Running;
     }
     return true;
 }
 
+std::optional<int> CommandExecutor::rescheduleJob(int jobId, const SchedAttrs& attrs) {
+    Job* job = resolveJob(jobId);
+    if (!job) {
+        return std::nullopt;
+    }
+    std::vector<pid_t> pids;
+    for (const auto& process : job->processes) {
+        if (process.status != Job::Status::Done) {
+            pids.push_back(process.pid);
+        }
+    }
+    return applySchedAttrsToJob(attrs, job->pgid, pids);
+}
+
 void CommandExecutor::stopForeground() {
     if (currentFgPgid_ > 0) {
         kill(-currentFgPgid_, SIGTSTP);
     }
 }
 
-int CommandExecutor::executePipeline(const Pipeline& pipeline, const std::string& commandLine) {
-    if (pipeline.stages.empty()) {
-        return 0;
+int CommandExecutor::capture(const std::vector<Pipeline>& pipelines, const std::string& commandLine, std::string& output) {
+    return captureOutput([&](int fd) {
+        PipelineIo io;
+        io.output = fd;
+        io.inheritGroup = true;
+        if (!changesShell(pipelines)) {
+            return execute(pipelines, commandLine, io);
+        }
+        // `$(cd /)`, `$(A=1)` and `$(exit 3)` act on a forked subshell, as in any other shell.
+        SpawnRequest request;
+        request.path = "rykeshell";
+        request.argv = {"rykeshell"};
+        request.pgid = getpgrp();
+        request.childMain = [this, &pipelines, &commandLine, io]() {
+            forgetQueue();
+            const int status = execute(pipelines, commandLine, io);
+            std::cout.flush();
+            std::fflush(nullptr);
+            return status;
+        };
+        const SpawnResult result = spawnProcess(request, SpawnEngine::Fork);
+        if (result.pid < 0) {
+            std::cerr << "command substitution: " << strerror(result.error) << '\n';
+            return 1;
+        }
+        int status = 0;
+        while (waitpid(result.pid, &status, 0) == -1) {
+            if (errno != EINTR) {
+                return 1;
+            }
+        }
+        return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }, output);
+}
+
+// Whether running the pipelines in the shell could leave it changed: a builtin that is not
+// read-only or a bare assignment in a stage the shell runs itself, or a job left behind.
+bool CommandExecutor::changesShell(const std::vector<Pipeline>& pipelines) const {
+    return std::ranges::any_of(pipelines, [this](const Pipeline& pipeline) {
+        if (pipeline.background || pipeline.coproc) {
+            return true;
+        }
+        if (pipeline.stages.empty()) {
+            return false;
+        }
+        const Command& last = pipeline.stages.back();
+        if (last.args.empty()) {
+            return true;
+        }
+        const bool builtin = builtins_.contains && builtins_.contains(last.args.front()) &&
+                             (!builtins_.accepts || builtins_.accepts(last));
+        return builtin && !(builtins_.readOnly && builtins_.readOnly(last));
+    });
+}
+
+int CommandExecutor::captureOutput(const std::function<int(int fd)>& producer, std::string& output) {
+    int pipeFd[2] = {-1, -1};
+    if (pipe2(pipeFd, O_CLOEXEC) == -1) {
+        perror("pipe");
+        return 1;
+    }
+
+    // Drained concurrently so a producer never stalls on a full pipe while the shell waits on it.
+    std::thread reader([&output, fd = pipeFd[0]]() {
+        std::string buffer(64 * 1024, '\0');
+        while (true) {
+            const ssize_t n = read(fd, buffer.data(), buffer.size());
+            if (n > 0) {
+                output.append(buffer.data(), static_cast<std::size_t>(n));
+            } else if (n == 0 || errno != EINTR) {
+                break;
+            }
+        }
+    });
+
+    const int status = producer(pipeFd[1]);
+    close(pipeFd[1]);
+    reader.join();
+    close(pipeFd[0]);
+    return status;
+}
+
+LaunchedPipeline CommandExecutor::launch(const Pipeline& requested, const std::string& commandLine, const PipelineIo& io) {
+    // A builtin running in the shell may still hold buffered output for a descriptor the new
+    // processes share; it goes out before they can write.
+    std::cout.flush();
+
+    LaunchedPipeline launched;
+    launched.job.command = commandLine;
+    if (requested.stages.empty()) {
+        launched.lastStageStatus = 0;
+        return launched;
+    }
+
+    std::optional<Pipeline> fused;
+    bool catStatus = false;
+    if ((!options_ || options_->pipeFusion) && requested.stages.size() > 1) {
+        Pipeline candidate = requested;
+        const std::vector<std::string> notes = fuseCatStages(candidate, catStatus);
+        if (!notes.empty()) {
+            if (options_ && options_->xtrace) {
+                for (const auto& note : notes) {
+                    std::cerr << "+ fused: " << note << '\n';
+                }
+            }
+            fused = std::move(candidate);
+        }
+    }
+    const Pipeline& pipeline = fused ? *fused : requested;
+
+    // A builtin stage forked off the shell that runs commands itself (`time cmd | ...`) is already
+    // inside the pipeline's group; its children stay there and leave the terminal alone.
+    const bool nested = io.inheritGroup || getpgrp() != shellPgid_;
+    const bool monitor = (!options_ || options_->monitor) && !nested;
+    const bool noclobber = options_ && options_->noclobber;
+    GlobEngine* globber = (options_ && options_->noglob) ? nullptr : &globber_;
+    GlobOptions globOptions;
+    if (options_) {
+        globOptions = GlobOptions{options_->nullglob, options_->dotglob, options_->nosort};
+    }
+    const SpawnEngine engine = (options_ && !options_->posixSpawn) ? SpawnEngine::Fork : SpawnEngine::PosixSpawn;
+    const int terminalFd = (!pipeline.background && monitor && isatty(terminalFd_)) ? terminalFd_ : -1;
+    const PipeSizing sizing = pipeline.pipeSize ? *pipeline.pipeSize : options_ ? options_->pipeSize : PipeSizing{};
+    PipeGrower grower;
+    SchedAttrs sched = options_ ? options_->sched : SchedAttrs{};
+    if (pipeline.sched) {
+        sched.merge(*pipeline.sched);
+    }
+
+    std::shared_ptr<PipeStats> stats;
+    if (options_ && options_->pipeStats && pipeline.stages.size() > 1) {
+        stats = std::make_shared<PipeStats>();
+        for (const auto& stage : pipeline.stages) {
+            std::string text;
+            for (const auto& arg : stage.args) {
+                text += (text.empty() ? "" : " ") + arg;
+            }
+            stats->stages.push_back(std::move(text));
+        }
     }
 
-    int prevPipe[2] = {-1, -1};
+    launched.monitor = monitor;
+    int prevRead = -1;
     std::vector<pid_t> childPids;
-    pid_t pgid = 0;
+    std::vector<std::thread>& heredocWriters = launched.heredocWriters;
+    pid_t pgid = io.group != 0 ? io.group : nested ? getpgrp() : 0;
+    std::optional<int>& lastStageStatus = launched.lastStageStatus;
 
     for (std::size_t index = 0; index < pipeline.stages.size(); ++index) {
         int pipeFd[2] = {-1, -1};
         const bool createPipe = index + 1 < pipeline.stages.size();
         if (createPipe) {
-            if (pipe(pipeFd) == -1) {
+            if (pipe2(pipeFd, O_CLOEXEC) == -1) {
                 perror("pipe");
-                return 1;
+                closeFd(prevRead);
+                break;
+            }
+            if (sizing.bytes > 0) {
+                resizePipe(pipeFd[1], sizing.bytes);
+            }
+            if (stats) {
+                // The stage writes into one pipe and the next reads from another; a relay thread in
+                // the shell moves the bytes across and measures the link.
+                int relayFd[2] = {-1, -1};
+                if (pipe2(relayFd, O_CLOEXEC) == -1) {
+                    perror("pipe");
+                    closeFd(prevRead);
+                    closePipe(pipeFd);
+                    break;
+                }
+                if (sizing.bytes > 0) {
+                    resizePipe(relayFd[1], sizing.bytes);
+                }
+                stats->links.emplace_back();
+                heredocWriters.push_back(startRelay(pipeFd[0], relayFd[1], stats, stats->links.size() - 1));
+                pipeFd[0] = relayFd[0];
             }
         }
 
-        const Command& command = pipeline.stages[index];
-        int heredocPipe[2] = {-1, -1};
+        // Everything the child needs is resolved here so the launch itself is a plain spawn.
+        SpawnRequest request;
+        std::shared_ptr<const Environment> environment;
+        GlobSpan globSpan;
+        std::vector<std::vector<std::string>> batches;
+        std::vector<int> openedFds;
+        int stageStatus = 0;
+        bool inProcess = false;
+
+        Command substituted;
+        const Command* stage = &pipeline.stages[index];
+        if (!stage->processSubstitutions.empty()) {
+            substituted = *stage;
+            if (!startSubstitutions(*this, substituted, pgid, childPids, heredocWriters, request.fdActions, openedFds)) {
+                stageStatus = EXIT_FAILURE;
+            }
+            stage = &substituted;
+        }
+        const Command& command = *stage;
+        const bool lastStage = index + 1 == pipeline.stages.size();
+        const bool builtin = !command.args.empty() && builtins_.contains && builtins_.contains(command.args.front()) &&
+                             (!builtins_.accepts || builtins_.accepts(command));
+        int heredocFd = -1;
         if (command.heredocDelimiter || command.hereString || command.heredocData) {
-            if (pipe(heredocPipe) == -1) {
-                perror("pipe");
-                return 1;
+            heredocFd = openHeredoc(heredocBody(command, options_), sizing, heredocWriters);
+            if (heredocFd == -1) {
+                perror("heredoc");
+                closeFd(prevRead);
+                closePipe(pipeFd);
+                break;
             }
         }
 
-        const pid_t pid = fork();
-        if (pid < 0) {
-            perror("fork");
-            return 1;
+        request.pgid = pgid;
+        request.terminalFd = terminalFd;
+        if (!sched.empty() || !pipeline.limits.empty()) {
+            // Set between fork and exec, so the command never runs unscheduled or unlimited; this
+            // takes the fork engine. A limit that cannot be set keeps the command from running at all.
+            request.childSetup = [&sched, &pipeline]() {
+                if (const int error = applySchedAttrs(sched); error != 0) {
+                    reportChildError("sched", error);
+                }
+                if (const int error = applyResourceLimits(pipeline.limits); error != 0) {
+                    reportChildError("ulimit", error);
+                    _exit(126);
+                }
+            };
         }
 
-        if (pid == 0) {
-            if (pgid == 0) {
-                pgid = getpid();
-            }
-            setpgid(0, pgid);
-
-            if (!pipeline.background && (!options_ || options_->monitor)) {
-                tcsetpgrp(terminalFd_, pgid);
-            }
+        if (prevRead != -1) {
+            request.fdActions.push_back(FdAction{prevRead, STDIN_FILENO});
+        } else if (io.input != -1) {
+            request.fdActions.push_back(FdAction{io.input, STDIN_FILENO});
+        }
+        if (createPipe) {
+            request.fdActions.push_back(FdAction{pipeFd[1], STDOUT_FILENO});
+        } else if (io.output != -1) {
+            request.fdActions.push_back(FdAction{io.output, STDOUT_FILENO});
+        }
+        if (io.error != -1) {
+            request.fdActions.push_back(FdAction{io.error, STDERR_FILENO});
+        }
+        const bool redirected = openRedirections(command, noclobber, request.fdActions, openedFds);
+        if (!redirected) {
+            stageStatus = EXIT_FAILURE;
+        }
+        if (heredocFd != -1) {
+            request.fdActions.push_back(FdAction{heredocFd, STDIN_FILENO});
+        }
 
-            if (prevPipe[0] != -1) {
-                dup2(prevPipe[0], STDIN_FILENO);
-            }
-            if (createPipe) {
-                dup2(pipeFd[1], STDOUT_FILENO);
+        if (stageStatus == 0 && command.args.empty()) {
+            // A bare `NAME=value ...` sets shell variables, but only when the shell itself runs it.
+            if (lastStage && !pipeline.background) {
+                for (const auto& [name, value] : command.assignments) {
+                    shellVariables().set(name, value);
+                }
             }
-
-            if (prevPipe[0] != -1) {
-                closePipe(prevPipe);
+            inProcess = true;
+        } else if (stageStatus == 0 && builtin) {
+            if (lastStage && !pipeline.background) {
+                // The last stage runs in the shell itself, so `cd`, `export` and friends keep their effect.
+                ScopedFdActions scoped(request.fdActions);
+                ScopedAssignments assigned(command.assignments);
+                ScopedStdoutWriter writer;
+                stageStatus = builtins_.run(command);
+                inProcess = true;
+            } else {
+                // Earlier stages get a forked child that runs the builtin and exits, with no exec.
+                request.argv = {command.args.front()};
+                request.path = command.args.front();
+                request.childMain = [this, &command]() {
+                    for (const auto& [name, value] : command.assignments) {
+                        shellVariables().exportVariable(name, value);
+                    }
+                    int status = 0;
+                    {
+                        ScopedStdoutWriter writer;
+                        status = builtins_.run(command);
+                    }
+                    std::cout.flush();
+                    std::cerr.flush();
+                    std::fflush(nullptr);
+                    return status;
+                };
             }
-            if (createPipe) {
-                closePipe(pipeFd);
+        } else if (stageStatus == 0) {
+            request.argv = expandArguments(command, globber, globOptions, globSpan);
+            if (request.argv.empty()) {
+                stageStatus = EXIT_FAILURE;
             }
+        }
 
-            if (command.inputFile) {
-                const int fd = open(command.inputFile->c_str(), O_RDONLY);
-                if (fd == -1) {
-                    perror("open");
-                    _exit(EXIT_FAILURE);
+        if (stageStatus == 0 && !builtin && !inProcess) {
+            request.path = request.argv.front();
+            if (request.path.find('/') == std::string::npos) {
+                // Resolve through the hash before launching so a missing command costs no process.
+                if (auto resolved = commandHash_.lookup(request.path)) {
+                    request.path = std::move(*resolved);
+                } else {
+                    std::cerr << "\033[1;31mError: Command not found: " << request.path << "\033[0m\n";
+                    stageStatus = 127;
                 }
-                dup2(fd, STDIN_FILENO);
-                close(fd);
             }
+        }
 
-            std::vector<Command::FdRedirection> redirs = command.fdRedirections;
-            if (command.outputFile) {
-                redirs.push_back(Command::FdRedirection{1, Command::FdRedirection::Type::Truncate, *command.outputFile, 1});
-            } else if (command.appendFile) {
-                redirs.push_back(Command::FdRedirection{1, Command::FdRedirection::Type::Append, *command.appendFile, 1});
-            }
-            if (command.stderrFile) {
-                redirs.push_back(Command::FdRedirection{2, Command::FdRedirection::Type::Truncate, *command.stderrFile, 2});
-            } else if (command.stderrAppendFile) {
-                redirs.push_back(Command::FdRedirection{2, Command::FdRedirection::Type::Append, *command.stderrAppendFile, 2});
-            } else if (command.mergeStderr) {
-                redirs.push_back(Command::FdRedirection{2, Command::FdRedirection::Type::Dup, "", 1});
-            }
+        if (stageStatus == 0 && !inProcess) {
+            // The store's cached environment is shared by every launch until an exported variable changes.
+            environment = io.environment ? overrideEnvironment(io.environment, command.assignments)
+                                         : shellVariables().environment(command.assignments);
+            request.envp = environment->envp();
+        }
 
-            // Apply file redirections first, then descriptor dups so duplication targets updated fds.
-            for (const auto& r : redirs) {
-                if (r.type == Command::FdRedirection::Type::Dup) continue;
-                int flags = O_WRONLY | O_CREAT;
-                if (r.type == Command::FdRedirection::Type::Append) {
-                    flags |= O_APPEND;
+        // An argument list exec would refuse with E2BIG is caught here, where it can be explained or,
+        // for batchable commands, split into runs that fit.
+        if (stageStatus == 0 && !builtin && !inProcess) {
+            const std::size_t budget = argumentBudget(request.envp);
+            if (execBytes(request.argv) > budget) {
+                const ArgBatching batching = options_ ? options_->argBatch : ArgBatching{};
+                // Only the glob's own words are split; those before and after it (`mv *.tmp dest/`)
+                // go to every batch. Without a glob there is no telling operands from a trailing
+                // target, so such a command is not batched.
+                const bool globbed = globSpan.first < globSpan.end && globSpan.first > 0;
+                auto chunks = batching.allows(request.argv.front()) && globbed
+                    ? splitArguments(request.argv, globSpan.first, budget, request.argv.size() - globSpan.end)
+                    : std::nullopt;
+                if (chunks) {
+                    batches = std::move(*chunks);
+                    request.childMain = [&batches, &request, jobs = batching.jobs]() {
+                        return runBatches(request.path, batches, request.envp, jobs);
+                    };
                 } else {
-                    if (options_ && options_->noclobber) {
-                        flags |= O_EXCL;
-                    } else {
-                        flags |= O_TRUNC;
+                    std::cerr << "\033[1;31mError: " << request.argv.front() << ": argument list too long ("
+                              << request.argv.size() << " arguments, " << execBytes(request.argv) << " bytes; "
+                              << budget << " fit)";
+                    if (!batching.allows(request.argv.front())) {
+                        const std::string& name = request.argv.front();
+                        std::cerr << "; `set -o argbatch=" << name.substr(name.rfind('/') + 1) << "` runs it in batches";
                     }
+                    std::cerr << "\033[0m\n";
+                    stageStatus = 126;
                 }
-                const int fd = open(r.target.c_str(), flags, 0644);
-                if (fd == -1) {
-                    perror("open");
-                    _exit(EXIT_FAILURE);
-                }
-                dup2(fd, r.fd);
-                close(fd);
             }
-            for (const auto& r : redirs) {
-                if (r.type == Command::FdRedirection::Type::Dup) {
-                    dup2(r.dupFd, r.fd);
-                }
-            }
-
-            if (heredocPipe[0] != -1) {
-                dup2(heredocPipe[0], STDIN_FILENO);
-            }
-
-            std::vector<char*> argv = buildArgv(command, !(options_ && options_->noglob));
-            if (argv.empty() || argv.front() == nullptr) {
-                _exit(EXIT_FAILURE);
-            }
-
-            execvp(argv.front(), argv.data());
-            std::cerr << "\033[1;31mError: Command not found: " << argv.front() << "\033[0m\n";
-            for (char* arg : argv) {
-                free(arg);
-            }
-            _exit(EXIT_FAILURE);
         }
 
-        if (pgid == 0) {
-            pgid = pid;
+        if (stageStatus == 0 && !inProcess && io.replaceShell && pipeline.stages.size() == 1 &&
+            !pipeline.background && !builtin && heredocWriters.empty() && childPids.empty() && !request.childMain) {
+            // Nothing follows in the shell, so the command takes over its process rather than a fork of it.
+            std::cout.flush();
+            std::cerr.flush();
+            std::fflush(nullptr);
+            const int error = execInPlace(request);
+            std::cerr << "\033[1;31mError: " << request.path << ": " << strerror(error) << "\033[0m\n";
+            stageStatus = error == ENOENT ? 127 : 126;
         }
-        setpgid(pid, pgid);
-        childPids.push_back(pid);
 
-        if (heredocPipe[0] != -1) {
-            if (command.heredocDelimiter || command.hereString || command.heredocData) {
-                close(heredocPipe[0]);
-                std::string data;
-                if (command.hereString) {
-                    data = *command.hereString;
-                } else if (command.heredocData) {
-                    data = *command.heredocData;
+        if (stageStatus == 0 && !inProcess) {
+            const SpawnResult result = spawnProcess(request, engine);
+            if (result.pid < 0) {
+                if (result.error == ENOENT) {
+                    std::cerr << "\033[1;31mError: Command not found: " << request.path << "\033[0m\n";
+                    stageStatus = 127;
                 } else {
-                    std::string line;
-                    while (true) {
-                        std::cout << "> ";
-                        std::cout.flush();
-                        if (!std::getline(std::cin, line)) {
-                            break;
-                        }
-                        if (line == *command.heredocDelimiter) {
-                            break;
-                        }
-                        if (command.heredocStripTabs) {
-                            while (!line.empty() && line.front() == '\t') {
-                                line.erase(line.begin());
-                            }
-                        }
-                        data += line + '\n';
-                    }
+                    std::cerr << "\033[1;31mError: " << request.path << ": " << strerror(result.error) << "\033[0m\n";
+                    stageStatus = 126;
                 }
-                if (command.heredocExpand) {
-                    try {
-                        data = expandVariables(data, options_);
-                    } catch (...) {
-                        // ignore expansion errors in heredoc
-                    }
+            } else {
+                if (pgid == 0) {
+                    pgid = result.pid;
+                }
+                childPids.push_back(result.pid);
+                if (sizing.adaptive && prevRead != -1) {
+                    grower.watch(prevRead, result.pid);
                 }
-                write(heredocPipe[1], data.c_str(), data.size());
-                close(heredocPipe[1]);
             }
         }
 
-        if (prevPipe[0] != -1) {
-            closePipe(prevPipe);
+        for (const int fd : openedFds) {
+            close(fd);
         }
+        if (lastStage && catStatus) {
+            // `false | cat > OUT` succeeds: the fused cat only fails when it cannot open OUT.
+            lastStageStatus = redirected ? 0 : EXIT_FAILURE;
+        } else if (lastStage && (stageStatus != 0 || inProcess)) {
+            lastStageStatus = stageStatus;
+        }
+
+        closeFd(heredocFd);
+
+        closeFd(prevRead);
         if (createPipe) {
             close(pipeFd[1]);
-            prevPipe[0] = pipeFd[0];
-            prevPipe[1] = -1;
-        } else {
-            prevPipe[0] = prevPipe[1] = -1;
+            prevRead = pipeFd[0];
         }
     }
 
-    int status = 0;
+    if (std::thread watcher = grower.start(); watcher.joinable()) {
+        heredocWriters.push_back(std::move(watcher));
+    }
+    Job job = JobTable::makeJob(pgid, commandLine, childPids);
+    job.started = launched.job.started;
+    job.limits = pipeline.limits;
+    job.pipeStats = stats;
+    launched.job = std::move(job);
+    return launched;
+}
+
+bool CommandExecutor::poll(LaunchedPipeline& launched) {
+    return jobs_.poll(launched.job);
+}
+
+int CommandExecutor::finish(LaunchedPipeline& launched) {
+    jobs_.wait(launched.job);
+    return settle(launched);
+}
+
+int CommandExecutor::executePipeline(const Pipeline& pipeline, const std::string& commandLine, const PipelineIo& io) {
+    if (pipeline.coproc) {
+        return startCoproc(pipeline, commandLine);
+    }
     if (pipeline.background) {
-        const int jobId = nextJobId_++;
-        jobs_.push_back(Job{jobId, pgid, commandLine, Job::Status::Running, 0});
-        std::cout << '[' << jobId << "] " << pgid << "\n";
-        return 0;
-    }
-
-    if (!options_ || options_->monitor) {
-        currentFgPgid_ = pgid;
-        adoptTerminal(pgid);
-    }
-    for (const pid_t pid : childPids) {
-        int childStatus = 0;
-        waitpid(pid, &childStatus, WUNTRACED);
-        if (pid == childPids.back()) {
-            status = childStatus;
-        }
-        if (WIFSTOPPED(childStatus)) {
-            jobs_.push_back(Job{nextJobId_++, pgid, commandLine, Job::Status::Stopped, 0});
-            if (!options_ || options_->monitor) {
-                restoreTerminal();
+        const unsigned limit = options_ ? options_->maxJobs : 0;
+        // Only jobs on the shell's own stdio can wait; descriptors a caller handed over would be gone.
+        if (limit > 0 && io.input == -1 && io.output == -1 && io.error == -1) {
+            collectFinished();
+            if (!queue_.empty() || runningJobs() >= limit) {
+                // It starts later, but with the directory and exported variables of this moment.
+                PipelineIo submitted = io;
+                submitted.environment = io.environment ? io.environment : shellVariables().environment();
+                std::error_code ec;
+                queue_.push_back(QueuedJob{jobs_.reserveId(), pipeline, commandLine, submitted,
+                                           std::filesystem::current_path(ec).string()});
+                std::cout << '[' << queue_.back().id << "] queued (" << queue_.size() << ")\n";
+                return 0;
             }
-            return 128 + WSTOPSIG(childStatus);
         }
+        return startBackground(pipeline, commandLine, io, 0, true);
     }
-    if (!options_ || options_->monitor) {
+
+    LaunchedPipeline launched = launch(pipeline, commandLine, io);
+    Job& job = launched.job;
+    if (job.processes.empty()) {
+        return settle(launched);
+    }
+
+    if (launched.monitor) {
+        currentFgPgid_ = job.pgid;
+        adoptTerminal(job.pgid);
+    }
+    jobs_.wait(job);
+    if (launched.monitor) {
         restoreTerminal();
     }
     currentFgPgid_ = 0;
 
-    if (WIFEXITED(status)) {
-        return WEXITSTATUS(status);
+    if (job.status == Job::Status::Stopped) {
+        for (auto& writer : launched.heredocWriters) {
+            writer.detach();
+        }
+        const auto stopped = std::ranges::find(job.processes, Job::Status::Stopped, &Job::Process::status);
+        const int status = stopped->exitCode;
+        jobs_.add(std::move(job));
+        return status;
     }
-    if (WIFSIGNALED(status)) {
-        return 128 + WTERMSIG(status);
+    return settle(launched);
+}
+
+// Launches a background pipeline and registers its job, under `id` when it was queued with one.
+int CommandExecutor::startBackground(const Pipeline& pipeline, const std::string& commandLine, const PipelineIo& io,
+                                     int id, bool announce) {
+    LaunchedPipeline launched = launch(pipeline, commandLine, io);
+    Job& job = launched.job;
+    if (job.processes.empty()) {
+        return settle(launched);
     }
-    return status;
+    for (auto& writer : launched.heredocWriters) {
+        writer.detach();
+    }
+    job.id = id;
+    const Job& added = jobs_.add(std::move(job));
+    if (announce) {
+        std::cout << '[' << added.id << "] " << added.pgid << "\n";
+    }
+    return 0;
+}
+
+// Runs the pipeline as a background job whose stdin and stdout are pipes held by the shell.
+// The shell's ends sit at 60 and up, close-on-exec so only an explicit `>&N` / `<&N` passes them
+// on, and are published as NAME[0] (read from the coprocess) and NAME[1] (write to it).
+int CommandExecutor::startCoproc(const Pipeline& pipeline, const std::string& commandLine) {
+    int toCoproc[2] = {-1, -1};
+    int fromCoproc[2] = {-1, -1};
+    if (pipe2(toCoproc, O_CLOEXEC) == -1 || pipe2(fromCoproc, O_CLOEXEC) == -1) {
+        perror("coproc: pipe");
+        closePipe(toCoproc);
+        return 1;
+    }
+
+    Pipeline body = pipeline;
+    body.coproc.reset();
+    body.background = true;
+    PipelineIo io;
+    io.input = toCoproc[0];
+    io.output = fromCoproc[1];
+    LaunchedPipeline launched = launch(body, commandLine, io);
+    close(toCoproc[0]);
+    close(fromCoproc[1]);
+    if (launched.job.processes.empty()) {
+        close(toCoproc[1]);
+        close(fromCoproc[0]);
+        return settle(launched);
+    }
+    for (auto& writer : launched.heredocWriters) {
+        writer.detach();
+    }
+
+    const int readFd = fcntl(fromCoproc[0], F_DUPFD_CLOEXEC, 60);
+    const int writeFd = fcntl(toCoproc[1], F_DUPFD_CLOEXEC, 60);
+    close(fromCoproc[0]);
+    close(toCoproc[1]);
+
+    Job& job = jobs_.add(std::move(launched.job));
+    job.coproc = *pipeline.coproc;
+    job.heldFds = {readFd, writeFd};
+    const std::string& name = job.coproc;
+    VariableStore& variables = shellVariables();
+    // Exported, as before the variable store: scripts started from the shell read them too.
+    variables.exportVariable(name + "[0]", std::to_string(readFd));
+    variables.exportVariable(name + "[1]", std::to_string(writeFd));
+    variables.exportVariable(name + "_PID", std::to_string(job.processes.back().pid));
+    std::cout << '[' << job.id << "] " << job.processes.back().pid << "\n";
+    return 0;
+}
+
+void CommandExecutor::listCoprocs(std::ostream& os) {
+    reapBackground();
+    for (const Job* job : jobs_.ordered()) {
+        if (job->coproc.empty()) {
+            continue;
+        }
+        os << job->coproc << ' ' << job->processes.back().pid << " read=" << job->heldFds.at(0)
+           << " write=" << job->heldFds.at(1) << ' ' << (job->status == Job::Status::Done ? "Done" : "Running")
+           << ' ' << job->command << '\n';
+    }
+}
+
+// Forgets finished jobs. A finished coprocess takes its descriptors along, and its variables too
+// unless a newer coprocess of the same name has taken them over.
+void CommandExecutor::pruneJobs() {
+    for (const Job& job : jobs_.pruneDone()) {
+        if (job.coproc.empty()) {
+            continue;
+        }
+        VariableStore& variables = shellVariables();
+        const std::string pidName = job.coproc + "_PID";
+        const std::string* pid = variables.find(pidName);
+        if (pid && std::to_string(job.processes.back().pid) == *pid) {
+            variables.unset(pidName);
+            variables.unset(job.coproc + "[0]");
+            variables.unset(job.coproc + "[1]");
+        }
+    }
+}
+
+// Wraps up a pipeline whose processes have all exited: records its usage and picks the status.
+int CommandExecutor::settle(LaunchedPipeline& launched) {
+    Job& job = launched.job;
+    JobTable::release(job);
+    joinWriters(launched.heredocWriters);
+    lastUsage_ = job.usage;
+    lastUsage_.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.started).count();
+    if (!job.limitHit.empty()) {
+        std::cerr << "\033[1;31m" << job.command << ": " << job.limitHit << "\033[0m\n";
+    }
+    if (job.pipeStats) {
+        std::cerr << "pipestats: " << job.command << '\n' << formatPipeStats(*job.pipeStats, "  ");
+    }
+    if (launched.lastStageStatus) {
+        return *launched.lastStageStatus;
+    }
+    return job.processes.empty() ? EXIT_FAILURE : job.exitCode;
+}
+
+CommandHash& CommandExecutor::commandHash() {
+    return commandHash_;
+}
+
+GlobEngine& CommandExecutor::globber() {
+    return globber_;
+}
+
+const ResourceUsage& CommandExecutor::lastUsage() const {
+    return lastUsage_;
+}
+
+void CommandExecutor::setBuiltinHooks(BuiltinHooks hooks) {
+    builtins_ = std::move(hooks);
 }
 
 void CommandExecutor::adoptTerminal(pid_t pgid) {
@@ -411,23 +1309,12 @@ void CommandExecutor::restoreTerminal() {
     }
 }
 
-Job* CommandExecutor::findJob(int jobId) {
-    const auto it = std::ranges::find_if(jobs_, [&](const Job& job) { return job.id == jobId; });
-    return it == jobs_.end() ? nullptr : &(*it);
-}
-
-Job* CommandExecutor::lastJob() {
-    pruneDone();
-    if (jobs_.empty()) {
-        return nullptr;
+Job* CommandExecutor::resolveJob(int jobId) {
+    if (jobId == -1) {
+        return jobs_.current();
     }
-    return &jobs_.back();
-}
-
-void CommandExecutor::pruneDone() {
-    jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(),
-                               [](const Job& job) { return job.status == Job::Status::Done; }),
-                jobs_.end());
+    Job* job = jobs_.find(jobId);
+    return job && job->status != Job::Status::Done ? job : nullptr;
 }
 
 } // namespace ryke
@@ -0,0 +1,99 @@
+#include "fd_writer.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+namespace ryke {
+
+FdWriter::FdWriter(int fd, std::size_t capacity) : fd_(fd), buffer_(capacity > 0 ? capacity : 1) {
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+FdWriter::~FdWriter() {
+    flush();
+}
+
+bool FdWriter::flush() {
+    const std::size_t pending = static_cast<std::size_t>(pptr() - pbase());
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+    return writeAll(buffer_.data(), pending);
+}
+
+int FdWriter::error() const {
+    return error_;
+}
+
+FdWriter::int_type FdWriter::overflow(int_type ch) {
+    if (!flush()) {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize FdWriter::xsputn(const char* data, std::streamsize count) {
+    const auto size = static_cast<std::size_t>(count);
+    if (size <= static_cast<std::size_t>(epptr() - pptr())) {
+        std::memcpy(pptr(), data, size);
+        pbump(static_cast<int>(size));
+        return count;
+    }
+    // Too big for what is left: drain the buffer, then keep the tail or write a large block directly.
+    if (!flush()) {
+        return 0;
+    }
+    if (size < buffer_.size()) {
+        std::memcpy(pptr(), data, size);
+        pbump(static_cast<int>(size));
+        return count;
+    }
+    return writeAll(data, size) ? count : 0;
+}
+
+int FdWriter::sync() {
+    return flush() ? 0 : -1;
+}
+
+bool FdWriter::writeAll(const char* data, std::size_t size) {
+    while (size > 0 && error_ == 0) {
+        const ssize_t written = write(fd_, data, size);
+        if (written < 0) {
+            if (errno != EINTR) {
+                error_ = errno;
+            }
+            continue;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return error_ == 0;
+}
+
+ScopedStdoutWriter::ScopedStdoutWriter() {
+    if (isatty(STDOUT_FILENO)) {
+        return;
+    }
+    // Whatever std::cout or stdio already hold belongs before the builtin's output.
+    std::cout.flush();
+    std::fflush(stdout);
+    writer_ = std::make_unique<FdWriter>(STDOUT_FILENO);
+    previous_ = std::cout.rdbuf(writer_.get());
+}
+
+ScopedStdoutWriter::~ScopedStdoutWriter() {
+    if (!writer_) {
+        return;
+    }
+    std::cout.flush();
+    std::cout.rdbuf(previous_);
+    // A failed write (a closed pipe, a full disk) ends with the builtin, not with the shell's stdout.
+    std::cout.clear();
+}
+
+} // namespace ryke
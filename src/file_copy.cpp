@@ -0,0 +1,194 @@
+#include "file_copy.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ryke {
+
+namespace {
+
+constexpr std::size_t kKernelChunk = 1U << 30;     // per copy_file_range/sendfile call
+constexpr std::size_t kSpliceChunk = 1U << 20;     // per splice call, beyond any pipe's capacity
+constexpr std::size_t kBufferSize = 128 * 1024;    // read/write fallback
+constexpr std::size_t kBufferAlignment = 4096;
+
+enum class Step { Done, Unsupported, Failed };
+
+// Errors that mean "not between these two descriptors", as opposed to a real I/O failure. They
+// only count as such before the method has moved anything.
+bool unsupported(int error) {
+    return error == EINVAL || error == ENOSYS || error == EXDEV || error == EOPNOTSUPP || error == EBADF ||
+           error == ESPIPE;
+}
+
+template <typename Call>
+Step kernelCopy(CopyResult& result, CopyMethod method, Call call) {
+    std::uint64_t moved = 0;
+    while (true) {
+        const ssize_t n = call();
+        if (n > 0) {
+            moved += static_cast<std::uint64_t>(n);
+            result.bytes += static_cast<std::uint64_t>(n);
+            result.method = method;
+            continue;
+        }
+        if (n == 0) {
+            return Step::Done;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (moved == 0 && unsupported(errno)) {
+            return Step::Unsupported;
+        }
+        result.error = errno;
+        return Step::Failed;
+    }
+}
+
+bool writeAll(int fd, const char* data, std::size_t size, int& error) {
+    while (size > 0) {
+        const ssize_t n = write(fd, data, size);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = errno;
+            return false;
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+void readWrite(int in, int out, CopyResult& result) {
+    const std::unique_ptr<char, decltype(&std::free)> buffer(
+        static_cast<char*>(std::aligned_alloc(kBufferAlignment, kBufferSize)), &std::free);
+    if (!buffer) {
+        result.error = ENOMEM;
+        return;
+    }
+    const bool terminal = isatty(in);
+    while (true) {
+        if (terminal) {
+            pollfd ready{in, POLLIN, 0};
+            if (::poll(&ready, 1, -1) == -1) {
+                if (errno == EINTR) {
+                    result.error = EINTR;
+                    return;
+                }
+            }
+        }
+        const ssize_t n = read(in, buffer.get(), kBufferSize);
+        if (n == 0) {
+            return;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result.error = errno;
+            return;
+        }
+        if (!writeAll(out, buffer.get(), static_cast<std::size_t>(n), result.error)) {
+            return;
+        }
+        result.bytes += static_cast<std::uint64_t>(n);
+        result.method = CopyMethod::ReadWrite;
+    }
+}
+
+} // namespace
+
+CopyResult copyFd(int in, int out) {
+    CopyResult result;
+    struct stat source{};
+    struct stat target{};
+    if (fstat(in, &source) == -1 || fstat(out, &target) == -1) {
+        result.error = errno;
+        return result;
+    }
+    // procfs and sysfs files report a size of 0 and read as empty through the kernel paths.
+    const bool sizedFile = S_ISREG(source.st_mode) && source.st_size > 0;
+
+    Step step = Step::Unsupported;
+    if (sizedFile && S_ISREG(target.st_mode)) {
+        step = kernelCopy(result, CopyMethod::CopyFileRange,
+                          [&]() { return copy_file_range(in, nullptr, out, nullptr, kKernelChunk, 0); });
+    }
+    if (step == Step::Unsupported && sizedFile) {
+        step = kernelCopy(result, CopyMethod::Sendfile, [&]() { return sendfile(out, in, nullptr, kKernelChunk); });
+    }
+    if (step == Step::Unsupported && (S_ISFIFO(source.st_mode) || S_ISFIFO(target.st_mode))) {
+        step = kernelCopy(result, CopyMethod::Splice, [&]() {
+            return splice(in, nullptr, out, nullptr, kSpliceChunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+        });
+    }
+    if (step == Step::Unsupported) {
+        readWrite(in, out, result);
+    }
+    return result;
+}
+
+bool copyFile(const std::string& from, const std::string& to, bool force, bool preserve, std::string& error) {
+    const int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in == -1) {
+        error = "cannot stat '" + from + "': " + strerror(errno);
+        return false;
+    }
+    struct stat source{};
+    fstat(in, &source);
+    if (S_ISDIR(source.st_mode)) {
+        close(in);
+        error = "-r not specified; omitting directory '" + from + "'";
+        return false;
+    }
+    struct stat existing{};
+    if (stat(to.c_str(), &existing) == 0 && existing.st_dev == source.st_dev && existing.st_ino == source.st_ino) {
+        close(in);
+        error = "'" + from + "' and '" + to + "' are the same file";
+        return false;
+    }
+
+    const mode_t mode = source.st_mode & 07777;
+    int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (out == -1 && force && errno != ENOENT && unlink(to.c_str()) == 0) {
+        out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    }
+    if (out == -1) {
+        error = "cannot create regular file '" + to + "': " + strerror(errno);
+        close(in);
+        return false;
+    }
+
+    const CopyResult result = copyFd(in, out);
+    bool ok = result.error == 0;
+    if (!ok) {
+        error = "error copying '" + from + "' to '" + to + "': " + strerror(result.error);
+    }
+    if (ok && preserve) {
+        const timespec times[2] = {source.st_atim, source.st_mtim};
+        // Ownership may well be refused to an ordinary user; cp -p carries on without it.
+        (void)!fchown(out, source.st_uid, source.st_gid);
+        if (fchmod(out, mode) == -1 || futimens(out, times) == -1) {
+            error = "preserving attributes for '" + to + "': " + strerror(errno);
+            ok = false;
+        }
+    }
+    close(in);
+    if (close(out) == -1 && ok) {
+        error = "error writing '" + to + "': " + strerror(errno);
+        ok = false;
+    }
+    return ok;
+}
+
+} // namespace ryke
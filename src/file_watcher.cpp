@@ -0,0 +1,161 @@
+#include "file_watcher.h"
+#include "glob_engine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fnmatch.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace ryke {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr std::uint32_t kWatchMask =
+    IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB;
+
+std::string joinPath(const std::string& directory, const std::string& name) {
+    if (directory.empty() || directory == ".") {
+        return name;
+    }
+    return directory.back() == '/' ? directory + name : directory + "/" + name;
+}
+
+} // namespace
+
+WatchSpec parseWatchSpec(const std::string& word, bool recursive) {
+    if (!GlobEngine::hasMagic(word)) {
+        std::error_code ec;
+        if (fs::is_directory(word, ec)) {
+            return WatchSpec{word, "", recursive};
+        }
+        const auto slash = word.rfind('/');
+        if (slash == std::string::npos) {
+            return WatchSpec{".", word, false};
+        }
+        return WatchSpec{slash == 0 ? "/" : word.substr(0, slash), word.substr(slash + 1), false};
+    }
+
+    // Everything before the first segment with a wildcard is the directory to watch.
+    std::size_t segmentStart = 0;
+    while (true) {
+        const std::size_t slash = word.find('/', segmentStart);
+        const std::string segment = word.substr(segmentStart, slash == std::string::npos ? std::string::npos : slash - segmentStart);
+        if (GlobEngine::hasMagic(segment) || slash == std::string::npos) {
+            break;
+        }
+        segmentStart = slash + 1;
+    }
+    std::string directory = segmentStart == 0 ? "." : word.substr(0, segmentStart - 1);
+    if (directory.empty()) {
+        directory = "/";
+    }
+    const std::string rest = word.substr(segmentStart);
+    const auto lastSlash = rest.rfind('/');
+    if (lastSlash == std::string::npos) {
+        return WatchSpec{directory, rest, recursive};
+    }
+    // Wildcards in the middle (`a/*/b.c`, `a/**/b.c`) widen the watch to the whole tree.
+    return WatchSpec{directory, rest.substr(lastSlash + 1), true};
+}
+
+FileWatcher::FileWatcher() : fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {}
+
+FileWatcher::~FileWatcher() {
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+bool FileWatcher::add(const WatchSpec& spec, std::string& error) {
+    if (fd_ == -1) {
+        error = std::string("inotify: ") + strerror(errno);
+        return false;
+    }
+    specs_.push_back(spec);
+    const std::size_t index = specs_.size() - 1;
+    if (!watchDirectory(spec.directory, index, error)) {
+        return false;
+    }
+    if (spec.recursive) {
+        std::error_code ec;
+        for (fs::recursive_directory_iterator it(spec.directory, fs::directory_options::skip_permission_denied, ec), end;
+             !ec && it != end; it.increment(ec)) {
+            std::error_code typeError;
+            if (it->is_directory(typeError) && !it->is_symlink(typeError)) {
+                std::string ignored;
+                watchDirectory(it->path().string(), index, ignored);
+            }
+        }
+    }
+    return true;
+}
+
+int FileWatcher::fd() const {
+    return fd_;
+}
+
+bool FileWatcher::watchDirectory(const std::string& directory, std::size_t spec, std::string& error) {
+    const int wd = inotify_add_watch(fd_, directory.c_str(), kWatchMask | IN_ONLYDIR);
+    if (wd == -1) {
+        error = directory + ": " + strerror(errno);
+        return false;
+    }
+    Watched& watched = watches_[wd];
+    watched.directory = directory;
+    if (std::ranges::find(watched.specs, spec) == watched.specs.end()) {
+        watched.specs.push_back(spec);
+    }
+    return true;
+}
+
+std::vector<std::string> FileWatcher::drain() {
+    std::vector<std::string> changed;
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (true) {
+        const ssize_t n = read(fd_, buffer, sizeof(buffer));
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (ssize_t offset = 0; offset < n;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (const auto& [wd, watched] : watches_) {
+                    changed.push_back(watched.directory);
+                }
+                continue;
+            }
+            const auto it = watches_.find(event->wd);
+            if (it == watches_.end() || event->len == 0) {
+                continue;
+            }
+            const Watched watched = it->second; // watchDirectory below may rehash the map
+            const std::string name = event->name;
+            const std::string path = joinPath(watched.directory, name);
+            bool matched = false;
+            for (const std::size_t index : watched.specs) {
+                const WatchSpec& spec = specs_[index];
+                if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) && spec.recursive) {
+                    std::string ignored;
+                    watchDirectory(path, index, ignored);
+                }
+                matched = matched || spec.pattern.empty() || fnmatch(spec.pattern.c_str(), name.c_str(), FNM_PERIOD) == 0;
+            }
+            if (matched && std::ranges::find(changed, path) == changed.end()) {
+                changed.push_back(path);
+            }
+        }
+    }
+    return changed;
+}
+
+} // namespace ryke
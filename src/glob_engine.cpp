@@ -0,0 +1,260 @@
+#include "glob_engine.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <string_view>
+#include <sys/stat.h>
+#include <thread>
+
+namespace ryke {
+
+namespace {
+
+constexpr std::size_t kParallelLevel = 64;  // directories in one `**` level before the walk fans out
+constexpr std::size_t kCacheLimit = 4096;   // listings kept before the cache starts over
+constexpr unsigned kMaxWalkThreads = 8;
+
+std::vector<std::string> splitSegments(const std::string& path) {
+    std::vector<std::string> segments;
+    std::size_t start = 0;
+    while (start <= path.size()) {
+        const std::size_t slash = std::min(path.find('/', start), path.size());
+        if (slash > start) {
+            segments.push_back(path.substr(start, slash - start));
+        }
+        start = slash + 1;
+    }
+    return segments;
+}
+
+std::string join(const std::string& base, const std::string& name) {
+    if (base.empty()) {
+        return name;
+    }
+    return base.back() == '/' ? base + name : base + '/' + name;
+}
+
+std::string unescape(const std::string& segment) {
+    std::string out;
+    out.reserve(segment.size());
+    for (std::size_t i = 0; i < segment.size(); ++i) {
+        if (segment[i] == '\\' && i + 1 < segment.size()) {
+            ++i;
+        }
+        out += segment[i];
+    }
+    return out;
+}
+
+// A directory changed in the last second or two may change again without its mtime moving on a
+// filesystem with coarse timestamps, so such a listing is used once but not remembered.
+bool recentlyModified(const timespec& mtime) {
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec - mtime.tv_sec < 2;
+}
+
+} // namespace
+
+GlobEngine::GlobEngine(unsigned walkThreads)
+    : walkThreads_(walkThreads != 0 ? walkThreads : std::clamp(std::thread::hardware_concurrency(), 1U, kMaxWalkThreads)) {}
+
+bool GlobEngine::hasMagic(const std::string& word) {
+    for (std::size_t i = 0; i < word.size(); ++i) {
+        if (word[i] == '\\') {
+            ++i;
+        } else if (word[i] == '*' || word[i] == '?' || word[i] == '[') {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t GlobEngine::expand(const std::string& pattern, const GlobOptions& options, std::vector<std::string>& out) {
+    if (!hasMagic(pattern)) {
+        out.push_back(pattern);
+        return 0;
+    }
+
+    std::string path = pattern.front() == '~' ? expandTilde(pattern) : pattern;
+    const bool directoriesOnly = path.size() > 1 && path.back() == '/';
+    std::vector<std::string> segments = splitSegments(path);
+    if (!segments.empty() && segments.back() == "**") {
+        segments.emplace_back("*"); // a trailing `**` names everything below, like `**/*`
+    }
+
+    std::vector<std::string> matches{path.front() == '/' ? "/" : ""};
+    bool verified = false; // every candidate came out of a directory listing
+    for (std::size_t i = 0; i < segments.size() && !matches.empty(); ++i) {
+        const std::string& segment = segments[i];
+        const bool last = i + 1 == segments.size();
+        if (segment == "**") {
+            matches = directoryTree(matches, options);
+            verified = true;
+        } else if (!hasMagic(segment)) {
+            const std::string literal = unescape(segment);
+            for (auto& match : matches) {
+                match = join(match, literal);
+            }
+            verified = false;
+        } else {
+            std::vector<std::string> next;
+            matchSegment(matches, segment, !last || directoriesOnly, options, next);
+            matches = std::move(next);
+            verified = true;
+        }
+    }
+
+    if (!verified) {
+        std::erase_if(matches, [&](const std::string& match) {
+            struct stat st {};
+            return (directoriesOnly ? stat(match.c_str(), &st) : lstat(match.c_str(), &st)) != 0 ||
+                   (directoriesOnly && !S_ISDIR(st.st_mode));
+        });
+    }
+    if (matches.empty()) {
+        if (!options.nullglob) {
+            out.push_back(pattern);
+        }
+        return 0;
+    }
+    if (!options.nosort) {
+        std::ranges::sort(matches);
+    }
+    for (auto& match : matches) {
+        out.push_back(directoriesOnly ? std::move(match) + '/' : std::move(match));
+    }
+    return matches.size();
+}
+
+std::size_t GlobEngine::cachedDirectories() const {
+    std::lock_guard lock(mutex_);
+    return cache_.size();
+}
+
+void GlobEngine::clearCache() {
+    std::lock_guard lock(mutex_);
+    cache_.clear();
+}
+
+std::shared_ptr<const GlobEngine::Listing> GlobEngine::list(const std::string& dir) {
+    const std::string path = dir.empty() ? "." : dir;
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return nullptr;
+    }
+    const DirectoryKey key{st.st_dev, st.st_ino};
+    {
+        std::lock_guard lock(mutex_);
+        if (const auto it = cache_.find(key); it != cache_.end() && it->second->mtime.tv_sec == st.st_mtim.tv_sec &&
+                                               it->second->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            return it->second;
+        }
+    }
+
+    DIR* handle = opendir(path.c_str());
+    if (!handle) {
+        return nullptr;
+    }
+    auto listing = std::make_shared<Listing>();
+    listing->mtime = st.st_mtim;
+    while (const dirent* entry = readdir(handle)) {
+        const std::string_view name = entry->d_name;
+        if (name != "." && name != "..") {
+            listing->entries.push_back(Entry{std::string(name), entry->d_type});
+        }
+    }
+    closedir(handle);
+
+    if (!recentlyModified(st.st_mtim)) {
+        std::lock_guard lock(mutex_);
+        if (cache_.size() >= kCacheLimit) {
+            cache_.clear();
+        }
+        cache_[key] = listing;
+    }
+    return listing;
+}
+
+// Only entries that readdir could not classify, and symlinks when they are followed, are stat'ed.
+bool GlobEngine::isDirectory(const std::string& dir, const Entry& entry, bool followLinks) const {
+    if (entry.type == DT_DIR) {
+        return true;
+    }
+    if (entry.type != DT_UNKNOWN && (entry.type != DT_LNK || !followLinks)) {
+        return false;
+    }
+    struct stat st {};
+    const std::string path = join(dir, entry.name);
+    const int rc = followLinks ? stat(path.c_str(), &st) : lstat(path.c_str(), &st);
+    return rc == 0 && S_ISDIR(st.st_mode);
+}
+
+void GlobEngine::matchSegment(const std::vector<std::string>& bases, const std::string& segment, bool needDirectory,
+                              const GlobOptions& options, std::vector<std::string>& out) {
+    const int flags = options.dotglob ? 0 : FNM_PERIOD;
+    for (const auto& base : bases) {
+        const auto listing = list(base);
+        if (!listing) {
+            continue;
+        }
+        for (const auto& entry : listing->entries) {
+            if (fnmatch(segment.c_str(), entry.name.c_str(), flags) == 0 &&
+                (!needDirectory || isDirectory(base, entry, true))) {
+                out.push_back(join(base, entry.name));
+            }
+        }
+    }
+}
+
+// The roots plus every directory below them, without following symlinks. A level with many
+// directories is split across threads; the shared listing cache is the only state they touch.
+std::vector<std::string> GlobEngine::directoryTree(const std::vector<std::string>& roots, const GlobOptions& options) {
+    std::vector<std::string> all = roots;
+    std::vector<std::string> frontier = roots;
+    while (!frontier.empty()) {
+        std::vector<std::string> next;
+        if (walkThreads_ > 1 && frontier.size() >= kParallelLevel) {
+            const std::size_t workers = walkThreads_;
+            std::vector<std::vector<std::string>> found(workers);
+            std::vector<std::thread> threads;
+            threads.reserve(workers);
+            for (std::size_t t = 0; t < workers; ++t) {
+                threads.emplace_back([&, t]() {
+                    for (std::size_t i = t; i < frontier.size(); i += workers) {
+                        subdirectories(frontier[i], options, found[t]);
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            for (auto& part : found) {
+                next.insert(next.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+            }
+        } else {
+            for (const auto& dir : frontier) {
+                subdirectories(dir, options, next);
+            }
+        }
+        all.insert(all.end(), next.begin(), next.end());
+        frontier = std::move(next);
+    }
+    return all;
+}
+
+void GlobEngine::subdirectories(const std::string& dir, const GlobOptions& options, std::vector<std::string>& out) {
+    const auto listing = list(dir);
+    if (!listing) {
+        return;
+    }
+    for (const auto& entry : listing->entries) {
+        if ((options.dotglob || entry.name.front() != '.') && isDirectory(dir, entry, false)) {
+            out.push_back(join(dir, entry.name));
+        }
+    }
+}
+
+} // namespace ryke
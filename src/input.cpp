@@ -4,8 +4,10 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cerrno>
 #include <iomanip>
 #include <iostream>
+#include <poll.h>
 #include <sstream>
 #include <unistd.h>
 #include <vector>
@@ -326,11 +328,23 @@ std::size_t InputReader::visibleLength(const std::string& text) {
     return length;
 }
 
+void InputReader::setIdleHandler(std::function<void()> handler) {
+    idleHandler_ = std::move(handler);
+}
+
 int InputReader::readKey() {
     int nread;
     char c;
     char seq[3];
 
+    if (idleHandler_) {
+        // read() restarts after SA_RESTART handlers, poll() does not, which gives the handler its turn.
+        pollfd input{STDIN_FILENO, POLLIN, 0};
+        while (::poll(&input, 1, -1) == -1 && errno == EINTR) {
+            idleHandler_();
+        }
+    }
+
     while ((nread = ::read(STDIN_FILENO, &c, 1)) != -1) {
         if (c == '\x1b') {
             if (::read(STDIN_FILENO, &seq[0], 1) != 1) return '\x1b';
@@ -0,0 +1,347 @@
+#include "job_table.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ryke {
+
+namespace {
+
+int openPidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// waitid() on one process, through its pidfd when there is one. The raw system call is used
+// because, like wait4(), it reports the child's rusage, which the libc wrapper drops.
+// Returns 1 for a state change, 0 when WNOHANG found none, and -1 on error.
+int waitProcess(const Job::Process& process, int flags, siginfo_t& info, rusage& usage) {
+    const idtype_t type = process.pidfd != -1 ? P_PIDFD : P_PID;
+    const id_t id = process.pidfd != -1 ? static_cast<id_t>(process.pidfd) : static_cast<id_t>(process.pid);
+    long rc;
+    do {
+        info = {};
+        usage = {};
+        rc = syscall(SYS_waitid, type, id, &info, flags, &usage);
+    } while (rc == -1 && errno == EINTR);
+    if (rc == -1) {
+        return -1;
+    }
+    return info.si_pid != 0 ? 1 : 0;
+}
+
+double seconds(const timeval& tv) {
+    return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+}
+
+} // namespace
+
+void ResourceUsage::add(const rusage& usage) {
+    userSeconds += seconds(usage.ru_utime);
+    systemSeconds += seconds(usage.ru_stime);
+    maxRssKb = std::max(maxRssKb, usage.ru_maxrss);
+    voluntarySwitches += usage.ru_nvcsw;
+    involuntarySwitches += usage.ru_nivcsw;
+    blockInputs += usage.ru_inblock;
+    blockOutputs += usage.ru_oublock;
+}
+
+std::string formatResourceUsage(const std::string& format, const ResourceUsage& usage,
+                                const std::string& command, int exitStatus) {
+    std::string out;
+    char buffer[64];
+    auto fixed = [&](double value) {
+        std::snprintf(buffer, sizeof(buffer), "%.2f", value);
+        out += buffer;
+    };
+
+    for (std::size_t i = 0; i < format.size(); ++i) {
+        const char c = format[i];
+        if ((c != '%' && c != '\\') || i + 1 == format.size()) {
+            out += c;
+            continue;
+        }
+        const char directive = format[++i];
+        if (c == '\\') {
+            out += directive == 'n' ? '\n' : directive == 't' ? '\t' : directive;
+            continue;
+        }
+        switch (directive) {
+            case 'e': fixed(usage.wallSeconds); break;
+            case 'E': {
+                const auto total = static_cast<long>(usage.wallSeconds);
+                const double secs = usage.wallSeconds - static_cast<double>(total - total % 60);
+                if (total >= 3600) {
+                    std::snprintf(buffer, sizeof(buffer), "%ld:%02ld:%05.2f", total / 3600, total / 60 % 60, secs);
+                } else {
+                    std::snprintf(buffer, sizeof(buffer), "%ld:%05.2f", total / 60, secs);
+                }
+                out += buffer;
+                break;
+            }
+            case 'U': fixed(usage.userSeconds); break;
+            case 'S': fixed(usage.systemSeconds); break;
+            case 'P': {
+                const double cpu = usage.wallSeconds > 0 ? (usage.userSeconds + usage.systemSeconds) / usage.wallSeconds : 0;
+                out += std::to_string(static_cast<long>(cpu * 100)) + '%';
+                break;
+            }
+            case 'M': out += std::to_string(usage.maxRssKb); break;
+            case 'w': out += std::to_string(usage.voluntarySwitches); break;
+            case 'c': out += std::to_string(usage.involuntarySwitches); break;
+            case 'I': out += std::to_string(usage.blockInputs); break;
+            case 'O': out += std::to_string(usage.blockOutputs); break;
+            case 'x': out += std::to_string(exitStatus); break;
+            case 'C': out += command; break;
+            case '%': out += '%'; break;
+            default:
+                out += '%';
+                out += directive;
+                break;
+        }
+    }
+    return out;
+}
+
+JobTable::~JobTable() {
+    for (auto& [id, job] : jobs_) {
+        release(job);
+    }
+}
+
+Job JobTable::makeJob(pid_t pgid, std::string command, const std::vector<pid_t>& pids) {
+    Job job;
+    job.pgid = pgid;
+    job.command = std::move(command);
+    job.processes.reserve(pids.size());
+    for (const pid_t pid : pids) {
+        // The pid cannot be recycled before we reap it, so opening the pidfd after launch is race-free.
+        job.processes.push_back(Job::Process{pid, openPidfd(pid), Job::Status::Running, 0});
+    }
+    return job;
+}
+
+void JobTable::release(Job& job) {
+    for (auto& process : job.processes) {
+        if (process.pidfd != -1) {
+            close(process.pidfd);
+            process.pidfd = -1;
+        }
+    }
+    for (const int fd : job.heldFds) {
+        close(fd);
+    }
+    job.heldFds.clear();
+}
+
+Job& JobTable::add(Job job) {
+    if (job.id == 0) {
+        job.id = nextId_++;
+    }
+    for (const auto& process : job.processes) {
+        if (process.status != Job::Status::Done) {
+            jobByPid_[process.pid] = job.id;
+        }
+    }
+    refresh(job);
+    const int id = job.id;
+    return jobs_.emplace(id, std::move(job)).first->second;
+}
+
+int JobTable::reserveId() {
+    return nextId_++;
+}
+
+Job* JobTable::find(int id) {
+    const auto it = jobs_.find(id);
+    return it == jobs_.end() ? nullptr : &it->second;
+}
+
+Job* JobTable::findByPid(pid_t pid) {
+    const auto it = jobByPid_.find(pid);
+    return it == jobByPid_.end() ? nullptr : find(it->second);
+}
+
+Job* JobTable::current() {
+    Job* latest = nullptr;
+    for (auto& [id, job] : jobs_) {
+        if (job.status != Job::Status::Done && (!latest || id > latest->id)) {
+            latest = &job;
+        }
+    }
+    return latest;
+}
+
+std::vector<const Job*> JobTable::ordered() const {
+    std::vector<const Job*> result;
+    result.reserve(jobs_.size());
+    for (const auto& [id, job] : jobs_) {
+        result.push_back(&job);
+    }
+    std::ranges::sort(result, {}, &Job::id);
+    return result;
+}
+
+std::size_t JobTable::size() const {
+    return jobs_.size();
+}
+
+void JobTable::wait(Job& job) {
+    for (auto& process : job.processes) {
+        if (process.status == Job::Status::Stopped) {
+            process.status = Job::Status::Running; // the caller has just sent SIGCONT
+        }
+    }
+    for (auto& process : job.processes) {
+        while (process.status != Job::Status::Done) {
+            siginfo_t info{};
+            rusage usage{};
+            if (waitProcess(process, WEXITED | WSTOPPED, info, usage) != 1) {
+                process.status = Job::Status::Done; // already reaped elsewhere
+                break;
+            }
+            apply(job, process, info, usage);
+            if (process.status == Job::Status::Stopped) {
+                refresh(job);
+                return;
+            }
+        }
+    }
+    refresh(job);
+}
+
+bool JobTable::poll(Job& job) {
+    for (auto& process : job.processes) {
+        siginfo_t info{};
+        rusage usage{};
+        if (process.status == Job::Status::Done) {
+            continue;
+        }
+        const int changed = waitProcess(process, WEXITED | WNOHANG, info, usage);
+        if (changed == 1) {
+            apply(job, process, info, usage);
+        } else if (changed == -1) {
+            process.status = Job::Status::Done; // already reaped elsewhere
+        }
+    }
+    refresh(job);
+    return job.status == Job::Status::Done;
+}
+
+std::vector<int> JobTable::reap() {
+    std::vector<int> finished;
+    while (true) {
+        // Peek at whichever child changed state, then consume exactly that event through its pidfd.
+        siginfo_t info{};
+        if (waitid(P_ALL, 0, &info, WEXITED | WSTOPPED | WCONTINUED | WNOHANG | WNOWAIT) == -1 || info.si_pid == 0) {
+            break;
+        }
+
+        const pid_t pid = info.si_pid;
+        Job* job = findByPid(pid);
+        if (!job) {
+            siginfo_t discard{};
+            if (waitid(P_PID, static_cast<id_t>(pid), &discard, WEXITED | WSTOPPED | WCONTINUED | WNOHANG) == -1) {
+                break;
+            }
+            continue;
+        }
+
+        const auto process = std::ranges::find(job->processes, pid, &Job::Process::pid);
+        rusage usage{};
+        if (process == job->processes.end() ||
+            waitProcess(*process, WEXITED | WSTOPPED | WCONTINUED | WNOHANG, info, usage) != 1) {
+            break;
+        }
+        const Job::Status before = job->status;
+        apply(*job, *process, info, usage);
+        refresh(*job);
+        if (job->status == Job::Status::Done && before != Job::Status::Done) {
+            finished.push_back(job->id);
+        }
+    }
+    return finished;
+}
+
+std::vector<Job> JobTable::pruneDone() {
+    std::vector<Job> removed;
+    for (auto it = jobs_.begin(); it != jobs_.end();) {
+        if (it->second.status == Job::Status::Done) {
+            release(it->second);
+            removed.push_back(std::move(it->second));
+            it = jobs_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+void JobTable::apply(Job& job, Job::Process& process, const siginfo_t& info, const rusage& usage) {
+    switch (info.si_code) {
+        case CLD_EXITED:
+            process.status = Job::Status::Done;
+            process.exitCode = info.si_status;
+            break;
+        case CLD_KILLED:
+        case CLD_DUMPED:
+            process.status = Job::Status::Done;
+            process.exitCode = 128 + info.si_status;
+            process.termSignal = info.si_status;
+            if (job.limitHit.empty()) {
+                job.limitHit = describeLimitHit(info.si_status, job.limits);
+            }
+            break;
+        case CLD_STOPPED:
+        case CLD_TRAPPED:
+            process.status = Job::Status::Stopped;
+            process.exitCode = 128 + info.si_status;
+            break;
+        case CLD_CONTINUED:
+            process.status = Job::Status::Running;
+            break;
+        default:
+            break;
+    }
+
+    if (process.status == Job::Status::Done) {
+        job.usage.add(usage);
+        if (process.pidfd != -1) {
+            close(process.pidfd);
+            process.pidfd = -1;
+        }
+        // Drop the index entry right away: once reaped, the pid may be handed to a new child.
+        if (const auto it = jobByPid_.find(process.pid); it != jobByPid_.end() && it->second == job.id) {
+            jobByPid_.erase(it);
+        }
+    }
+}
+
+void JobTable::refresh(Job& job) {
+    bool stopped = false;
+    bool running = false;
+    for (const auto& process : job.processes) {
+        stopped |= process.status == Job::Status::Stopped;
+        running |= process.status == Job::Status::Running;
+    }
+    if (stopped) {
+        job.status = Job::Status::Stopped;
+    } else if (running) {
+        job.status = Job::Status::Running;
+    } else if (job.status != Job::Status::Done) {
+        job.status = Job::Status::Done;
+        job.exitCode = job.processes.empty() ? 0 : job.processes.back().exitCode;
+        job.usage.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.started).count();
+    }
+}
+
+} // namespace ryke
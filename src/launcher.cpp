@@ -0,0 +1,194 @@
+#include "launcher.h"
+
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace ryke {
+
+namespace {
+
+// Signals the shell handles or may have ignored; children always start with the defaults.
+constexpr int kResetSignals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD, SIGPIPE};
+
+std::vector<char*> buildArgv(const SpawnRequest& request) {
+    std::vector<char*> argv;
+    argv.reserve(request.argv.size() + 1);
+    for (const auto& arg : request.argv) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    return argv;
+}
+
+bool hasSlash(const std::string& path) {
+    return path.find('/') != std::string::npos;
+}
+
+void resetSignals() {
+    for (const int sig : kResetSignals) {
+        signal(sig, SIG_DFL);
+    }
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, nullptr);
+}
+
+void applyFdActions(const std::vector<FdAction>& actions) {
+    for (const auto& action : actions) {
+        if (action.source == action.target) {
+            fcntl(action.target, F_SETFD, 0);
+        } else {
+            dup2(action.source, action.target);
+        }
+    }
+}
+
+// Only returns when exec fails, with its errno.
+int execRequest(const SpawnRequest& request, std::vector<char*>& argv) {
+    char* const* envp = request.envp ? request.envp : environ;
+    if (hasSlash(request.path)) {
+        execve(request.path.c_str(), argv.data(), envp);
+    } else {
+        execvpe(request.path.c_str(), argv.data(), envp);
+    }
+    return errno;
+}
+
+SpawnResult spawnWithPosixSpawn(const SpawnRequest& request) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+    // Runs before the dups, while the terminal descriptor still refers to the terminal.
+    if (request.terminalFd >= 0) {
+        posix_spawn_file_actions_addtcsetpgrp_np(&actions, request.terminalFd);
+    }
+#endif
+    for (const auto& action : request.fdActions) {
+        // dup2 onto itself clears FD_CLOEXEC, which is how inherited descriptors are kept open.
+        posix_spawn_file_actions_adddup2(&actions, action.source, action.target);
+    }
+
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    for (const int sig : kResetSignals) {
+        sigaddset(&defaults, sig);
+    }
+    sigset_t emptyMask;
+    sigemptyset(&emptyMask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setsigmask(&attr, &emptyMask);
+    posix_spawnattr_setpgroup(&attr, request.pgid);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+    std::vector<char*> argv = buildArgv(request);
+    pid_t pid = -1;
+    char* const* envp = request.envp ? request.envp : environ;
+    const int rc = hasSlash(request.path)
+        ? posix_spawn(&pid, request.path.c_str(), &actions, &attr, argv.data(), envp)
+        : posix_spawnp(&pid, request.path.c_str(), &actions, &attr, argv.data(), envp);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (rc != 0) {
+        return SpawnResult{-1, rc};
+    }
+    return SpawnResult{pid, 0};
+}
+
+SpawnResult spawnWithFork(const SpawnRequest& request) {
+    // The child reports a failed exec through a close-on-exec pipe; a successful exec closes it silently.
+    int errorPipe[2] = {-1, -1};
+    if (pipe2(errorPipe, O_CLOEXEC) == -1) {
+        return SpawnResult{-1, errno};
+    }
+
+    std::vector<char*> argv = buildArgv(request);
+    const pid_t pid = fork();
+    if (pid < 0) {
+        const int err = errno;
+        close(errorPipe[0]);
+        close(errorPipe[1]);
+        return SpawnResult{-1, err};
+    }
+
+    if (pid == 0) {
+        close(errorPipe[0]);
+        setpgid(0, request.pgid);
+
+        sigset_t mask;
+        sigemptyset(&mask);
+        if (request.terminalFd >= 0) {
+            // A background group may only take the terminal with SIGTTOU blocked.
+            sigaddset(&mask, SIGTTOU);
+            sigprocmask(SIG_BLOCK, &mask, nullptr);
+            tcsetpgrp(request.terminalFd, getpgrp());
+        }
+        resetSignals();
+        applyFdActions(request.fdActions);
+
+        if (request.childSetup) {
+            request.childSetup();
+        }
+        if (request.childMain) {
+            close(errorPipe[1]);
+            _exit(request.childMain());
+        }
+
+        const int err = execRequest(request, argv);
+        (void)!write(errorPipe[1], &err, sizeof(err));
+        _exit(127);
+    }
+
+    close(errorPipe[1]);
+    setpgid(pid, request.pgid == 0 ? pid : request.pgid);
+
+    int childErr = 0;
+    ssize_t n;
+    do {
+        n = read(errorPipe[0], &childErr, sizeof(childErr));
+    } while (n == -1 && errno == EINTR);
+    close(errorPipe[0]);
+
+    if (n == static_cast<ssize_t>(sizeof(childErr))) {
+        waitpid(pid, nullptr, 0);
+        return SpawnResult{-1, childErr};
+    }
+    return SpawnResult{pid, 0};
+}
+
+} // namespace
+
+SpawnResult spawnProcess(const SpawnRequest& request, SpawnEngine engine) {
+    if (request.argv.empty() && !request.childMain) {
+        return SpawnResult{-1, EINVAL};
+    }
+    if (engine == SpawnEngine::Fork || request.childSetup || request.childMain) {
+        return spawnWithFork(request);
+    }
+    return spawnWithPosixSpawn(request);
+}
+
+int execInPlace(const SpawnRequest& request) {
+    if (request.argv.empty() || request.childMain) {
+        return EINVAL;
+    }
+    std::vector<char*> argv = buildArgv(request);
+    resetSignals();
+    applyFdActions(request.fdActions);
+    if (request.childSetup) {
+        request.childSetup();
+    }
+    return execRequest(request, argv);
+}
+
+} // namespace ryke
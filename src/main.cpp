@@ -1,13 +1,17 @@
 #include "ryke_shell.h"
 
+#include <cstring>
 #include <exception>
 #include <iostream>
 
 int main(int argc, char** argv) {
     try {
         ryke::Shell shell{};
+        if (argc > 2 && std::strcmp(argv[1], "-c") == 0) {
+            return shell.runCommandString(argv[2], true);
+        }
         if (argc > 1) {
-            return shell.runScript(argv[1]);
+            return shell.runScript(argv[1], true);
         }
         return shell.run();
     } catch (const std::exception& ex) {
@@ -1,5 +1,6 @@
 #include "ryke_shell.h"
 
+#include <algorithm>
 #include <cctype>
 #include <functional>
 #include <sstream>
@@ -30,6 +31,27 @@ std::vector<std::string> splitFields(const std::string& token, const std::string
     return fields;
 }
 
+// Index of the `)` closing the `(` at open, skipping quoted text and nested parentheses.
+std::optional<std::size_t> matchingParen(const std::string& input, std::size_t open) {
+    int depth = 0;
+    char quote = 0;
+    for (std::size_t i = open; i < input.size(); ++i) {
+        const char c = input[i];
+        if (c == '\\' && quote != '\'') {
+            ++i;
+        } else if (quote) {
+            quote = c == quote ? 0 : quote;
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+        } else if (c == '(') {
+            ++depth;
+        } else if (c == ')' && --depth == 0) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
 } // namespace
 
 std::vector<CommandParser::Token> CommandParser::tokenize(const std::string& input) const {
@@ -57,7 +79,7 @@ std::vector<CommandParser::Token> CommandParser::tokenize(const std::string& inp
             continue;
         }
 
-        if (c == '\\') {
+        if (c == '\\' && !inSingleQuotes) {
             escaping = true;
             continue;
         }
@@ -79,8 +101,8 @@ std::vector<CommandParser::Token> CommandParser::tokenize(const std::string& inp
                 continue;
             }
 
-            const auto twoChar = [&](char next, const std::string& tokenText) {
-                if (i + 1 < input.size() && input[i + 1] == next) {
+            const auto twoChar = [&](const std::string& tokenText) {
+                if (c == tokenText[0] && i + 1 < input.size() && input[i + 1] == tokenText[1]) {
                     flushCurrent();
                     tokens.emplace_back(Token{tokenText, false});
                     ++i;
@@ -89,27 +111,35 @@ std::vector<CommandParser::Token> CommandParser::tokenize(const std::string& inp
                 return false;
             };
 
-            if (twoChar('&', "&&") || twoChar('|', "||") || twoChar('>', ">>")) {
-                continue;
+            // `<(cmd)` and `>(cmd)` at the start of a word become one token holding the whole text.
+            if ((c == '<' || c == '>') && current.empty() && i + 1 < input.size() && input[i + 1] == '(') {
+                if (const auto close = matchingParen(input, i + 1)) {
+                    tokens.push_back(Token{input.substr(i, *close - i + 1), true, c});
+                    i = *close;
+                    continue;
+                }
             }
 
-            if (i + 1 < input.size() && (std::isdigit(static_cast<unsigned char>(c)) && input[i + 1] == '>')) {
-                flushCurrent();
-                std::string t;
+            // An unquoted all-digit word directly before `>` or `<` names the descriptor being
+            // redirected: `2>`, `10>>`, `3<`, `2>&` and `0<&` each become a single operator token.
+            const bool fdPrefix = (c == '>' || c == '<') && !current.empty() && !tokenQuoted &&
+                                  std::ranges::all_of(current, [](unsigned char d) { return std::isdigit(d) != 0; });
+            if (fdPrefix) {
+                std::string t = current;
+                current.clear();
                 t.push_back(c);
-                t.push_back('>');
+                if (c == '>' && i + 1 < input.size() && input[i + 1] == '>') {
+                    t.push_back('>');
+                    ++i;
+                } else if (i + 1 < input.size() && input[i + 1] == '&') {
+                    t.push_back('&');
+                    ++i;
+                }
                 tokens.emplace_back(Token{t, false});
-                ++i;
                 continue;
             }
 
-            if (i + 2 < input.size() && std::isdigit(static_cast<unsigned char>(c)) && input[i + 1] == '>' && input[i + 2] == '>') {
-                flushCurrent();
-                std::string t;
-                t.push_back(c);
-                t.append(">>");
-                tokens.emplace_back(Token{t, false});
-                i += 2;
+            if (twoChar("&&") || twoChar("||") || twoChar(">>") || twoChar(">&") || twoChar("<&")) {
                 continue;
             }
 
@@ -157,6 +187,24 @@ std::vector<CommandParser::Token> CommandParser::tokenize(const std::string& inp
     return tokens;
 }
 
+namespace {
+
+bool isNumber(const std::string& text) {
+    return !text.empty() && std::ranges::all_of(text, [](unsigned char c) { return std::isdigit(c) != 0; });
+}
+
+// `2>`, `10>>`, `3<`, `2>&`, `0<&`: a descriptor number glued to a redirection operator.
+bool isFdOperator(const std::string& token) {
+    const std::size_t digits = token.find_first_not_of("0123456789");
+    if (digits == 0 || digits == std::string::npos) {
+        return false;
+    }
+    const std::string op = token.substr(digits);
+    return op == ">" || op == ">>" || op == "<" || op == ">&" || op == "<&";
+}
+
+} // namespace
+
 std::vector<Pipeline> CommandParser::parse(const std::string& input) const {
     const auto rawTokens = expandBraces(tokenize(input));
     std::vector<Pipeline> pipelines;
@@ -164,16 +212,31 @@ std::vector<Pipeline> CommandParser::parse(const std::string& input) const {
     Pipeline pipeline;
     Command command;
     ChainCondition pendingCondition = ChainCondition::None;
+    bool coprocBraces = false;
+    const std::string* ifsValue = shellVariables().find("IFS");
+    const std::string ifs = ifsValue ? *ifsValue : std::string(" \t\n");
 
     auto flushCommand = [&]() {
-        if (!command.args.empty() || command.inputFile || command.outputFile || command.appendFile ||
+        if (!command.args.empty() || !command.assignments.empty() || command.inputFile || command.outputFile || command.appendFile ||
             command.stderrFile || command.stderrAppendFile || command.heredocDelimiter || command.hereString) {
             pipeline.stages.push_back(command);
         }
         command = Command{};
     };
 
+    // `< <(cmd)`, `> >(cmd)`: the substitution is the redirection's target rather than an argument.
+    auto substitutionTarget = [&](const Token& target) {
+        if (target.substitution) {
+            command.processSubstitutions.push_back(
+                Command::ProcessSubstitution{target.text.substr(2, target.text.size() - 3), target.substitution == '>', std::nullopt});
+        }
+    };
+
     auto flushPipeline = [&]() {
+        if (coprocBraces && !command.args.empty() && command.args.back() == "}") {
+            command.args.pop_back();
+        }
+        coprocBraces = false;
         flushCommand();
         if (!pipeline.stages.empty()) {
             pipeline.condition = pendingCondition;
@@ -187,6 +250,75 @@ std::vector<Pipeline> CommandParser::parse(const std::string& input) const {
         const std::string& token = rawTokens[i].text;
         const bool tokenQuoted = rawTokens[i].quoted;
 
+        // `coproc cmd ...` or `coproc [NAME] { pipeline }` at the start of a pipeline.
+        if (token == "coproc" && !tokenQuoted && command.args.empty() && pipeline.stages.empty() &&
+            !pipeline.coproc && i + 1 < rawTokens.size()) {
+            pipeline.coproc = "COPROC";
+            if (rawTokens[i + 1].text == "{") {
+                coprocBraces = true;
+                ++i;
+            } else if (i + 2 < rawTokens.size() && rawTokens[i + 2].text == "{" && isVariableName(rawTokens[i + 1].text)) {
+                pipeline.coproc = rawTokens[i + 1].text;
+                coprocBraces = true;
+                i += 2;
+            }
+            continue;
+        }
+
+        // `pipesize SPEC cmd | ...` sizes this pipeline's pipes regardless of the pipesize option.
+        if (token == "pipesize" && !tokenQuoted && command.args.empty() && pipeline.stages.empty() &&
+            !pipeline.pipeSize && i + 2 < rawTokens.size()) {
+            if (const auto sizing = parsePipeSizing(rawTokens[i + 1].text)) {
+                pipeline.pipeSize = *sizing;
+                ++i;
+                continue;
+            }
+        }
+
+        // Leading NAME=value words are assignments: for the shell alone, or for the command's environment.
+        if (command.args.empty() && !rawTokens[i].substitution) {
+            if (const auto eq = token.find('='); eq != std::string::npos && isVariableName(std::string_view(token).substr(0, eq))) {
+                command.assignments.emplace_back(token.substr(0, eq), token.substr(eq + 1));
+                continue;
+            }
+        }
+
+        // `sched [-c CPUS] [-n NICE] [-i IOPRIO] [-p POLICY] cmd | ...` schedules the whole job. A bad
+        // value leaves the word alone, so the sched builtin gets to report it.
+        if (token == "sched" && !tokenQuoted && command.args.empty() && pipeline.stages.empty() && !pipeline.sched) {
+            SchedAttrs attrs;
+            std::size_t next = i + 1;
+            bool valid = true;
+            while (valid && next + 1 < rawTokens.size() && rawTokens[next].text.size() == 2 && rawTokens[next].text[0] == '-') {
+                const char flag = rawTokens[next].text[1];
+                const char* name = flag == 'c' ? "cpus" : flag == 'n' ? "nice" : flag == 'i' ? "ioprio" : flag == 'p' ? "sched" : nullptr;
+                valid = name && setSchedAttr(attrs, name, rawTokens[next + 1].text);
+                next += 2;
+            }
+            if (valid && next > i + 1 && next < rawTokens.size()) {
+                pipeline.sched = attrs;
+                i = next - 1;
+                continue;
+            }
+        }
+
+        // `ulimit [-S|-H] -X N ... cmd | ...` limits this job's processes; without a command it is the builtin.
+        if (token == "ulimit" && !tokenQuoted && command.args.empty() && pipeline.stages.empty() && pipeline.limits.empty()) {
+            std::vector<std::string> words;
+            for (std::size_t j = i + 1; j < rawTokens.size(); ++j) {
+                words.push_back(rawTokens[j].text);
+            }
+            std::size_t next = 0;
+            std::string error;
+            const auto request = parseUlimit(words, next, error);
+            if (request && !request->set.empty() && request->show.empty() && !request->all && next < words.size() &&
+                std::string_view("|&<>").find(words[next].front()) == std::string_view::npos && !isFdOperator(words[next])) {
+                pipeline.limits = request->set;
+                i += next;
+                continue;
+            }
+        }
+
         if (token == "|") {
             flushCommand();
             continue;
@@ -207,6 +339,7 @@ std::vector<Pipeline> CommandParser::parse(const std::string& input) const {
         if (token == "<") {
             if (i + 1 < rawTokens.size()) {
                 command.inputFile = rawTokens[++i].text;
+                substitutionTarget(rawTokens[i]);
             }
             continue;
         }
@@ -215,6 +348,7 @@ std::vector<Pipeline> CommandParser::parse(const std::string& input) const {
             if (i + 1 < rawTokens.size()) {
                 command.outputFile = rawTokens[++i].text;
                 command.appendFile.reset();
+                substitutionTarget(rawTokens[i]);
             }
             continue;
         }
@@ -223,6 +357,7 @@ std::vector<Pipeline> CommandParser::parse(const std::string& input) const {
             if (i + 1 < rawTokens.size()) {
                 command.appendFile = rawTokens[++i].text;
                 command.outputFile.reset();
+                substitutionTarget(rawTokens[i]);
             }
             continue;
         }
@@ -277,36 +412,36 @@ std::vector<Pipeline> CommandParser::parse(const std::string& input) const {
             continue;
         }
 
-        if (!token.empty() && std::isdigit(static_cast<unsigned char>(token[0])) && token.ends_with('>')) {
-            int fd = token[0] - '0';
-            if (token == "2>" || token == "1>" || token.size() == 2) {
-                if (i + 1 < rawTokens.size()) {
-                    command.fdRedirections.push_back(Command::FdRedirection{fd, Command::FdRedirection::Type::Truncate, rawTokens[++i].text, fd});
-                }
+        if (token == ">&" || token == "<&" || isFdOperator(token)) {
+            if (i + 1 >= rawTokens.size()) {
                 continue;
             }
-        }
-
-        if (token.size() >= 3 && std::isdigit(static_cast<unsigned char>(token[0])) && token[1] == '>' && token[2] == '>') {
-            int fd = token[0] - '0';
-            if (i + 1 < rawTokens.size()) {
-                command.fdRedirections.push_back(Command::FdRedirection{fd, Command::FdRedirection::Type::Append, rawTokens[++i].text, fd});
-            }
-            continue;
-        }
-
-        if (token == "2>" || token == "1>") {
-            int fd = token[0] - '0';
-            if (i + 2 < rawTokens.size() && rawTokens[i + 1].text == "&" && !rawTokens[i + 2].text.empty() && std::isdigit(static_cast<unsigned char>(rawTokens[i + 2].text[0]))) {
-                command.fdRedirections.push_back(Command::FdRedirection{fd, Command::FdRedirection::Type::Dup, "", rawTokens[i + 2].text[0] - '0'});
-                i += 2;
-                continue;
+            const std::string& target = rawTokens[++i].text;
+            const bool input = token.find('<') != std::string::npos;
+            const std::size_t digits = token.find_first_not_of("0123456789");
+            const int fd = digits == 0 ? (input ? 0 : 1) : std::stoi(token.substr(0, digits));
+            const std::string op = token.substr(digits);
+            using Type = Command::FdRedirection::Type;
+
+            if (op == ">&" || op == "<&") {
+                if (isNumber(target)) {
+                    command.fdRedirections.push_back(Command::FdRedirection{fd, Type::Dup, "", std::stoi(target)});
+                } else if (op == ">&" && digits == 0) {
+                    // `>&file` is the old spelling of `&>file`.
+                    command.outputFile = target;
+                    command.stderrFile = target;
+                    command.appendFile.reset();
+                    command.stderrAppendFile.reset();
+                }
+            } else if (op == "<") {
+                if (fd == 0) {
+                    command.inputFile = target;
+                } else {
+                    command.fdRedirections.push_back(Command::FdRedirection{fd, Type::Read, target, fd});
+                }
+            } else {
+                command.fdRedirections.push_back(Command::FdRedirection{fd, op == ">>" ? Type::Append : Type::Truncate, target, fd});
             }
-        }
-
-        if (token == ">" && i + 2 < rawTokens.size() && rawTokens[i + 1].text == "&" && !rawTokens[i + 2].text.empty() && std::isdigit(static_cast<unsigned char>(rawTokens[i + 2].text[0]))) {
-            command.fdRedirections.push_back(Command::FdRedirection{1, Command::FdRedirection::Type::Dup, "", rawTokens[i + 2].text[0] - '0'});
-            i += 2;
             continue;
         }
 
@@ -315,14 +450,16 @@ std::vector<Pipeline> CommandParser::parse(const std::string& input) const {
             continue;
         }
 
-        if (tokenQuoted) {
+        if (rawTokens[i].substitution) {
+            command.processSubstitutions.push_back(
+                Command::ProcessSubstitution{token.substr(2, token.size() - 3), rawTokens[i].substitution == '>', command.args.size()});
+            command.args.push_back(token);
+        } else if (tokenQuoted) {
             command.args.push_back(token);
         } else {
-        const char* ifsEnv = getenv("IFS");
-        const std::string ifs = ifsEnv ? std::string(ifsEnv) : std::string(" \t\n");
-        const auto fields = splitFields(token, ifs);
-        command.args.insert(command.args.end(), fields.begin(), fields.end());
-    }
+            const auto fields = splitFields(token, ifs);
+            command.args.insert(command.args.end(), fields.begin(), fields.end());
+        }
     }
 
     flushPipeline();
@@ -336,7 +473,7 @@ std::vector<CommandParser::Token> CommandParser::expandBraces(const std::vector<
         const auto& token = tokenObj.text;
         const auto lbrace = token.find('{');
         const auto rbrace = token.find('}');
-        if (lbrace != std::string::npos && rbrace != std::string::npos && rbrace > lbrace) {
+        if (!tokenObj.quoted && lbrace != std::string::npos && rbrace != std::string::npos && rbrace > lbrace) {
             const std::string before = token.substr(0, lbrace);
             const std::string inside = token.substr(lbrace + 1, rbrace - lbrace - 1);
             const std::string after = token.substr(rbrace + 1);
@@ -356,6 +493,12 @@ std::vector<CommandParser::Token> CommandParser::expandBraces(const std::vector<
                 }
             }
 
+            // Like bash, a brace pair without a list or range (`{}`, `{x}`) stays literal; xargs-style
+            // `{}` placeholders depend on it.
+            if (inside.find(',') == std::string::npos) {
+                result.push_back(tokenObj);
+                continue;
+            }
             std::stringstream ss(inside);
             std::string part;
             while (std::getline(ss, part, ',')) {
@@ -0,0 +1,132 @@
+#include "pipe_stats.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace ryke {
+
+namespace {
+
+constexpr std::size_t kRelayChunk = 1024 * 1024;
+constexpr double kMiB = 1024.0 * 1024.0;
+
+std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Blocks until the descriptor is ready and adds the wait to `counter`. False when the other end is gone.
+// The start of the wait is published while it lasts, so a live report can count it too.
+bool waitFor(int fd, short events, std::atomic<std::int64_t>& counter, std::atomic<std::int64_t>& since) {
+    pollfd pfd{fd, events, 0};
+    const std::int64_t start = nowNs();
+    since.store(start, std::memory_order_relaxed);
+    int rc;
+    do {
+        rc = poll(&pfd, 1, -1);
+    } while (rc == -1 && errno == EINTR);
+    counter.fetch_add(nowNs() - start, std::memory_order_relaxed);
+    since.store(0, std::memory_order_relaxed);
+    return rc == 1 && (pfd.revents & POLLERR) == 0;
+}
+
+std::string formatBytes(std::uint64_t bytes) {
+    char buffer[32];
+    if (bytes >= 1024ULL * 1024 * 1024) {
+        std::snprintf(buffer, sizeof(buffer), "%.2f GB", static_cast<double>(bytes) / (kMiB * 1024.0));
+    } else if (bytes >= 1024 * 1024) {
+        std::snprintf(buffer, sizeof(buffer), "%.2f MB", static_cast<double>(bytes) / kMiB);
+    } else if (bytes >= 1024) {
+        std::snprintf(buffer, sizeof(buffer), "%.2f KB", static_cast<double>(bytes) / 1024.0);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%llu B", static_cast<unsigned long long>(bytes));
+    }
+    return buffer;
+}
+
+} // namespace
+
+std::thread startRelay(int input, int output, std::shared_ptr<PipeStats> stats, std::size_t link) {
+    LinkStats& counters = stats->links.at(link);
+    counters.startNs.store(nowNs(), std::memory_order_relaxed);
+    return std::thread([input, output, stats = std::move(stats), &counters]() {
+        // A downstream stage that exits early must surface as EPIPE here, not as SIGPIPE to the shell.
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+        fcntl(input, F_SETFL, fcntl(input, F_GETFL) | O_NONBLOCK);
+        fcntl(output, F_SETFL, fcntl(output, F_GETFL) | O_NONBLOCK);
+
+        while (true) {
+            const ssize_t moved = splice(input, nullptr, output, nullptr, kRelayChunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (moved > 0) {
+                counters.bytes.fetch_add(static_cast<std::uint64_t>(moved), std::memory_order_relaxed);
+                continue;
+            }
+            if (moved == 0) {
+                break; // upstream closed its end
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                break; // EPIPE: downstream is gone
+            }
+            // Either side can be the one that would block; whichever it is gets charged the wait.
+            pollfd readable{input, POLLIN, 0};
+            if (poll(&readable, 1, 0) == 0) {
+                if (!waitFor(input, POLLIN, counters.starvedNs, counters.starvedSinceNs)) {
+                    break;
+                }
+            } else if (!waitFor(output, POLLOUT, counters.blockedNs, counters.blockedSinceNs)) {
+                break;
+            }
+        }
+        close(input);
+        close(output);
+        counters.endNs.store(nowNs(), std::memory_order_relaxed);
+    });
+}
+
+std::string formatPipeStats(const PipeStats& stats, const std::string& indent) {
+    std::string out;
+    char line[256];
+    const std::int64_t now = nowNs();
+    for (std::size_t i = 0; i < stats.stages.size(); ++i) {
+        std::string name = stats.stages[i];
+        if (name.size() > 28) {
+            name = name.substr(0, 25) + "...";
+        }
+        if (i >= stats.links.size()) {
+            std::snprintf(line, sizeof(line), "%s%zu %-28s  (last stage)\n", indent.c_str(), i + 1, name.c_str());
+            out += line;
+            continue;
+        }
+        const LinkStats& link = stats.links[i];
+        const std::int64_t end = link.endNs.load(std::memory_order_relaxed);
+        const double lifetime = static_cast<double>(std::max<std::int64_t>((end != 0 ? end : now) -
+                                                                               link.startNs.load(std::memory_order_relaxed), 1));
+        const std::uint64_t bytes = link.bytes.load(std::memory_order_relaxed);
+        const double rate = static_cast<double>(bytes) / kMiB / (lifetime / 1e9);
+        auto waited = [now](const std::atomic<std::int64_t>& total, const std::atomic<std::int64_t>& since) {
+            const std::int64_t current = since.load(std::memory_order_relaxed);
+            return static_cast<double>(total.load(std::memory_order_relaxed) + (current != 0 ? now - current : 0));
+        };
+        const double starved = 100.0 * waited(link.starvedNs, link.starvedSinceNs) / lifetime;
+        const double blocked = 100.0 * waited(link.blockedNs, link.blockedSinceNs) / lifetime;
+        std::snprintf(line, sizeof(line), "%s%zu %-28s %10s %9.1f MB/s  starved %3.0f%%  backpressure %3.0f%%%s\n",
+                      indent.c_str(), i + 1, name.c_str(), formatBytes(bytes).c_str(), rate,
+                      std::min(starved, 100.0), std::min(blocked, 100.0), end != 0 ? "" : "  (running)");
+        out += line;
+    }
+    return out;
+}
+
+} // namespace ryke
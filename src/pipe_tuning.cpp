@@ -0,0 +1,167 @@
+#include "pipe_tuning.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace ryke {
+
+namespace {
+
+constexpr long kDefaultPipeMax = 1024 * 1024;
+constexpr int kWatchIntervalMs = 10;
+
+struct Watcher {
+    int readFd;
+    int pidfd;
+    long capacity;
+};
+
+int openPidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Polls the readers' pidfds, and between wakeups checks how full each pipe is. A pipe within a
+// page of its capacity has a writer that is, or is about to be, blocked.
+void watchPipes(std::vector<Watcher> pipes) {
+    const long maxSize = pipeMaxSize();
+    std::vector<pollfd> fds;
+    while (!pipes.empty()) {
+        fds.clear();
+        for (const auto& pipe : pipes) {
+            fds.push_back(pollfd{pipe.pidfd, POLLIN, 0});
+        }
+        if (::poll(fds.data(), fds.size(), kWatchIntervalMs) == -1 && errno != EINTR) {
+            break;
+        }
+        for (std::size_t i = pipes.size(); i-- > 0;) {
+            Watcher& pipe = pipes[i];
+            int queued = 0;
+            if (fds[i].revents != 0 || ioctl(pipe.readFd, FIONREAD, &queued) == -1) {
+                close(pipe.readFd);
+                close(pipe.pidfd);
+                pipes.erase(pipes.begin() + static_cast<std::ptrdiff_t>(i));
+                continue;
+            }
+            if (pipe.capacity < maxSize && queued + 4096 >= pipe.capacity) {
+                if (const long grown = resizePipe(pipe.readFd, pipe.capacity * 2); grown > pipe.capacity) {
+                    pipe.capacity = grown;
+                } else {
+                    pipe.capacity = maxSize; // refused, most likely by pipe-user-pages-soft; stop trying
+                }
+            }
+        }
+    }
+    for (const auto& pipe : pipes) {
+        close(pipe.readFd);
+        close(pipe.pidfd);
+    }
+}
+
+} // namespace
+
+std::optional<PipeSizing> parsePipeSizing(const std::string& spec) {
+    if (spec == "default" || spec == "0") {
+        return PipeSizing{};
+    }
+    if (spec == "auto") {
+        return PipeSizing{0, true};
+    }
+    std::size_t digits = 0;
+    while (digits < spec.size() && std::isdigit(static_cast<unsigned char>(spec[digits]))) {
+        ++digits;
+    }
+    if (digits == 0 || digits > 12 || spec.size() > digits + 1) {
+        return std::nullopt;
+    }
+    const long count = std::stol(spec.substr(0, digits));
+    long unit = 1;
+    if (digits < spec.size()) {
+        switch (std::toupper(static_cast<unsigned char>(spec[digits]))) {
+            case 'K': unit = 1024; break;
+            case 'M': unit = 1024 * 1024; break;
+            case 'G': unit = 1024L * 1024 * 1024; break;
+            default: return std::nullopt;
+        }
+    }
+    // Twelve digits fit a long, but not once scaled by a suffix.
+    if (count > LONG_MAX / unit) {
+        return std::nullopt;
+    }
+    return PipeSizing{count * unit, false};
+}
+
+std::string formatPipeSizing(const PipeSizing& sizing) {
+    if (sizing.adaptive) {
+        return "auto";
+    }
+    return sizing.bytes > 0 ? std::to_string(sizing.bytes) : "default";
+}
+
+long pipeMaxSize() {
+    static const long maxSize = [] {
+        long value = 0;
+        std::ifstream in("/proc/sys/fs/pipe-max-size");
+        return in >> value && value > 0 ? value : kDefaultPipeMax;
+    }();
+    return maxSize;
+}
+
+long resizePipe(int fd, long bytes) {
+    const long target = std::min(bytes, pipeMaxSize());
+    if (target <= 0 || target > INT_MAX) {
+        return -1;
+    }
+    // The kernel rounds up to a power-of-two number of pages and reports what it settled on.
+    return fcntl(fd, F_SETPIPE_SZ, static_cast<int>(target));
+}
+
+PipeGrower::~PipeGrower() {
+    for (const auto& pipe : pending_) {
+        close(pipe.readFd);
+    }
+}
+
+void PipeGrower::watch(int readFd, pid_t readerPid) {
+    const int copy = fcntl(readFd, F_DUPFD_CLOEXEC, 0);
+    if (copy != -1) {
+        pending_.push_back(Watched{copy, readerPid});
+    }
+}
+
+std::thread PipeGrower::start() {
+    std::vector<Watcher> pipes;
+    for (const auto& pipe : pending_) {
+        const int pidfd = openPidfd(pipe.readerPid);
+        const int capacity = fcntl(pipe.readFd, F_GETPIPE_SZ);
+        if (pidfd == -1 || capacity == -1) {
+            close(pipe.readFd);
+            if (pidfd != -1) {
+                close(pidfd);
+            }
+            continue;
+        }
+        pipes.push_back(Watcher{pipe.readFd, pidfd, capacity});
+    }
+    pending_.clear();
+    if (pipes.empty()) {
+        return {};
+    }
+    return std::thread(watchPipes, std::move(pipes));
+}
+
+} // namespace ryke
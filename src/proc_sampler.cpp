@@ -0,0 +1,229 @@
+#include "proc_sampler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string_view>
+#include <unistd.h>
+
+namespace ryke {
+
+namespace {
+
+// Reads a whole /proc file from offset 0; its contents are regenerated on every read.
+std::string_view readAt(int fd, char* buffer, std::size_t size) {
+    ssize_t n;
+    while ((n = pread(fd, buffer, size - 1, 0)) == -1 && errno == EINTR) {
+    }
+    return n > 0 ? std::string_view(buffer, static_cast<std::size_t>(n)) : std::string_view();
+}
+
+std::uint64_t parseNumber(std::string_view text) {
+    std::uint64_t value = 0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+// Field `n` (1-based, as in proc(5)) of /proc/<pid>/stat. The command name is parenthesised and may
+// hold spaces, so fields are counted from the last ')'.
+std::string_view statField(std::string_view stat, int n) {
+    const auto close = stat.rfind(')');
+    if (close == std::string_view::npos) {
+        return {};
+    }
+    std::size_t pos = close + 2;
+    for (int field = 3; field < n && pos < stat.size(); ++field) {
+        pos = stat.find(' ', pos);
+        pos = pos == std::string_view::npos ? stat.size() : pos + 1;
+    }
+    if (pos >= stat.size()) {
+        return {};
+    }
+    const auto end = stat.find(' ', pos);
+    return stat.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+}
+
+std::uint64_t ioField(std::string_view io, std::string_view name) {
+    const auto pos = io.find(name);
+    if (pos == std::string_view::npos) {
+        return 0;
+    }
+    return parseNumber(io.substr(pos + name.size()));
+}
+
+void closeFd(int& fd) {
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+std::string formatSize(std::uint64_t bytes) {
+    static constexpr const char* kUnits[] = {"B", "K", "M", "G", "T"};
+    double value = static_cast<double>(bytes);
+    std::size_t unit = 0;
+    while (value >= 1024 && unit + 1 < std::size(kUnits)) {
+        value /= 1024;
+        ++unit;
+    }
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), unit == 0 ? "%.0f%s" : "%.1f%s", value, kUnits[unit]);
+    return buffer;
+}
+
+} // namespace
+
+ProcSampler::ProcSampler(std::string procRoot)
+    : procRoot_(std::move(procRoot)), ticksPerSecond_(sysconf(_SC_CLK_TCK)), pageSize_(sysconf(_SC_PAGESIZE)) {}
+
+ProcSampler::~ProcSampler() {
+    while (!tracked_.empty()) {
+        forget(tracked_.begin()->first);
+    }
+}
+
+std::size_t ProcSampler::tracked() const {
+    return tracked_.size();
+}
+
+void ProcSampler::forget(pid_t pid) {
+    const auto it = tracked_.find(pid);
+    if (it == tracked_.end()) {
+        return;
+    }
+    closeFd(it->second.stat);
+    closeFd(it->second.statm);
+    closeFd(it->second.io);
+    tracked_.erase(it);
+}
+
+// Refreshes one process and adds it to its group. False once it has exited.
+bool ProcSampler::refresh(Tracked& process, GroupSample* group, double elapsedTicks) {
+    char buffer[1024];
+    const std::string_view stat = readAt(process.stat, buffer, sizeof(buffer));
+    // A zombie holds nothing any more; it only waits for its parent to collect it.
+    if (stat.empty() || statField(stat, 3) == "Z") {
+        return false;
+    }
+    process.pgid = static_cast<pid_t>(parseNumber(statField(stat, 5)));
+    const std::uint64_t ticks = parseNumber(statField(stat, 14)) + parseNumber(statField(stat, 15));
+    const long threads = static_cast<long>(parseNumber(statField(stat, 20)));
+    const std::uint64_t previous = process.cpuTicks;
+    process.cpuTicks = ticks;
+    if (!group || group->pgid != process.pgid) {
+        return true;
+    }
+
+    ++group->processes;
+    group->threads += threads;
+    if (elapsedTicks > 0 && ticks >= previous) {
+        group->cpuPercent += 100.0 * static_cast<double>(ticks - previous) / elapsedTicks;
+    }
+    if (const std::string_view statm = readAt(process.statm, buffer, sizeof(buffer)); !statm.empty()) {
+        const auto space = statm.find(' ');
+        group->rssBytes += parseNumber(statm.substr(space == std::string_view::npos ? 0 : space + 1)) *
+                           static_cast<std::uint64_t>(pageSize_);
+    }
+    if (process.io != -1) {
+        const std::string_view io = readAt(process.io, buffer, sizeof(buffer));
+        group->readBytes += ioField(io, "\nread_bytes: ");
+        group->writeBytes += ioField(io, "\nwrite_bytes: ");
+    }
+    return true;
+}
+
+std::vector<GroupSample> ProcSampler::sample(const std::vector<pid_t>& pgids) {
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsedTicks = lastSample_ == std::chrono::steady_clock::time_point{}
+        ? 0
+        : std::chrono::duration<double>(now - lastSample_).count() * static_cast<double>(ticksPerSecond_);
+    lastSample_ = now;
+    if (pgids != lastGroups_) {
+        // A process passed over for one set of groups may belong to the next.
+        foreign_.clear();
+        lastGroups_ = pgids;
+    }
+
+    std::vector<GroupSample> groups(pgids.size());
+    std::unordered_map<pid_t, GroupSample*> byGroup;
+    for (std::size_t i = 0; i < pgids.size(); ++i) {
+        groups[i].pgid = pgids[i];
+        byGroup[pgids[i]] = &groups[i];
+    }
+    auto groupOf = [&](pid_t pgid) -> GroupSample* {
+        const auto it = byGroup.find(pgid);
+        return it == byGroup.end() ? nullptr : it->second;
+    };
+
+    // Known processes first: one pread each tells whether they are still alive and in a group.
+    std::vector<pid_t> gone;
+    for (auto& [pid, process] : tracked_) {
+        // A process that moved to another group (setsid, setpgid) is counted there from the next sample.
+        if (!refresh(process, groupOf(process.pgid), elapsedTicks)) {
+            gone.push_back(pid);
+        } else if (!groupOf(process.pgid)) {
+            gone.push_back(pid);
+            foreign_.insert(pid);
+        }
+    }
+    for (const pid_t pid : gone) {
+        forget(pid);
+    }
+
+    // Then the directory scan, which only opens pids not seen before.
+    DIR* dir = opendir(procRoot_.c_str());
+    if (!dir) {
+        return groups;
+    }
+    std::unordered_set<pid_t> present;
+    while (const dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9') {
+            continue;
+        }
+        const auto pid = static_cast<pid_t>(parseNumber(entry->d_name));
+        present.insert(pid);
+        if (tracked_.contains(pid) || foreign_.contains(pid)) {
+            continue;
+        }
+        const std::string base = procRoot_ + "/" + entry->d_name + "/";
+        Tracked process;
+        process.stat = open((base + "stat").c_str(), O_RDONLY | O_CLOEXEC);
+        if (process.stat == -1) {
+            continue;
+        }
+        if (!refresh(process, nullptr, 0) || !groupOf(process.pgid)) {
+            closeFd(process.stat);
+            foreign_.insert(pid);
+            continue;
+        }
+        process.statm = open((base + "statm").c_str(), O_RDONLY | O_CLOEXEC);
+        process.io = open((base + "io").c_str(), O_RDONLY | O_CLOEXEC);
+        // Counted in its group now, but its CPU time so far predates the interval.
+        refresh(process, groupOf(process.pgid), 0);
+        tracked_.emplace(pid, process);
+    }
+    closedir(dir);
+    std::erase_if(foreign_, [&](pid_t pid) { return !present.contains(pid); });
+    return groups;
+}
+
+std::string formatJobTopHeader() {
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-5s %7s %5s %5s %6s %8s %8s %8s  %-8s %s", "JOB", "PGID", "PROCS", "THR",
+                  "CPU%", "RSS", "READ", "WRITE", "STATUS", "COMMAND");
+    return line;
+}
+
+std::string formatJobTopRow(int jobId, const GroupSample& sample, const std::string& status, const std::string& command) {
+    char line[128];
+    const std::string id = "[" + std::to_string(jobId) + "]";
+    std::snprintf(line, sizeof(line), "%-5s %7d %5zu %5ld %6.1f %8s %8s %8s  %-8s ", id.c_str(), sample.pgid,
+                  sample.processes, sample.threads, sample.cpuPercent, formatSize(sample.rssBytes).c_str(),
+                  formatSize(sample.readBytes).c_str(), formatSize(sample.writeBytes).c_str(), status.c_str());
+    return line + command;
+}
+
+} // namespace ryke
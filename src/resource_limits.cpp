@@ -0,0 +1,186 @@
+#include "resource_limits.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <limits>
+
+namespace ryke {
+
+namespace {
+
+constexpr LimitSpec kLimits[] = {
+    {'c', RLIMIT_CORE, "core file size", "kbytes", 1024},
+    {'d', RLIMIT_DATA, "data seg size", "kbytes", 1024},
+    {'f', RLIMIT_FSIZE, "file size", "kbytes", 1024},
+    {'l', RLIMIT_MEMLOCK, "max locked memory", "kbytes", 1024},
+    {'m', RLIMIT_RSS, "max memory size", "kbytes", 1024},
+    {'n', RLIMIT_NOFILE, "open files", "", 1},
+    {'s', RLIMIT_STACK, "stack size", "kbytes", 1024},
+    {'t', RLIMIT_CPU, "cpu time", "seconds", 1},
+    {'u', RLIMIT_NPROC, "max user processes", "", 1},
+    {'v', RLIMIT_AS, "virtual memory", "kbytes", 1024},
+    {'x', RLIMIT_LOCKS, "file locks", "", 1},
+};
+
+bool isLimitValue(const std::string& word) {
+    return word == "unlimited" || word == "hard" || word == "soft" ||
+           (!word.empty() && std::ranges::all_of(word, [](char c) { return c >= '0' && c <= '9'; }));
+}
+
+std::optional<rlim_t> resolveValue(const std::string& word, const LimitSpec& spec) {
+    if (word == "unlimited") {
+        return RLIM_INFINITY;
+    }
+    if (word == "hard" || word == "soft") {
+        rlimit current{};
+        if (getrlimit(spec.resource, &current) != 0) {
+            return std::nullopt;
+        }
+        return word == "hard" ? current.rlim_max : current.rlim_cur;
+    }
+    rlim_t value = 0;
+    for (const char c : word) {
+        const rlim_t digit = static_cast<rlim_t>(c - '0');
+        if (value > (std::numeric_limits<rlim_t>::max() - digit) / 10) {
+            return std::nullopt;
+        }
+        value = value * 10 + digit;
+    }
+    if (value > std::numeric_limits<rlim_t>::max() / spec.unit) {
+        return std::nullopt;
+    }
+    return value * spec.unit;
+}
+
+// The limit a process of the job ran under: the job's own setting, else the shell's.
+rlim_t effectiveLimit(int resource, bool hard, const std::vector<ResourceLimit>& jobLimits) {
+    for (auto it = jobLimits.rbegin(); it != jobLimits.rend(); ++it) {
+        if (it->resource == resource && (hard ? it->hard : it->soft)) {
+            return hard ? *it->hard : *it->soft;
+        }
+    }
+    rlimit current{};
+    if (getrlimit(resource, &current) != 0) {
+        return RLIM_INFINITY;
+    }
+    return hard ? current.rlim_max : current.rlim_cur;
+}
+
+bool setByJob(int resource, const std::vector<ResourceLimit>& jobLimits) {
+    return std::ranges::any_of(jobLimits, [&](const ResourceLimit& limit) { return limit.resource == resource; });
+}
+
+} // namespace
+
+std::span<const LimitSpec> limitSpecs() {
+    return kLimits;
+}
+
+const LimitSpec* findLimit(char flag) {
+    const auto it = std::ranges::find(kLimits, flag, &LimitSpec::flag);
+    return it == std::end(kLimits) ? nullptr : &*it;
+}
+
+std::optional<UlimitRequest> parseUlimit(const std::vector<std::string>& words, std::size_t& index, std::string& error) {
+    UlimitRequest request;
+    std::vector<std::pair<const LimitSpec*, std::string>> values;
+    while (index < words.size() && words[index].size() > 1 && words[index][0] == '-') {
+        const std::string& word = words[index];
+        const LimitSpec* last = nullptr;
+        for (std::size_t i = 1; i < word.size(); ++i) {
+            if (word[i] == 'S') {
+                request.soft = true;
+            } else if (word[i] == 'H') {
+                request.hard = true;
+            } else if (word[i] == 'a') {
+                request.all = true;
+            } else if (const LimitSpec* spec = findLimit(word[i])) {
+                if (last) {
+                    request.show.push_back(last);
+                }
+                last = spec;
+            } else {
+                error = std::string("-") + word[i] + ": invalid option";
+                return std::nullopt;
+            }
+        }
+        ++index;
+        // Only the last limit of a cluster can take a value: `-tv 10` shows -t and sets -v.
+        if (last && index < words.size() && isLimitValue(words[index])) {
+            values.emplace_back(last, words[index++]);
+        } else if (last) {
+            request.show.push_back(last);
+        }
+    }
+
+    for (const auto& [spec, word] : values) {
+        const auto value = resolveValue(word, *spec);
+        if (!value) {
+            error = std::string(spec->description) + ": invalid limit " + word;
+            return std::nullopt;
+        }
+        ResourceLimit limit{spec->resource, std::nullopt, std::nullopt};
+        if (request.soft || !request.hard) {
+            limit.soft = value;
+        }
+        if (request.hard || !request.soft) {
+            limit.hard = value;
+        }
+        request.set.push_back(limit);
+    }
+    return request;
+}
+
+std::string formatLimit(rlim_t value, const LimitSpec& spec) {
+    return value == RLIM_INFINITY ? "unlimited" : std::to_string(value / spec.unit);
+}
+
+int applyResourceLimits(const std::vector<ResourceLimit>& limits) {
+    int error = 0;
+    for (const auto& limit : limits) {
+        rlimit current{};
+        if (getrlimit(limit.resource, &current) != 0) {
+            error = error != 0 ? error : errno;
+            continue;
+        }
+        if (limit.soft) {
+            current.rlim_cur = *limit.soft;
+        }
+        if (limit.hard) {
+            current.rlim_max = *limit.hard;
+            // Lowering only the hard limit drags the soft one down with it rather than failing.
+            if (!limit.soft && current.rlim_cur > current.rlim_max) {
+                current.rlim_cur = current.rlim_max;
+            }
+        }
+        if (setrlimit(limit.resource, &current) != 0 && error == 0) {
+            error = errno;
+        }
+    }
+    return error;
+}
+
+std::string describeLimitHit(int signal, const std::vector<ResourceLimit>& jobLimits) {
+    switch (signal) {
+        case SIGXCPU:
+            return "CPU time limit exceeded";
+        case SIGXFSZ:
+            return "file size limit exceeded";
+        case SIGKILL:
+            // The kernel follows SIGXCPU with SIGKILL once the hard CPU limit is reached too.
+            if (effectiveLimit(RLIMIT_CPU, true, jobLimits) != RLIM_INFINITY) {
+                return "CPU time limit exceeded (killed at the hard limit)";
+            }
+            return "";
+        case SIGSEGV:
+            if (setByJob(RLIMIT_STACK, jobLimits) || effectiveLimit(RLIMIT_AS, false, jobLimits) != RLIM_INFINITY) {
+                return "segmentation fault under a stack or virtual memory limit";
+            }
+            return "";
+        default:
+            return "";
+    }
+}
+
+} // namespace ryke
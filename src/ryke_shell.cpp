@@ -1,7 +1,9 @@
 #include "ryke_shell.h"
+#include "command_cache.h"
 #include "commands.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <csignal>
 #include <cstdio>
 #include <cstdlib>
@@ -10,6 +12,7 @@
 #include <fstream>
 #include <pwd.h>
 #include <sstream>
+#include <string_view>
 #include <filesystem>
 #include <atomic>
 #include <unistd.h>
@@ -27,8 +30,8 @@ std::string trim(const std::string& text) {
 }
 
 std::string getHomeDirectory() {
-    if (const char* home = getenv("HOME")) {
-        return home;
+    if (const std::string* home = ryke::shellVariables().find("HOME")) {
+        return *home;
     }
     if (const passwd* pw = getpwuid(getuid())) {
         return pw->pw_dir;
@@ -36,6 +39,71 @@ std::string getHomeDirectory() {
     return ".";
 }
 
+// A script held in memory and walked line by line, so heredoc bodies can be sliced out whole
+// instead of being rebuilt one line at a time.
+class ScriptBuffer {
+public:
+    explicit ScriptBuffer(std::string text) : text_(std::move(text)) {}
+
+    bool nextLine(std::string_view& line) {
+        if (pos_ >= text_.size()) {
+            return false;
+        }
+        const std::size_t newline = text_.find('\n', pos_);
+        const std::size_t end = newline == std::string::npos ? text_.size() : newline;
+        line = std::string_view(text_).substr(pos_, end - pos_);
+        pos_ = newline == std::string::npos ? text_.size() : newline + 1;
+        return true;
+    }
+
+    std::string takeHeredoc(const std::string& delimiter, bool stripTabs) {
+        const std::size_t bodyStart = pos_;
+        std::size_t bodyEnd = text_.size();
+        std::string stripped;
+        std::string_view line;
+        for (std::size_t lineStart = pos_; nextLine(line); lineStart = pos_) {
+            std::string_view candidate = line;
+            if (stripTabs) {
+                candidate.remove_prefix(std::min(candidate.find_first_not_of('\t'), candidate.size()));
+            }
+            if (candidate == delimiter) {
+                bodyEnd = lineStart;
+                break;
+            }
+            if (stripTabs) {
+                stripped.append(candidate).push_back('\n');
+            }
+        }
+        if (stripTabs) {
+            return stripped;
+        }
+
+        std::string body = text_.substr(bodyStart, bodyEnd - bodyStart);
+        if (!body.empty() && body.back() != '\n') {
+            body.push_back('\n');
+        }
+        return body;
+    }
+
+    // True when nothing but blank and comment lines remains.
+    [[nodiscard]] bool onlyCommentsLeft() const {
+        std::size_t pos = pos_;
+        while (pos < text_.size()) {
+            const std::size_t newline = std::min(text_.find('\n', pos), text_.size());
+            const std::size_t first = text_.find_first_not_of(" \t\r", pos);
+            if (first < newline && text_[first] != '#') {
+                return false;
+            }
+            pos = newline + 1;
+        }
+        return true;
+    }
+
+private:
+    std::string text_;
+    std::size_t pos_{0};
+};
+
 bool isWorldWritable(const std::string& path) {
     struct stat st {};
     if (stat(path.c_str(), &st) != 0) {
@@ -67,10 +135,17 @@ Shell::Shell(ShellConfig config)
       running_(true),
       historyFile_(config_.historyFile.empty() ? defaultPath(".rykeshell_history") : config_.historyFile),
       aliasFile_(config_.aliasFile.empty() ? defaultPath(".rykeshell_aliases") : config_.aliasFile),
-      configFile_(config_.configFile.empty() ? defaultPath(".rykeshell_config") : config_.configFile) {
+      configFile_(config_.configFile.empty() ? defaultPath(".rykeshell_config") : config_.configFile),
+      cacheDir_(config_.cacheDir.empty() ? defaultPath(".rykeshell_cache") : config_.cacheDir) {
     gShellInstance = this;
+    setCommandSubstitution([this](const std::string& text) { return substituteCommand(text); });
     setupSignalHandlers();
     registerBuiltinHandlers();
+    inputReader_->setIdleHandler([this]() {
+        if (gReapNeeded.exchange(false, std::memory_order_relaxed)) {
+            executor_->dispatchQueued();
+        }
+    });
     loadState();
     const std::string rcPath = defaultPath(".rykeshellrc");
     if (std::filesystem::exists(rcPath)) {
@@ -82,6 +157,7 @@ Shell::~Shell() {
     if (running_) {
         saveState();
     }
+    setCommandSubstitution(nullptr);
     gShellInstance = nullptr;
 }
 
@@ -118,12 +194,6 @@ int Shell::run() {
             continue;
         }
 
-        const Pipeline& firstPipeline = pipelines.front();
-        const bool isSingleBuiltin = pipelines.size() == 1 && firstPipeline.stages.size() == 1;
-        if (isSingleBuiltin && registry_->tryHandle(firstPipeline.stages.front(), *this)) {
-            continue;
-        }
-
         const int status = executor_->execute(pipelines, rawInput);
         if (options_.errexit && status != 0) {
             requestExit(status);
@@ -134,16 +204,29 @@ int Shell::run() {
     return exitStatus_;
 }
 
-int Shell::runScript(const std::string& path) {
-    std::ifstream in(path);
+int Shell::runScript(const std::string& path, bool topLevel) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
     if (!in) {
         std::cerr << "Failed to open script: " << path << '\n';
         return 1;
     }
+    std::string text(static_cast<std::size_t>(std::max<std::streamoff>(in.tellg(), 0)), '\0');
+    in.seekg(0);
+    in.read(text.data(), static_cast<std::streamsize>(text.size()));
+    return runLines(std::move(text), topLevel);
+}
+
+int Shell::runCommandString(const std::string& text, bool topLevel) {
+    return runLines(text, topLevel);
+}
+
+int Shell::runLines(std::string text, bool topLevel) {
+    ScriptBuffer script(std::move(text));
 
-    std::string line;
-    while (running_ && std::getline(in, line)) {
-        line = trim(line);
+    std::string_view rawLine;
+    int lastStatus = 0;
+    while (running_ && script.nextLine(rawLine)) {
+        const std::string line = trim(std::string(rawLine));
         if (line.empty() || line[0] == '#') {
             continue;
         }
@@ -163,38 +246,48 @@ int Shell::runScript(const std::string& path) {
         for (auto& pipeline : pipelines) {
             for (auto& cmd : pipeline.stages) {
                 if (cmd.heredocDelimiter && !cmd.heredocData) {
-                    std::string heredoc;
-                    std::string docLine;
-                    while (std::getline(in, docLine)) {
-                        if (cmd.heredocStripTabs) {
-                            while (!docLine.empty() && docLine.front() == '\t') {
-                                docLine.erase(docLine.begin());
-                            }
-                        }
-                        if (docLine == *cmd.heredocDelimiter) {
-                            break;
-                        }
-                        heredoc += docLine + '\n';
-                    }
-                    cmd.heredocData = heredoc;
+                    cmd.heredocData = script.takeHeredoc(*cmd.heredocDelimiter, cmd.heredocStripTabs);
                 }
             }
         }
 
-        const Pipeline& firstPipeline = pipelines.front();
-        const bool isSingleBuiltin = pipelines.size() == 1 && firstPipeline.stages.size() == 1;
-        if (isSingleBuiltin && registry_->tryHandle(firstPipeline.stages.front(), *this)) {
-            continue;
+        PipelineIo io;
+        if (topLevel && script.onlyCommentsLeft() && mayReplaceShell(pipelines)) {
+            // State is saved now because a successful exec leaves no shell to save it afterwards.
+            saveState();
+            io.replaceShell = true;
         }
-
-        const int status = executor_->execute(pipelines, line);
+        const int status = executor_->execute(pipelines, line, io);
+        lastStatus = status;
         if (options_.errexit && status != 0) {
             requestExit(status);
         }
     }
 
+    if (topLevel) {
+        // Jobs still waiting for a `maxjobs` slot would never start once the shell is gone.
+        executor_->drainQueue();
+    }
     saveState();
-    return exitStatus_;
+    // Like the exec'd command would, a script that runs to its end reports its last status.
+    return running_ ? lastStatus : exitStatus_;
+}
+
+// The shell may give its process to the last line's command when that line is one plain
+// foreground external command and no job of the shell's would be orphaned by the exec.
+bool Shell::mayReplaceShell(const std::vector<Pipeline>& pipelines) {
+    if (!options_.tailExec || pipelines.size() != 1) {
+        return false;
+    }
+    const Pipeline& pipeline = pipelines.front();
+    if (pipeline.background || pipeline.coproc || pipeline.stages.size() != 1) {
+        return false;
+    }
+    const Command& command = pipeline.stages.front();
+    if (command.args.empty() || registry_->handles(command)) {
+        return false;
+    }
+    return !executor_->hasJobs();
 }
 
 History& Shell::history() {
@@ -229,6 +322,10 @@ const ShellConfig& Shell::config() const {
     return config_;
 }
 
+const std::string& Shell::cacheDirectory() const {
+    return cacheDir_;
+}
+
 ShellOptions& Shell::options() {
     return options_;
 }
@@ -256,8 +353,8 @@ std::string Shell::buildPrompt() const {
     }
 
     std::string user;
-    if (const char* userEnv = getenv("USER")) {
-        user = userEnv;
+    if (const std::string* userVar = shellVariables().find("USER")) {
+        user = *userVar;
     } else if (const passwd* pw = getpwuid(getuid()); pw) {
         user = pw->pw_name;
     } else {
@@ -304,6 +401,22 @@ std::string Shell::expandInput(const std::string& input) const {
     return expandedVars;
 }
 
+std::string Shell::substituteCommand(const std::string& commandText) {
+    std::string output;
+    std::string expanded;
+    try {
+        expanded = expandInput(commandText);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << '\n';
+        return output;
+    }
+    const std::vector<Pipeline> pipelines = parser_->parse(expanded);
+    if (!pipelines.empty()) {
+        executor_->capture(pipelines, commandText, output);
+    }
+    return output;
+}
+
 std::string Shell::resolveAlias(const std::string& token) const {
     if (const auto alias = aliases_.resolve(token)) {
         return *alias;
@@ -346,6 +459,12 @@ void Shell::sigtstpHandler(int /*sig*/) {
 
 void Shell::registerBuiltinHandlers() {
     registerBuiltinCommands(*registry_);
+    executor_->setBuiltinHooks(CommandExecutor::BuiltinHooks{
+        [this](const std::string& name) { return registry_->contains(name); },
+        [this](const Command& command) { return registry_->tryHandle(command, *this).value_or(127); },
+        [this](const Command& command) { return registry_->handles(command); },
+        [this](const Command& command) { return registry_->readOnly(command); },
+    });
 }
 
 std::string Shell::defaultPath(const std::string& filename) const {
@@ -391,6 +510,23 @@ void Shell::saveState() {
     configOut << "option=history-ignore-dups:" << (options_.historyIgnoreDups ? 1 : 0) << '\n';
     configOut << "option=history-ignore-space:" << (options_.historyIgnoreSpace ? 1 : 0) << '\n';
     configOut << "option=noglob:" << (options_.noglob ? 1 : 0) << '\n';
+    configOut << "option=nullglob:" << (options_.nullglob ? 1 : 0) << '\n';
+    configOut << "option=dotglob:" << (options_.dotglob ? 1 : 0) << '\n';
+    configOut << "option=nosort:" << (options_.nosort ? 1 : 0) << '\n';
+    configOut << "option=posix-spawn:" << (options_.posixSpawn ? 1 : 0) << '\n';
+    configOut << "option=pipe-fusion:" << (options_.pipeFusion ? 1 : 0) << '\n';
+    configOut << "option=pipestats:" << (options_.pipeStats ? 1 : 0) << '\n';
+    configOut << "option=tail-exec:" << (options_.tailExec ? 1 : 0) << '\n';
+    configOut << "option=cache-size=" << options_.cacheSize << ":1\n";
+    configOut << "option=maxjobs" << (options_.maxJobs == 0 ? ":0" : "=" + std::to_string(options_.maxJobs) + ":1") << '\n';
+    configOut << "option=pipesize=" << formatPipeSizing(options_.pipeSize) << ":1\n";
+    const std::string argBatch = formatArgBatching(options_.argBatch);
+    configOut << "option=argbatch" << (argBatch == "off" ? ":0" : "=" + argBatch + ":1") << '\n';
+    configOut << "option=argbatch-jobs=" << options_.argBatch.jobs << ":1\n";
+    for (const char* name : kSchedAttrNames) {
+        const std::string value = formatSchedAttr(options_.sched, name);
+        configOut << "option=" << name << (value.empty() ? ":0" : "=" + value + ":1") << '\n';
+    }
 }
 
 void Shell::loadState() {
@@ -433,7 +569,8 @@ void Shell::loadState() {
             } else if (key == "prompt_template") {
                 promptTemplate_ = value;
             } else if (key == "option") {
-                const auto colon = value.find(':');
+                // Split on the last colon: values such as ioprio=be:3 carry colons of their own.
+                const auto colon = value.rfind(':');
                 if (colon != std::string::npos) {
                     const std::string optName = value.substr(0, colon);
                     const bool enabled = value.substr(colon + 1) == "1";
@@ -454,6 +591,92 @@ void Shell::applyOption(const std::string& name, bool enabled) {
     else if (name == "history-ignore-dups") options_.historyIgnoreDups = enabled;
     else if (name == "history-ignore-space") options_.historyIgnoreSpace = enabled;
     else if (name == "noglob") options_.noglob = enabled;
+    else if (name == "nullglob") options_.nullglob = enabled;
+    else if (name == "dotglob") options_.dotglob = enabled;
+    else if (name == "nosort") options_.nosort = enabled;
+    else if (name == "posix-spawn") options_.posixSpawn = enabled;
+    else if (name == "pipe-fusion") options_.pipeFusion = enabled;
+    else if (name == "pipestats") options_.pipeStats = enabled;
+    else if (name == "tail-exec") options_.tailExec = enabled;
+    else if (name.rfind("cache-size", 0) == 0) {
+        // `set -o cache-size=256M` caps the `cache` store; `set +o cache-size` restores 64M.
+        const auto eq = name.find('=');
+        if (!enabled || eq == std::string::npos) {
+            options_.cacheSize = ShellOptions{}.cacheSize;
+        } else if (const auto bytes = parseByteSize(name.substr(eq + 1))) {
+            options_.cacheSize = *bytes;
+        } else {
+            std::cerr << "set: cache-size: expected a byte count (K/M/G suffix)\n";
+        }
+    } else if (name.rfind("maxjobs", 0) == 0) {
+        // `set -o maxjobs=N` queues background jobs past N; `set +o maxjobs` lifts the limit.
+        const auto eq = name.find('=');
+        unsigned maxJobs = 0;
+        if (enabled && eq != std::string::npos) {
+            try {
+                maxJobs = static_cast<unsigned>(std::stoul(name.substr(eq + 1)));
+            } catch (...) {
+                maxJobs = 0;
+            }
+        }
+        if (enabled && maxJobs == 0) {
+            std::cerr << "set: maxjobs: expected maxjobs=N with a positive N\n";
+        } else {
+            options_.maxJobs = maxJobs;
+            executor_->dispatchQueued();
+        }
+    }
+    else if (name.rfind("pipesize", 0) == 0) {
+        // `set -o pipesize=SPEC`; `set +o pipesize` goes back to the kernel default.
+        const auto eq = name.find('=');
+        if (!enabled || eq == std::string::npos) {
+            options_.pipeSize = {};
+        } else if (const auto sizing = parsePipeSizing(name.substr(eq + 1))) {
+            options_.pipeSize = *sizing;
+        } else {
+            std::cerr << "set: pipesize: expected a byte count (K/M/G suffix), auto or default\n";
+        }
+    } else if (name.rfind("argbatch-jobs", 0) == 0) {
+        // `set -o argbatch-jobs=N` runs up to N batches at once; `set +o argbatch-jobs` runs them in order.
+        const auto eq = name.find('=');
+        unsigned jobs = 1;
+        if (enabled && eq != std::string::npos) {
+            try {
+                jobs = static_cast<unsigned>(std::stoul(name.substr(eq + 1)));
+            } catch (...) {
+                jobs = 0;
+            }
+        }
+        if (jobs == 0) {
+            std::cerr << "set: argbatch-jobs: expected a positive count\n";
+        } else {
+            options_.argBatch.jobs = jobs;
+        }
+    } else if (name.rfind("argbatch", 0) == 0) {
+        // `set -o argbatch` batches any command, `set -o argbatch=rm,chmod` only those; `set +o argbatch` none.
+        const auto eq = name.find('=');
+        if (!enabled) {
+            options_.argBatch.all = false;
+            options_.argBatch.commands.clear();
+        } else if (!parseArgBatching(eq == std::string::npos ? "all" : name.substr(eq + 1), options_.argBatch)) {
+            std::cerr << "set: argbatch: expected all or a comma-separated list of commands\n";
+        }
+    } else {
+        // `set -o nice=10`, `set -o cpus=0-3`, ...; `set +o nice` stops setting it.
+        const auto eq = name.find('=');
+        const std::string attr = name.substr(0, eq);
+        if (std::ranges::find(kSchedAttrNames, attr) == std::end(kSchedAttrNames)) {
+            return;
+        }
+        if (!enabled || eq == std::string::npos) {
+            if (attr == "cpus") options_.sched.cpus.clear();
+            else if (attr == "nice") options_.sched.nice.reset();
+            else if (attr == "ioprio") options_.sched.ioprio.reset();
+            else options_.sched.policy.reset();
+        } else if (!setSchedAttr(options_.sched, attr, name.substr(eq + 1))) {
+            std::cerr << "set: " << attr << ": invalid value " << name.substr(eq + 1) << '\n';
+        }
+    }
 }
 void Shell::notifyBackground(const std::string& message) const {
     std::cout << message << '\n';
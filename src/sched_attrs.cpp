@@ -0,0 +1,224 @@
+#include "sched_attrs.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ryke {
+
+namespace {
+
+// From linux/ioprio.h, which not every libc ships.
+constexpr int kIoprioClassShift = 13;
+constexpr int kIoprioClassRt = 1;
+constexpr int kIoprioClassBe = 2;
+constexpr int kIoprioClassIdle = 3;
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioWhoPgrp = 2;
+
+std::optional<int> parseInt(const std::string& text) {
+    int value = 0;
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || end != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+std::optional<std::vector<int>> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::size_t start = 0;
+    while (start <= text.size()) {
+        const std::size_t comma = std::min(text.find(',', start), text.size());
+        const std::string item = text.substr(start, comma - start);
+        const std::size_t dash = item.find('-');
+        const auto first = parseInt(item.substr(0, dash));
+        const auto last = dash == std::string::npos ? first : parseInt(item.substr(dash + 1));
+        if (!first || !last || *first < 0 || *last < *first || *last >= CPU_SETSIZE) {
+            return std::nullopt;
+        }
+        for (int cpu = *first; cpu <= *last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        start = comma + 1;
+    }
+    std::ranges::sort(cpus);
+    cpus.erase(std::ranges::unique(cpus).begin(), cpus.end());
+    return cpus;
+}
+
+std::string formatCpuList(const std::vector<int>& cpus) {
+    std::string out;
+    for (std::size_t i = 0; i < cpus.size();) {
+        std::size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            ++j;
+        }
+        out += (out.empty() ? "" : ",") + std::to_string(cpus[i]);
+        if (j > i) {
+            out += '-' + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return out;
+}
+
+std::optional<int> parseIoPriority(const std::string& text) {
+    const std::size_t colon = text.find(':');
+    const std::string name = text.substr(0, colon);
+    int level = 4;
+    if (colon != std::string::npos) {
+        const auto parsed = parseInt(text.substr(colon + 1));
+        if (!parsed || *parsed < 0 || *parsed > 7) {
+            return std::nullopt;
+        }
+        level = *parsed;
+    }
+    if (name == "none" && colon == std::string::npos) {
+        return 0;
+    }
+    if (name == "idle" && colon == std::string::npos) {
+        return kIoprioClassIdle << kIoprioClassShift;
+    }
+    if (name == "be" || name == "rt") {
+        return (name == "rt" ? kIoprioClassRt : kIoprioClassBe) << kIoprioClassShift | level;
+    }
+    return std::nullopt;
+}
+
+std::string formatIoPriority(int ioprio) {
+    const int level = ioprio & ((1 << kIoprioClassShift) - 1);
+    switch (ioprio >> kIoprioClassShift) {
+        case kIoprioClassRt: return "rt:" + std::to_string(level);
+        case kIoprioClassBe: return "be:" + std::to_string(level);
+        case kIoprioClassIdle: return "idle";
+        default: return "none";
+    }
+}
+
+int setIoPriority(int who, pid_t id, int ioprio) {
+#ifdef SYS_ioprio_set
+    return syscall(SYS_ioprio_set, who, id, ioprio) == -1 ? errno : 0;
+#else
+    (void)who;
+    (void)id;
+    (void)ioprio;
+    return ENOSYS;
+#endif
+}
+
+int setAffinity(pid_t pid, const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(pid, sizeof(set), &set) == -1 ? errno : 0;
+}
+
+int setPolicy(pid_t pid, int policy) {
+    const sched_param param{};
+    return sched_setscheduler(pid, policy, &param) == -1 ? errno : 0;
+}
+
+} // namespace
+
+bool SchedAttrs::empty() const {
+    return cpus.empty() && !nice && !ioprio && !policy;
+}
+
+void SchedAttrs::merge(const SchedAttrs& over) {
+    if (!over.cpus.empty()) cpus = over.cpus;
+    if (over.nice) nice = over.nice;
+    if (over.ioprio) ioprio = over.ioprio;
+    if (over.policy) policy = over.policy;
+}
+
+bool setSchedAttr(SchedAttrs& attrs, const std::string& name, const std::string& value) {
+    if (name == "cpus") {
+        const auto cpus = parseCpuList(value);
+        if (!cpus) return false;
+        attrs.cpus = *cpus;
+    } else if (name == "nice") {
+        const auto nice = parseInt(!value.empty() && value.front() == '+' ? value.substr(1) : value);
+        if (!nice || *nice < -20 || *nice > 19) return false;
+        attrs.nice = *nice;
+    } else if (name == "ioprio") {
+        const auto ioprio = parseIoPriority(value);
+        if (!ioprio) return false;
+        attrs.ioprio = *ioprio;
+    } else if (name == "sched") {
+        if (value == "other") attrs.policy = SCHED_OTHER;
+        else if (value == "batch") attrs.policy = SCHED_BATCH;
+        else if (value == "idle") attrs.policy = SCHED_IDLE;
+        else return false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string formatSchedAttr(const SchedAttrs& attrs, const std::string& name) {
+    if (name == "cpus") {
+        return formatCpuList(attrs.cpus);
+    }
+    if (name == "nice") {
+        return attrs.nice ? std::to_string(*attrs.nice) : "";
+    }
+    if (name == "ioprio") {
+        return attrs.ioprio ? formatIoPriority(*attrs.ioprio) : "";
+    }
+    if (name == "sched" && attrs.policy) {
+        return *attrs.policy == SCHED_BATCH ? "batch" : *attrs.policy == SCHED_IDLE ? "idle" : "other";
+    }
+    return "";
+}
+
+// The policy goes first: switching to SCHED_IDLE or back does not touch the nice value set after it.
+int applySchedAttrs(const SchedAttrs& attrs, pid_t pid) {
+    int error = 0;
+    auto note = [&error](int rc) {
+        if (error == 0) error = rc;
+    };
+    if (attrs.policy) {
+        note(setPolicy(pid, *attrs.policy));
+    }
+    if (attrs.nice) {
+        note(setpriority(PRIO_PROCESS, static_cast<id_t>(pid), *attrs.nice) == -1 ? errno : 0);
+    }
+    if (attrs.ioprio) {
+        note(setIoPriority(kIoprioWhoProcess, pid, *attrs.ioprio));
+    }
+    if (!attrs.cpus.empty()) {
+        note(setAffinity(pid, attrs.cpus));
+    }
+    return error;
+}
+
+int applySchedAttrsToJob(const SchedAttrs& attrs, pid_t pgid, const std::vector<pid_t>& pids) {
+    int error = 0;
+    auto note = [&error](int rc) {
+        if (error == 0) error = rc;
+    };
+    for (const pid_t pid : pids) {
+        if (attrs.policy) {
+            note(setPolicy(pid, *attrs.policy));
+        }
+        if (!attrs.cpus.empty()) {
+            note(setAffinity(pid, attrs.cpus));
+        }
+    }
+    if (attrs.nice) {
+        note(setpriority(PRIO_PGRP, static_cast<id_t>(pgid), *attrs.nice) == -1 ? errno : 0);
+    }
+    if (attrs.ioprio) {
+        note(setIoPriority(kIoprioWhoPgrp, pgid, *attrs.ioprio));
+    }
+    return error;
+}
+
+} // namespace ryke
@@ -1,20 +1,89 @@
 #include "ryke_shell.h"
 #include "utils.h"
 
+#include <cerrno>
 #include <csignal>
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <fcntl.h>
 #include <iostream>
 #include <sstream>
 #include <pwd.h>
 #include <stdexcept>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <cctype>
 
 namespace ryke {
 
+namespace {
+
+CommandSubstitution& commandSubstitution() {
+    static CommandSubstitution handler;
+    return handler;
+}
+
+std::string trimSpace(const std::string& text) {
+    const auto first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return "";
+    }
+    const auto last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+std::string readWholeFile(const std::string& path) {
+    std::string contents;
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        std::cerr << path << ": " << strerror(errno) << '\n';
+        return contents;
+    }
+    struct stat st {};
+    std::size_t chunk = 64 * 1024;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        chunk = static_cast<std::size_t>(st.st_size) + 1;
+    }
+    std::size_t used = 0;
+    while (true) {
+        contents.resize(used + chunk);
+        const ssize_t n = read(fd, contents.data() + used, chunk);
+        if (n > 0) {
+            used += static_cast<std::size_t>(n);
+        } else if (n == 0 || errno != EINTR) {
+            break;
+        }
+    }
+    contents.resize(used);
+    close(fd);
+    return contents;
+}
+
+std::string runCommandSubstitution(const std::string& cmd, const ShellOptions* options) {
+    const std::string text = trimSpace(cmd);
+    if (text.starts_with('<')) {
+        // $(<file) is a plain read; nothing needs to run.
+        return readWholeFile(expandTilde(trimSpace(expandVariables(text.substr(1), options))));
+    }
+    if (const auto& handler = commandSubstitution()) {
+        return handler(text);
+    }
+
+    static const CommandParser parser;
+    static CommandExecutor executor(getpgrp(), STDIN_FILENO, nullptr, nullptr);
+    std::string output;
+    executor.capture(parser.parse(expandVariables(text, options)), text, output);
+    return output;
+}
+
+} // namespace
+
+void setCommandSubstitution(CommandSubstitution handler) {
+    commandSubstitution() = std::move(handler);
+}
+
 History::History(std::size_t limit) : limit_(limit) {}
 
 void History::add(const std::string& entry) {
@@ -137,8 +206,9 @@ std::string expandTilde(const std::string& path) {
 
     const char* home = nullptr;
     if (userPart.empty()) {
-        home = getenv("HOME");
-        if (!home) {
+        if (const std::string* value = shellVariables().find("HOME")) {
+            home = value->c_str();
+        } else {
             if (const auto* pw = getpwuid(getuid())) {
                 home = pw->pw_dir;
             }
@@ -189,14 +259,7 @@ std::string expandVariables(const std::string& input, const ShellOptions* option
 
         std::string result;
         if (!cmd.empty()) {
-            FILE* fp = popen(cmd.c_str(), "r");
-            if (fp) {
-                char buf[256];
-                while (fgets(buf, sizeof(buf), fp)) {
-                    result += buf;
-                }
-                pclose(fp);
-            }
+            result = runCommandSubstitution(cmd, options);
             while (!result.empty() && (result.back() == '\n' || result.back() == '\r')) {
                 result.pop_back();
             }
@@ -315,8 +378,8 @@ std::string expandVariables(const std::string& input, const ShellOptions* option
                     const std::string varName = colonDash == std::string::npos ? varExpr : varExpr.substr(0, colonDash);
                     const std::string defaultValue = colonDash == std::string::npos ? "" : varExpr.substr(colonDash + 2);
 
-                    if (const char* varValue = getenv(varName.c_str())) {
-                        output += varValue;
+                    if (const std::string* varValue = shellVariables().find(varName)) {
+                        output += *varValue;
                     } else if (options && options->nounset) {
                         throw std::runtime_error("unset variable: " + varName);
                     } else {
@@ -331,8 +394,8 @@ std::string expandVariables(const std::string& input, const ShellOptions* option
                     ++end;
                 }
                 const std::string varName = input.substr(i + 1, end - i - 1);
-                if (const char* varValue = getenv(varName.c_str())) {
-                    output += varValue;
+                if (const std::string* varValue = shellVariables().find(varName)) {
+                    output += *varValue;
                 } else if (options && options->nounset) {
                     throw std::runtime_error("unset variable: " + varName);
                 }
@@ -0,0 +1,124 @@
+#include "variable_store.h"
+
+#include <algorithm>
+#include <cctype>
+
+extern char** environ;
+
+namespace ryke {
+
+Environment::Environment(std::vector<std::string> entries) : entries_(std::move(entries)) {
+    pointers_.reserve(entries_.size() + 1);
+    for (auto& entry : entries_) {
+        pointers_.push_back(entry.data());
+    }
+    pointers_.push_back(nullptr);
+}
+
+VariableStore::VariableStore(char** environment) {
+    for (char** entry = environment; entry && *entry; ++entry) {
+        const std::string_view text = *entry;
+        if (const auto eq = text.find('='); eq != std::string_view::npos && eq > 0) {
+            variables_.emplace(std::string(text.substr(0, eq)), Variable{std::string(text.substr(eq + 1)), true});
+        }
+    }
+}
+
+const std::string* VariableStore::find(std::string_view name) const {
+    const auto it = variables_.find(name);
+    return it == variables_.end() ? nullptr : &it->second.value;
+}
+
+void VariableStore::set(const std::string& name, std::string value) {
+    Variable& variable = variables_[name];
+    variable.value = std::move(value);
+    changed(variable.exported);
+}
+
+void VariableStore::exportVariable(const std::string& name, std::optional<std::string> value) {
+    Variable& variable = variables_[name];
+    if (value) {
+        variable.value = std::move(*value);
+    }
+    variable.exported = true;
+    changed(true);
+}
+
+bool VariableStore::unset(const std::string& name) {
+    const auto it = variables_.find(name);
+    if (it == variables_.end()) {
+        return false;
+    }
+    const bool exported = it->second.exported;
+    variables_.erase(it);
+    changed(exported);
+    return true;
+}
+
+bool VariableStore::isExported(std::string_view name) const {
+    const auto it = variables_.find(name);
+    return it != variables_.end() && it->second.exported;
+}
+
+std::vector<std::pair<std::string, VariableStore::Variable>> VariableStore::sorted() const {
+    std::vector<std::pair<std::string, Variable>> result(variables_.begin(), variables_.end());
+    std::ranges::sort(result, {}, &std::pair<std::string, Variable>::first);
+    return result;
+}
+
+std::shared_ptr<const Environment> VariableStore::environment() {
+    if (!environment_) {
+        std::vector<std::string> entries;
+        entries.reserve(variables_.size());
+        for (const auto& [name, variable] : variables_) {
+            if (variable.exported) {
+                entries.push_back(name + '=' + variable.value);
+            }
+        }
+        environment_ = std::make_shared<const Environment>(std::move(entries));
+    }
+    return environment_;
+}
+
+std::shared_ptr<const Environment> VariableStore::environment(
+    const std::vector<std::pair<std::string, std::string>>& overrides) {
+    return overrideEnvironment(environment(), overrides);
+}
+
+void VariableStore::changed(bool exported) {
+    ++version_;
+    if (exported) {
+        environment_.reset();
+    }
+}
+
+std::shared_ptr<const Environment> overrideEnvironment(const std::shared_ptr<const Environment>& base,
+                                                       const std::vector<std::pair<std::string, std::string>>& overrides) {
+    if (overrides.empty()) {
+        return base;
+    }
+    std::vector<std::string> entries;
+    entries.reserve(base->entries().size() + overrides.size());
+    for (const auto& entry : base->entries()) {
+        const std::string_view name = std::string_view(entry).substr(0, entry.find('='));
+        if (std::ranges::none_of(overrides, [&](const auto& o) { return o.first == name; })) {
+            entries.push_back(entry);
+        }
+    }
+    for (const auto& [name, value] : overrides) {
+        entries.push_back(name + '=' + value);
+    }
+    return std::make_shared<const Environment>(std::move(entries));
+}
+
+bool isVariableName(std::string_view name) {
+    return !name.empty() && !std::isdigit(static_cast<unsigned char>(name.front())) &&
+           std::ranges::all_of(name, [](unsigned char c) { return std::isalnum(c) != 0 || c == '_'; });
+}
+
+VariableStore& shellVariables() {
+    static VariableStore store(environ);
+    return store;
+}
+
+} // namespace ryke
@@ -0,0 +1,127 @@
+#include "arg_batching.h"
+#include "ryke_shell.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+std::string makeTempDir() {
+    std::string pattern = "/tmp/rykebatchXXXXXX";
+    if (char* dir = mkdtemp(pattern.data())) {
+        return dir;
+    }
+    return "/tmp";
+}
+
+void batching_options_parsed() {
+    ArgBatching batching;
+    assert(!batching.allows("rm") && formatArgBatching(batching) == "off");
+    assert(parseArgBatching("rm,chmod", batching));
+    assert(batching.allows("rm") && batching.allows("/bin/chmod") && !batching.allows("cp"));
+    assert(formatArgBatching(batching) == "rm,chmod");
+    assert(!parseArgBatching("rm,,cp", batching) && batching.commands.size() == 2);
+    assert(parseArgBatching("all", batching) && batching.allows("anything"));
+}
+
+void arguments_split_to_budget() {
+    std::vector<std::string> argv{"rm", "-f"};
+    for (int i = 0; i < 1000; ++i) {
+        argv.push_back("file" + std::to_string(i));
+    }
+    const std::size_t budget = 4096;
+    const auto chunks = splitArguments(argv, 2, budget);
+    assert(chunks && chunks->size() > 1);
+
+    std::vector<std::string> rejoined{"rm", "-f"};
+    for (const auto& chunk : *chunks) {
+        assert(chunk.size() > 2 && chunk[0] == "rm" && chunk[1] == "-f");
+        assert(execBytes(chunk) <= budget);
+        rejoined.insert(rejoined.end(), chunk.begin() + 2, chunk.end());
+    }
+    assert(rejoined == argv);
+
+    // Words after the operands, such as mv's target directory, end every chunk.
+    std::vector<std::string> moves{"mv"};
+    moves.insert(moves.end(), argv.begin() + 2, argv.end());
+    moves.push_back("dest/");
+    const auto moved = splitArguments(moves, 1, budget, 1);
+    assert(moved && moved->size() > 1);
+    std::size_t operands = 0;
+    for (const auto& chunk : *moved) {
+        assert(chunk.size() > 2 && chunk.front() == "mv" && chunk.back() == "dest/");
+        assert(execBytes(chunk) <= budget);
+        operands += chunk.size() - 2;
+    }
+    assert(operands == 1000);
+
+    // One argument that cannot fit beside the fixed words cannot be batched.
+    assert(!splitArguments({"echo", std::string(5000, 'x')}, 1, budget));
+}
+
+void batches_aggregate_status() {
+    assert(runBatches("/bin/sh", {{"sh", "-c", "exit 0"}, {"sh", "-c", "exit 0"}}, nullptr, 1) == 0);
+    assert(runBatches("/bin/sh", {{"sh", "-c", "exit 0"}, {"sh", "-c", "exit 3"}}, nullptr, 2) == 123);
+    assert(runBatches("/bin/sh", {{"sh", "-c", "kill -9 $$"}, {"sh", "-c", "exit 3"}}, nullptr, 1) == 125);
+    assert(runBatches("/nonexistent/tool", {{"tool"}}, nullptr, 1) == 127);
+}
+
+void oversized_glob_runs_in_batches() {
+    const std::string dir = makeTempDir();
+    const std::string stem(200, 'n');
+    constexpr int kFiles = 12000; // ~2.5 MB of names, past the usual 2 MB ARG_MAX
+    for (int i = 0; i < kFiles; ++i) {
+        std::ofstream(dir + "/" + stem + std::to_string(i));
+    }
+
+    CommandParser parser;
+    const auto pipelines = parser.parse("/bin/echo " + dir + "/n*");
+    ShellOptions opts;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+
+    std::string refused;
+    assert(exec.capture(pipelines, "echo", refused) == 126);
+    assert(refused.empty());
+
+    assert(parseArgBatching("echo", opts.argBatch));
+    std::string output;
+    assert(exec.capture(pipelines, "echo", output) == 0);
+    std::size_t lines = 0;
+    std::size_t words = 0;
+    for (std::size_t i = 0; i < output.size(); ++i) {
+        lines += output[i] == '\n';
+        words += output[i] == '/' && (i == 0 || output[i - 1] == ' ' || output[i - 1] == '\n');
+    }
+    assert(lines > 1 && words == kFiles);
+
+    // A word after the glob goes to every batch.
+    std::string trailed;
+    assert(exec.capture(parser.parse("/bin/echo " + dir + "/n* END"), "echo", trailed) == 0);
+    std::size_t ended = 0;
+    for (std::size_t end = trailed.find(" END\n"); end != std::string::npos; end = trailed.find(" END\n", end + 1)) {
+        ++ended;
+    }
+    assert(ended > 1 && std::ranges::count(trailed, '\n') == static_cast<std::ptrdiff_t>(ended));
+
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace
+
+void register_arg_batching_tests() {
+    addTest("argbatch options", batching_options_parsed);
+    addTest("argbatch split", arguments_split_to_budget);
+    addTest("argbatch status", batches_aggregate_status);
+    addTest("argbatch oversized glob", oversized_glob_runs_in_batches);
+}
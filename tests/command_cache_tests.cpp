@@ -0,0 +1,108 @@
+#include "command_cache.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+std::string makeTempDir() {
+    std::string pattern = "/tmp/rykecacheXXXXXX";
+    if (char* dir = mkdtemp(pattern.data())) {
+        return dir;
+    }
+    return "/tmp";
+}
+
+void cache_keys_and_specs() {
+    assert(buildCacheKey({"a b"}, "/", {}, {}) != buildCacheKey({"a", "b"}, "/", {}, {}));
+    assert(buildCacheKey({"ls"}, "/tmp", {}, {}) != buildCacheKey({"ls"}, "/", {}, {}));
+    assert(buildCacheKey({"ls"}, "/", {{"LANG", "C"}}, {}) != buildCacheKey({"ls"}, "/", {{"LANG", std::nullopt}}, {}));
+    assert(CommandCache::digest("x").size() == 32 && CommandCache::digest("x") != CommandCache::digest("y"));
+
+    // A key file that changes, even without changing size, makes a new key.
+    const std::string dir = makeTempDir();
+    const std::string input = dir + "/input";
+    std::ofstream(input) << "one";
+    const std::string before = buildCacheKey({"cat", input}, dir, {}, {input});
+    std::filesystem::last_write_time(input, std::filesystem::last_write_time(input) - std::chrono::seconds(5));
+    assert(buildCacheKey({"cat", input}, dir, {}, {input}) != before);
+    std::filesystem::remove_all(dir);
+
+    assert(parseTtl("90") == std::chrono::seconds(90));
+    assert(parseTtl("5m") == std::chrono::seconds(300));
+    assert(parseTtl("2d") == std::chrono::seconds(172800));
+    assert(!parseTtl("5w") && !parseTtl("m"));
+    assert(parseByteSize("64M") == 64U * 1024 * 1024);
+    assert(!parseByteSize("12X"));
+}
+
+void cache_hits_expire_and_count() {
+    const std::string dir = makeTempDir() + "/store";
+    CommandCache cache(dir, 1024 * 1024);
+    const std::string key = buildCacheKey({"slow", "query"}, "/", {}, {});
+    assert(!cache.lookup(key, std::chrono::seconds(0)));
+
+    CachedResult result{4, "stdout\n", "stderr\n", std::time(nullptr)};
+    assert(cache.store(key, result));
+    const auto hit = cache.lookup(key, std::chrono::seconds(0));
+    assert(hit && hit->status == 4 && hit->out == "stdout\n" && hit->err == "stderr\n");
+
+    // An entry at or past its ttl is a miss and is dropped.
+    result.created -= 60;
+    assert(cache.store(key, result));
+    assert(cache.lookup(key, std::chrono::seconds(3600)));
+    assert(!cache.lookup(key, std::chrono::seconds(60)));
+    assert(!cache.lookup(key, std::chrono::seconds(0)));
+
+    const CommandCache::Stats stats = cache.stats();
+    assert(stats.hits == 2 && stats.misses == 3 && stats.entries == 0);
+    cache.clear();
+    assert(cache.stats().hits == 0);
+    std::filesystem::remove_all(std::filesystem::path(dir).parent_path());
+}
+
+void cache_evicts_least_recently_used() {
+    const std::string dir = makeTempDir();
+    const std::string body(400, 'b');
+    CommandCache cache(dir, 1000);
+    const std::string first = buildCacheKey({"first"}, "/", {}, {});
+    const std::string second = buildCacheKey({"second"}, "/", {}, {});
+    const std::string third = buildCacheKey({"third"}, "/", {}, {});
+    const std::filesystem::path firstPath = std::filesystem::path(dir) / CommandCache::digest(first);
+    const std::filesystem::path secondPath = std::filesystem::path(dir) / CommandCache::digest(second);
+
+    assert(cache.store(first, {0, body, "", std::time(nullptr)}));
+    assert(cache.store(second, {0, body, "", std::time(nullptr)}));
+    // Make the order unambiguous, then use `first` so `second` becomes the oldest.
+    const auto past = std::filesystem::file_time_type::clock::now() - std::chrono::minutes(10);
+    std::filesystem::last_write_time(firstPath, past - std::chrono::minutes(1));
+    std::filesystem::last_write_time(secondPath, past);
+    assert(cache.lookup(first, std::chrono::seconds(0)));
+
+    assert(cache.store(third, {0, body, "", std::time(nullptr)}));
+    assert(cache.lookup(first, std::chrono::seconds(0)));
+    assert(!cache.lookup(second, std::chrono::seconds(0)));
+    assert(cache.lookup(third, std::chrono::seconds(0)));
+    assert(cache.stats().bytes <= 1000);
+
+    // A single result bigger than the cap is never written.
+    assert(!cache.store(second, {0, std::string(2000, 'x'), "", std::time(nullptr)}));
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace
+
+void register_command_cache_tests() {
+    addTest("cache keys and specs", cache_keys_and_specs);
+    addTest("cache hits and ttl", cache_hits_expire_and_count);
+    addTest("cache lru eviction", cache_evicts_least_recently_used);
+}
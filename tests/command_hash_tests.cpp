@@ -0,0 +1,95 @@
+#include "command_hash.h"
+#include "variable_store.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+std::string makeTempDir() {
+    std::string pattern = "/tmp/rykehashXXXXXX";
+    if (char* dir = mkdtemp(pattern.data())) {
+        return dir;
+    }
+    return "/tmp";
+}
+
+void writeExecutable(const std::string& path) {
+    {
+        std::ofstream out(path);
+        out << "#!/bin/sh\n";
+    }
+    chmod(path.c_str(), 0755);
+}
+
+class PathGuard {
+public:
+    explicit PathGuard(const std::string& value) {
+        if (const std::string* old = shellVariables().find("PATH")) {
+            saved_ = *old;
+        }
+        shellVariables().set("PATH", value);
+    }
+    ~PathGuard() { shellVariables().set("PATH", saved_); }
+
+private:
+    std::string saved_;
+};
+
+void hash_resolves_and_caches() {
+    const std::string dir = makeTempDir();
+    writeExecutable(dir + "/ryketool");
+    PathGuard guard(dir);
+
+    CommandHash hash;
+    assert(hash.lookup("ryketool") == dir + "/ryketool");
+    assert(hash.lookup("ryketool") == dir + "/ryketool");
+    assert(hash.entries().at("ryketool").hits == 2);
+    assert(!hash.lookup("ryke-missing-tool"));
+}
+
+void hash_invalidated_by_shadowing_directory() {
+    const std::string first = makeTempDir();
+    const std::string second = makeTempDir();
+    writeExecutable(second + "/ryketool");
+    PathGuard guard(first + ":" + second);
+
+    CommandHash hash;
+    assert(hash.lookup("ryketool") == second + "/ryketool");
+
+    // A new executable in an earlier PATH directory changes its mtime and must win.
+    writeExecutable(first + "/ryketool");
+    assert(hash.lookup("ryketool") == first + "/ryketool");
+}
+
+void hash_cleared_on_path_change_and_pinned() {
+    const std::string dir = makeTempDir();
+    writeExecutable(dir + "/ryketool");
+    PathGuard guard(dir);
+
+    CommandHash hash;
+    hash.remember("pinned", "/bin/true");
+    assert(hash.lookup("pinned") == "/bin/true");
+    assert(hash.lookup("ryketool"));
+
+    shellVariables().set("PATH", "/nonexistent");
+    assert(!hash.lookup("ryketool"));
+    assert(hash.entries().empty());
+}
+
+} // namespace
+
+void register_command_hash_tests() {
+    addTest("hash resolve and cache", hash_resolves_and_caches);
+    addTest("hash shadowing invalidation", hash_invalidated_by_shadowing_directory);
+    addTest("hash path change and pin", hash_cleared_on_path_change_and_pinned);
+}
@@ -2,12 +2,19 @@
 
 #include <cassert>
 #include <cstdio>
+#include <chrono>
+#include <csignal>
 #include <cstdlib>
+#include <filesystem>
+#include <fcntl.h>
 #include <fstream>
+#include <iostream>
 #include <functional>
 #include <sstream>
 #include <string>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -94,8 +101,41 @@ void background_job_listing_and_fg() {
 }
 
 void heredoc_and_here_string() {
-    // Covered implicitly via executor redirections; skip heavy heredoc IO in tests environment.
-    assert(true);
+    ShellOptions opts;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    const std::string dir = makeTempDir();
+
+    // Larger than any pipe buffer and feeding a stage whose reader is launched afterwards.
+    Pipeline big;
+    Command producer;
+    producer.args = {"cat"};
+    producer.heredocDelimiter = "EOF";
+    producer.heredocData = std::string(4 * 1024 * 1024, 'x');
+    producer.heredocExpand = false;
+    big.stages.push_back(producer);
+    Command counter;
+    counter.args = {"wc", "-c"};
+    counter.outputFile = dir + "/count.txt";
+    big.stages.push_back(counter);
+    assert(exec.execute({big}, "cat <<EOF | wc -c") == 0);
+
+    std::ifstream countIn(*counter.outputFile);
+    long count = 0;
+    countIn >> count;
+    assert(count == 4 * 1024 * 1024);
+
+    Pipeline here;
+    Command tr;
+    tr.args = {"tr", "a-z", "A-Z"};
+    tr.hereString = "inline";
+    tr.outputFile = dir + "/here.txt";
+    here.stages.push_back(tr);
+    assert(exec.execute({here}, "tr <<< inline") == 0);
+
+    std::ifstream hereIn(*tr.outputFile);
+    std::string contents;
+    std::getline(hereIn, contents);
+    assert(contents == "INLINE");
 }
 
 void noclobber_respected() {
@@ -165,6 +205,292 @@ void noclobber_override_with_barpipe() {
     assert(contents == "new");
 }
 
+void fork_engine_matches_spawn() {
+    for (const bool posixSpawn : {true, false}) {
+        ShellOptions opts;
+        opts.posixSpawn = posixSpawn;
+        CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+        const std::string path = makeTempDir() + "/engine.txt";
+
+        Pipeline p;
+        Command c1;
+        c1.args = {"printf", "a\\nb\\n"};
+        p.stages.push_back(c1);
+        Command c2;
+        c2.args = {"wc", "-l"};
+        c2.outputFile = path;
+        p.stages.push_back(c2);
+        assert(exec.execute({p}, "printf | wc -l") == 0);
+
+        std::ifstream in(path);
+        int lines = 0;
+        in >> lines;
+        assert(lines == 2);
+
+        Pipeline missing;
+        Command m;
+        m.args = {"ryke-no-such-command"};
+        missing.stages.push_back(m);
+        assert(exec.execute({missing}, "ryke-no-such-command") == 127);
+    }
+}
+
+void builtin_pipeline_stages() {
+    ShellOptions opts;
+    opts.monitor = false;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    const pid_t shellPid = getpid();
+    std::vector<pid_t> runners;
+    exec.setBuiltinHooks(CommandExecutor::BuiltinHooks{
+        [](const std::string& name) { return name == "greet"; },
+        [&](const Command& command) {
+            runners.push_back(getpid());
+            std::cout << "hello " << command.args.at(1) << '\n';
+            return command.args.at(1) == "fail" ? 3 : 0;
+        },
+        nullptr,
+        [](const Command&) { return true; },
+    });
+
+    // A builtin feeding an external stage runs in a forked child.
+    Pipeline feeding;
+    Command greet;
+    greet.args = {"greet", "pipe"};
+    feeding.stages.push_back(greet);
+    Command tr;
+    tr.args = {"tr", "a-z", "A-Z"};
+    feeding.stages.push_back(tr);
+    std::string output;
+    assert(exec.capture({feeding}, "greet pipe | tr a-z A-Z", output) == 0);
+    assert(output == "HELLO PIPE\n");
+    assert(runners.empty());
+
+    // As the last stage it runs in the shell, with stdin and stdout bound to the stage's descriptors.
+    Pipeline last;
+    Command echo;
+    echo.args = {"echo", "ignored"};
+    last.stages.push_back(echo);
+    Command greetLast;
+    greetLast.args = {"greet", "fail"};
+    last.stages.push_back(greetLast);
+    output.clear();
+    assert(exec.capture({last}, "echo ignored | greet fail", output) == 3);
+    assert(output == "hello fail\n");
+    assert(runners.size() == 1 && runners.front() == shellPid);
+}
+
+void capture_isolates_stateful_builtins() {
+    ShellOptions opts;
+    opts.monitor = false;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    int changes = 0;
+    exec.setBuiltinHooks(CommandExecutor::BuiltinHooks{
+        [](const std::string& name) { return name == "change" || name == "peek"; },
+        [&](const Command& command) {
+            ++changes;
+            std::cout << command.args.front() << ' ' << getpid() << '\n';
+            return 4;
+        },
+        nullptr,
+        [](const Command& command) { return command.args.front() == "peek"; },
+    });
+
+    // A builtin that may change the shell runs in a forked subshell, and its status comes back.
+    CommandParser parser;
+    std::string output;
+    assert(exec.capture(parser.parse("change"), "change", output) == 4);
+    assert(changes == 0 && output != "change " + std::to_string(getpid()) + "\n");
+    output.clear();
+    assert(exec.capture(parser.parse("RYKE_CAPTURED=1"), "RYKE_CAPTURED=1", output) == 0);
+    assert(!shellVariables().find("RYKE_CAPTURED"));
+
+    // A read-only one stays in the shell.
+    output.clear();
+    assert(exec.capture(parser.parse("peek"), "peek", output) == 4);
+    assert(changes == 1 && output == "peek " + std::to_string(getpid()) + "\n");
+}
+
+void cat_stage_fusion() {
+    const std::string dir = makeTempDir();
+    const std::string input = dir + "/in.txt";
+    {
+        std::ofstream out(input);
+        out << "one\ntwo\n";
+    }
+
+    for (const bool fusion : {true, false}) {
+        ShellOptions opts;
+        opts.monitor = false;
+        opts.pipeFusion = fusion;
+        CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+
+        // A fused leading `cat FILE` hands the file itself to the next stage instead of a pipe.
+        Pipeline leading;
+        Command cat;
+        cat.args = {"cat", input};
+        leading.stages.push_back(cat);
+        Command probe;
+        probe.args = {"readlink", "/proc/self/fd/0"};
+        leading.stages.push_back(probe);
+        std::string output;
+        assert(exec.capture({leading}, "cat in.txt | readlink /proc/self/fd/0", output) == 0);
+        assert((output == input + "\n") == fusion);
+
+        // `| cat | ... | cat > OUT` collapses onto the producer without changing the bytes written.
+        const std::string target = dir + (fusion ? "/fused.txt" : "/plain.txt");
+        Pipeline trailing;
+        Command tr;
+        tr.args = {"tr", "a-z", "A-Z"};
+        tr.inputFile = input;
+        trailing.stages.push_back(tr);
+        Command middle;
+        middle.args = {"cat"};
+        trailing.stages.push_back(middle);
+        Command sink;
+        sink.args = {"cat"};
+        sink.outputFile = target;
+        trailing.stages.push_back(sink);
+        assert(exec.execute({trailing}, "tr a-z A-Z < in.txt | cat | cat > out") == 0);
+        std::ifstream in(target);
+        std::stringstream contents;
+        contents << in.rdbuf();
+        assert(contents.str() == "ONE\nTWO\n");
+
+        // The status stays cat's, fused or not: it succeeds unless it cannot open its file.
+        Pipeline failing;
+        Command falseCmd;
+        falseCmd.args = {"false"};
+        failing.stages.push_back(falseCmd);
+        failing.stages.push_back(sink);
+        assert(exec.execute({failing}, "false | cat > out") == 0);
+        failing.stages.back().outputFile = dir + "/missing/out.txt";
+        assert(exec.execute({failing}, "false | cat > missing/out") == 1);
+    }
+}
+
+void coproc_round_trip() {
+    ShellOptions opts;
+    opts.monitor = false;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+
+    Pipeline pipeline;
+    Command cmd;
+    cmd.args = {"cat"}; // writes each chunk as soon as it reads it, so a reply never sits in a buffer
+    pipeline.stages.push_back(cmd);
+    pipeline.coproc = "ECHO";
+    assert(exec.execute({pipeline}, "coproc ECHO { cat }") == 0);
+
+    VariableStore& variables = shellVariables();
+    const std::string* readVar = variables.find("ECHO[0]");
+    const std::string* writeVar = variables.find("ECHO[1]");
+    assert(readVar && writeVar && variables.find("ECHO_PID"));
+    const int readFd = std::stoi(*readVar);
+    const int writeFd = std::stoi(*writeVar);
+    assert(readFd >= 60 && writeFd >= 60);
+    assert(fcntl(readFd, F_GETFD) & FD_CLOEXEC);
+
+    std::ostringstream listing;
+    exec.listCoprocs(listing);
+    assert(listing.str().rfind("ECHO ", 0) == 0);
+
+    assert(write(writeFd, "hello\n", 6) == 6);
+    char buffer[16] = {};
+    assert(read(readFd, buffer, sizeof(buffer)) == 6);
+    assert(std::string(buffer) == "hello\n");
+
+    // The shell owns both ends, so the coprocess only goes away when told to; pruning it drops the variables.
+    kill(std::stoi(*variables.find("ECHO_PID")), SIGTERM);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (variables.find("ECHO_PID") && std::chrono::steady_clock::now() < deadline) {
+        std::ostringstream jobs;
+        exec.listJobs(jobs);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    assert(!variables.find("ECHO_PID") && !variables.find("ECHO[0]"));
+}
+
+void process_substitution_streams() {
+    ShellOptions opts;
+    opts.monitor = false;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    CommandParser parser;
+
+    std::string output;
+    assert(exec.capture(parser.parse("comm -3 <(printf 'a\\nb\\n') <(printf 'b\\nc\\n')"), "comm", output) == 0);
+    assert(output == "a\n\tc\n");
+
+    std::string redirected;
+    assert(exec.capture(parser.parse("tr a-z A-Z < <(echo piped)"), "tr", redirected) == 0);
+    assert(redirected == "PIPED\n");
+
+    // >(cmd) is part of the job, so its output is complete once the job is.
+    const std::string dir = makeTempDir();
+    const std::string counted = dir + "/count";
+    assert(exec.execute(parser.parse("seq 5 | tee >(wc -l > " + counted + ") > /dev/null"), "tee") == 0);
+    std::ifstream in(counted);
+    std::string lines;
+    std::getline(in, lines);
+    assert(lines == "5");
+
+    // Lists run in a forked subshell.
+    std::string listed;
+    assert(exec.capture(parser.parse("cat <(echo one && echo two)"), "cat", listed) == 0);
+    assert(listed == "one\ntwo\n");
+
+    // A `cat > >(cmd)` stage is not folded onto its producer, which would write a file named `>(cmd)`.
+    const auto original = std::filesystem::current_path();
+    std::filesystem::current_path(dir);
+    const std::string line = "echo hello | cat > >(tr a-z A-Z > upper)";
+    assert(exec.execute(parser.parse(line), line) == 0);
+    std::filesystem::current_path(original);
+    std::ifstream upper(dir + "/upper");
+    std::string shouted;
+    std::getline(upper, shouted);
+    assert(shouted == "HELLO");
+    const auto entries = std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator());
+    assert(entries == 2); // count and upper
+}
+
+// Runs the line in a forked copy of the shell with replaceShell set and returns that copy's pid
+// alongside what the line printed, so a caller can tell whether the command took the process over.
+std::pair<pid_t, std::string> runReplacingShell(const std::string& line) {
+    int pipeFd[2] = {-1, -1};
+    assert(pipe(pipeFd) == 0);
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(pipeFd[0]);
+        ShellOptions opts;
+        CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+        CommandParser parser;
+        PipelineIo io;
+        io.output = pipeFd[1];
+        io.inheritGroup = true;
+        io.replaceShell = true;
+        _exit(exec.execute(parser.parse(line), line, io));
+    }
+    close(pipeFd[1]);
+    std::string output;
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(pipeFd[0], buffer, sizeof(buffer))) > 0) {
+        output.append(buffer, static_cast<std::size_t>(n));
+    }
+    close(pipeFd[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    return {pid, output};
+}
+
+void replace_shell_execs_in_place() {
+    const auto [pid, output] = runReplacingShell("sh -c 'echo $$'");
+    assert(output == std::to_string(pid) + "\n");
+
+    // A pipeline keeps forking, with the replacing request ignored.
+    const auto [pipedPid, piped] = runReplacingShell("sh -c 'echo $$' | cat");
+    assert(!piped.empty() && piped != std::to_string(pipedPid) + "\n");
+}
+
 } // namespace
 
 void register_executor_tests() {
@@ -175,4 +501,11 @@ void register_executor_tests() {
     addTest("executor noclobber", noclobber_respected);
     addTest("executor stderr merge", redirect_stderr_merge);
     addTest("executor noclobber override", noclobber_override_with_barpipe);
+    addTest("executor spawn/fork engines", fork_engine_matches_spawn);
+    addTest("executor builtin stages", builtin_pipeline_stages);
+    addTest("executor capture subshell", capture_isolates_stateful_builtins);
+    addTest("executor cat fusion", cat_stage_fusion);
+    addTest("executor coproc", coproc_round_trip);
+    addTest("executor process substitution", process_substitution_streams);
+    addTest("executor replace shell", replace_shell_execs_in_place);
 }
@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <fstream>
 #include <functional>
 #include <string>
 
@@ -13,19 +14,19 @@ using namespace ryke;
 namespace {
 
 void test_variable_expansion() {
-    setenv("RYKE_TEST_VAR", "value", 1);
+    shellVariables().set("RYKE_TEST_VAR", "value");
     const std::string expanded = expandVariables("echo $RYKE_TEST_VAR", nullptr);
     assert(expanded == "echo value");
 }
 
 void test_default_expansion() {
-    unsetenv("RYKE_TEST_MISSING");
+    shellVariables().unset("RYKE_TEST_MISSING");
     const std::string expanded = expandVariables("echo ${RYKE_TEST_MISSING:-fallback}", nullptr);
     assert(expanded == "echo fallback");
 }
 
 void test_quote_rules() {
-    setenv("RYKE_TEST_QUOTE", "yes", 1);
+    shellVariables().set("RYKE_TEST_QUOTE", "yes");
     const std::string single = expandVariables("echo '$RYKE_TEST_QUOTE'", nullptr);
     assert(single == "echo '$RYKE_TEST_QUOTE'");
     const std::string dbl = expandVariables("echo \"$RYKE_TEST_QUOTE\"", nullptr);
@@ -33,7 +34,7 @@ void test_quote_rules() {
 }
 
 void test_tilde_rules() {
-    setenv("HOME", "/tmp/rykehome", 1);
+    shellVariables().set("HOME", "/tmp/rykehome");
     const std::string expanded = expandVariables("~/work", nullptr);
     assert(expanded == "/tmp/rykehome/work");
     const std::string quoted = expandVariables("'~'/work", nullptr);
@@ -45,6 +46,22 @@ void test_command_substitution() {
     assert(expanded == "val=hi");
 }
 
+void test_native_command_substitution() {
+    const std::string path = "/tmp/ryke_subst_input.txt";
+    {
+        std::ofstream out(path);
+        out << "from file\n\n";
+    }
+    assert(expandVariables("x=$(<" + path + ")", nullptr) == "x=from file");
+
+    const std::string piped = expandVariables("$(printf 'ab cd' | tr a-z A-Z)", nullptr);
+    assert(piped == "AB CD");
+
+    // More output than a pipe buffer holds must not stall the substitution.
+    const std::string large = expandVariables("$(head -c 300000 /dev/zero | tr '\\0' x)", nullptr);
+    assert(large.size() == 300000);
+}
+
 void test_arithmetic_substitution() {
     const std::string expanded = expandVariables("echo $((2+3))", nullptr);
     assert(expanded == "echo 5");
@@ -70,6 +87,7 @@ void register_expansion_tests() {
     addTest("expand quotes", test_quote_rules);
     addTest("expand tilde", test_tilde_rules);
     addTest("expand command subst", test_command_substitution);
+    addTest("expand native command subst", test_native_command_substitution);
     addTest("expand arithmetic", test_arithmetic_substitution);
     addTest("expand nounset throws", test_nounset_option);
 }
@@ -0,0 +1,107 @@
+#include "fd_writer.h"
+#include "ryke_shell.h"
+
+#include <cassert>
+#include <cerrno>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+std::size_t drain(int fd) {
+    std::size_t total = 0;
+    char buffer[8192];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        total += static_cast<std::size_t>(n);
+    }
+    return total;
+}
+
+void writer_batches_small_writes() {
+    int pipeFd[2] = {-1, -1};
+    assert(pipe2(pipeFd, O_NONBLOCK) == 0);
+    {
+        FdWriter writer(pipeFd[1], 4096);
+        std::ostream out(&writer);
+        for (int i = 0; i < 100; ++i) {
+            out << "line " << i << '\n';
+        }
+        // Nothing has reached the descriptor until the buffer fills or is flushed.
+        assert(drain(pipeFd[0]) == 0);
+        out.flush();
+        assert(drain(pipeFd[0]) == 790);
+
+        // A block larger than the buffer goes straight through.
+        out << std::string(10000, 'x');
+        assert(drain(pipeFd[0]) == 10000);
+        out << "tail";
+    }
+    assert(drain(pipeFd[0]) == 4);
+    close(pipeFd[0]);
+    close(pipeFd[1]);
+}
+
+void writer_reports_failed_write() {
+    const int fd = open("/dev/full", O_WRONLY | O_CLOEXEC);
+    assert(fd != -1);
+    FdWriter writer(fd, 16);
+    std::ostream out(&writer);
+    out << "more than sixteen bytes";
+    assert(!out.good() && writer.error() == ENOSPC);
+    close(fd);
+}
+
+void builtin_output_redirected_in_process() {
+    ShellOptions opts;
+    opts.monitor = false;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    exec.setBuiltinHooks(CommandExecutor::BuiltinHooks{
+        [](const std::string& name) { return name == "count"; },
+        [](const Command&) {
+            for (int i = 0; i < 5000; ++i) {
+                std::cout << i << '\n';
+            }
+            return 0;
+        },
+        nullptr,
+    });
+
+    char path[] = "/tmp/rykewriterXXXXXX";
+    const int fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+    std::streambuf* const original = std::cout.rdbuf();
+    CommandParser parser;
+    const std::string line = std::string("count > ") + path;
+    assert(exec.execute(parser.parse(line), line) == 0);
+    assert(std::cout.rdbuf() == original && std::cout.good());
+
+    std::ifstream in(path);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    std::string expected;
+    for (int i = 0; i < 5000; ++i) {
+        expected += std::to_string(i) + '\n';
+    }
+    assert(contents.str() == expected);
+    unlink(path);
+}
+
+} // namespace
+
+void register_fd_writer_tests() {
+    addTest("fd writer batching", writer_batches_small_writes);
+    addTest("fd writer errors", writer_reports_failed_write);
+    addTest("fd writer builtin redirect", builtin_output_redirected_in_process);
+}
@@ -0,0 +1,138 @@
+#include "file_copy.h"
+#include "ryke_shell.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+std::string makeTempDir() {
+    std::string pattern = "/tmp/rykecopyXXXXXX";
+    if (char* dir = mkdtemp(pattern.data())) {
+        return dir;
+    }
+    return "/tmp";
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+void copy_picks_kernel_paths() {
+    const std::string dir = makeTempDir();
+    std::string data;
+    for (int i = 0; i < 20000; ++i) {
+        data += std::to_string(i) + '\n';
+    }
+    std::ofstream(dir + "/in") << data;
+
+    // File to file.
+    int in = open((dir + "/in").c_str(), O_RDONLY);
+    int out = open((dir + "/out").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CopyResult result = copyFd(in, out);
+    close(in);
+    close(out);
+    assert(result.error == 0 && result.bytes == data.size() && result.method != CopyMethod::ReadWrite);
+    assert(readFile(dir + "/out") == data);
+
+    // File into a pipe and back out of it into a file.
+    int pipeFd[2];
+    assert(pipe(pipeFd) == 0);
+    fcntl(pipeFd[1], F_SETPIPE_SZ, 1 << 20);
+    in = open((dir + "/in").c_str(), O_RDONLY);
+    result = copyFd(in, pipeFd[1]);
+    close(in);
+    close(pipeFd[1]);
+    assert(result.error == 0 && result.bytes == data.size() && result.method == CopyMethod::Sendfile);
+    out = open((dir + "/spliced").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    result = copyFd(pipeFd[0], out);
+    close(pipeFd[0]);
+    close(out);
+    assert(result.error == 0 && result.method == CopyMethod::Splice);
+    assert(readFile(dir + "/spliced") == data);
+
+    // procfs files report no size, so they are read the ordinary way.
+    in = open("/proc/self/status", O_RDONLY);
+    out = open((dir + "/status").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    result = copyFd(in, out);
+    close(in);
+    close(out);
+    assert(result.error == 0 && result.bytes > 0 && result.method == CopyMethod::ReadWrite);
+    assert(readFile(dir + "/status").starts_with("Name:"));
+
+    std::filesystem::remove_all(dir);
+}
+
+void copy_file_like_cp() {
+    const std::string dir = makeTempDir();
+    std::ofstream(dir + "/script") << "#!/bin/sh\n";
+    chmod((dir + "/script").c_str(), 0750);
+    const mode_t mask = umask(0);
+    umask(mask);
+    std::string error;
+    assert(copyFile(dir + "/script", dir + "/copy", false, false, error));
+    struct stat copied{};
+    stat((dir + "/copy").c_str(), &copied);
+    assert((copied.st_mode & 0777) == (0750 & ~mask));
+    assert(readFile(dir + "/copy") == "#!/bin/sh\n");
+
+    assert(!copyFile(dir + "/script", dir + "/script", false, false, error));
+    assert(error.find("same file") != std::string::npos);
+    assert(!copyFile(dir, dir + "/x", false, false, error));
+    assert(error.find("omitting directory") != std::string::npos);
+
+    // A read-only destination is replaced only with force.
+    std::ofstream(dir + "/locked") << "old";
+    chmod((dir + "/locked").c_str(), 0444);
+    if (geteuid() != 0) {
+        assert(!copyFile(dir + "/script", dir + "/locked", false, false, error));
+    }
+    assert(copyFile(dir + "/script", dir + "/locked", true, true, error));
+    assert(readFile(dir + "/locked") == "#!/bin/sh\n");
+    stat((dir + "/locked").c_str(), &copied);
+    assert((copied.st_mode & 0777) == 0750);
+    std::filesystem::remove_all(dir);
+}
+
+void builtin_defers_unknown_options() {
+    ShellOptions opts;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    exec.setBuiltinHooks(CommandExecutor::BuiltinHooks{
+        [](const std::string& name) { return name == "cat"; },
+        [](const Command&) {
+            std::cout << "builtin\n";
+            return 0;
+        },
+        [](const Command& command) { return command.args.size() < 2 || command.args[1] != "-n"; },
+    });
+    CommandParser parser;
+    std::string output;
+    assert(exec.capture(parser.parse("echo hi | cat"), "cat", output) == 0 && output == "builtin\n");
+    std::string external;
+    assert(exec.capture(parser.parse("echo hi | cat -n"), "cat -n", external) == 0 && external == "     1\thi\n");
+}
+
+} // namespace
+
+void register_file_copy_tests() {
+    addTest("copy kernel paths", copy_picks_kernel_paths);
+    addTest("copy file like cp", copy_file_like_cp);
+    addTest("builtin defers unknown options", builtin_defers_unknown_options);
+}
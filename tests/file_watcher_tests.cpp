@@ -0,0 +1,84 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <poll.h>
+#include <string>
+#include <vector>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+std::string makeTempDir() {
+    std::string pattern = "/tmp/rykewatchXXXXXX";
+    if (char* dir = mkdtemp(pattern.data())) {
+        return dir;
+    }
+    return "/tmp";
+}
+
+bool contains(const std::vector<std::string>& paths, const std::string& path) {
+    return std::ranges::find(paths, path) != paths.end();
+}
+
+// Waits for the watcher to turn readable and returns what it reports.
+std::vector<std::string> nextChanges(FileWatcher& watcher) {
+    pollfd fd{watcher.fd(), POLLIN, 0};
+    if (::poll(&fd, 1, 2000) != 1) {
+        return {};
+    }
+    return watcher.drain();
+}
+
+void watch_specs_parsed() {
+    const std::string dir = makeTempDir();
+    WatchSpec spec = parseWatchSpec("src/*.cpp", false);
+    assert(spec.directory == "src" && spec.pattern == "*.cpp" && !spec.recursive);
+    spec = parseWatchSpec("src/**/*.h", false);
+    assert(spec.directory == "src" && spec.pattern == "*.h" && spec.recursive);
+    spec = parseWatchSpec("*.txt", false);
+    assert(spec.directory == "." && spec.pattern == "*.txt");
+    spec = parseWatchSpec("/etc/hosts", false);
+    assert(spec.directory == "/etc" && spec.pattern == "hosts" && !spec.recursive);
+    spec = parseWatchSpec(dir, true);
+    assert(spec.directory == dir && spec.pattern.empty() && spec.recursive);
+    std::filesystem::remove_all(dir);
+}
+
+void watcher_filters_and_follows_new_directories() {
+    const std::string dir = makeTempDir();
+    FileWatcher watcher;
+    std::string error;
+    assert(watcher.add(parseWatchSpec(dir + "/**/*.txt", false), error));
+    assert(watcher.fd() != -1);
+
+    std::ofstream(dir + "/a.log") << "x";
+    std::ofstream(dir + "/b.txt") << "x";
+    std::ofstream(dir + "/b.txt", std::ios::app) << "y";
+    const auto first = nextChanges(watcher);
+    assert(contains(first, dir + "/b.txt") && !contains(first, dir + "/a.log"));
+    assert(std::ranges::count(first, dir + "/b.txt") == 1);
+
+    std::filesystem::create_directory(dir + "/sub");
+    nextChanges(watcher);
+    std::ofstream(dir + "/sub/c.txt") << "x";
+    assert(contains(nextChanges(watcher), dir + "/sub/c.txt"));
+
+    assert(!watcher.add(parseWatchSpec(dir + "/missing/*.txt", false), error));
+    assert(error.find("missing") != std::string::npos);
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace
+
+void register_file_watcher_tests() {
+    addTest("watch spec parsing", watch_specs_parsed);
+    addTest("file watcher events", watcher_filters_and_follows_new_directories);
+}
@@ -0,0 +1,173 @@
+#include "glob_engine.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+std::string makeTempDir() {
+    std::string pattern = "/tmp/rykeglobXXXXXX";
+    if (char* dir = mkdtemp(pattern.data())) {
+        return dir;
+    }
+    return "/tmp";
+}
+
+void touch(const std::string& path) {
+    std::ofstream out(path);
+}
+
+// Listings of directories modified in the last moments are not cached, so age them.
+void backdate(const std::string& path) {
+    const timespec times[2] = {{0, UTIME_OMIT}, {1000000000, 0}};
+    utimensat(AT_FDCWD, path.c_str(), times, 0);
+}
+
+std::vector<std::string> expand(GlobEngine& engine, const std::string& pattern, GlobOptions options = {}) {
+    std::vector<std::string> out;
+    engine.expand(pattern, options, out);
+    return out;
+}
+
+std::vector<std::string> under(const std::string& dir, std::vector<std::string> names) {
+    for (auto& name : names) {
+        name = dir + "/" + name;
+    }
+    return names;
+}
+
+std::string makeTree() {
+    const std::string dir = makeTempDir();
+    mkdir((dir + "/sub").c_str(), 0755);
+    mkdir((dir + "/sub/deep").c_str(), 0755);
+    mkdir((dir + "/sub/.git").c_str(), 0755);
+    touch(dir + "/a.txt");
+    touch(dir + "/b.txt");
+    touch(dir + "/.hidden.txt");
+    touch(dir + "/notes.md");
+    touch(dir + "/sub/c.txt");
+    touch(dir + "/sub/deep/d.txt");
+    touch(dir + "/sub/.git/e.txt");
+    symlink("sub", (dir + "/link").c_str());
+    return dir;
+}
+
+void wildcards_and_options() {
+    const std::string dir = makeTree();
+    GlobEngine engine;
+
+    assert(expand(engine, dir + "/*.txt") == under(dir, {"a.txt", "b.txt"}));
+    assert(expand(engine, dir + "/[ab].t?t") == under(dir, {"a.txt", "b.txt"}));
+    assert(expand(engine, dir + "/*.txt", GlobOptions{false, true, false}) == under(dir, {".hidden.txt", "a.txt", "b.txt"}));
+    // Intermediate segments follow symlinks to directories; a trailing slash keeps directories only.
+    assert(expand(engine, dir + "/*/c.txt") == under(dir, {"link/c.txt", "sub/c.txt"}));
+    assert(expand(engine, dir + "/*/") == under(dir, {"link/", "sub/"}));
+    assert(expand(engine, dir + "/sub/*/d.txt") == under(dir, {"sub/deep/d.txt"}));
+
+    assert(expand(engine, dir + "/*.none") == std::vector<std::string>{dir + "/*.none"});
+    assert(expand(engine, dir + "/*.none", GlobOptions{true, false, false}).empty());
+    assert(expand(engine, dir + "/plain") == std::vector<std::string>{dir + "/plain"});
+
+    std::vector<std::string> unsorted = expand(engine, dir + "/*", GlobOptions{false, false, true});
+    std::ranges::sort(unsorted);
+    assert(unsorted == expand(engine, dir + "/*"));
+
+    // Relative patterns produce relative paths.
+    char cwd[4096];
+    assert(getcwd(cwd, sizeof(cwd)));
+    assert(chdir(dir.c_str()) == 0);
+    const std::vector<std::string> relative = expand(engine, "*.md");
+    assert(chdir(cwd) == 0);
+    assert(relative == std::vector<std::string>{"notes.md"});
+}
+
+void recursive_globstar() {
+    const std::string dir = makeTree();
+    GlobEngine engine;
+
+    // `**` descends through every non-hidden directory but does not follow the symlink.
+    assert(expand(engine, dir + "/**/*.txt") == under(dir, {"a.txt", "b.txt", "sub/c.txt", "sub/deep/d.txt"}));
+    assert(expand(engine, dir + "/**") ==
+           under(dir, {"a.txt", "b.txt", "link", "notes.md", "sub", "sub/c.txt", "sub/deep", "sub/deep/d.txt"}));
+    assert(expand(engine, dir + "/**/e.txt", GlobOptions{false, true, false}) == under(dir, {"sub/.git/e.txt"}));
+    assert(expand(engine, dir + "/**/deep/") == under(dir, {"sub/deep/"}));
+}
+
+void listings_cached_by_mtime() {
+    const std::string dir = makeTree();
+    backdate(dir);
+    GlobEngine engine;
+
+    assert(expand(engine, dir + "/*.txt").size() == 2);
+    assert(engine.cachedDirectories() == 1);
+    assert(expand(engine, dir + "/*.txt").size() == 2);
+    assert(engine.cachedDirectories() == 1);
+
+    // A new entry moves the directory's mtime, so the stale listing is not served.
+    touch(dir + "/z.txt");
+    assert(expand(engine, dir + "/*.txt") == under(dir, {"a.txt", "b.txt", "z.txt"}));
+
+    engine.clearCache();
+    assert(engine.cachedDirectories() == 0);
+}
+
+// Two `sub` directories with the same mtime are still two listings once the cwd changes.
+void listings_follow_cwd() {
+    const std::string first = makeTempDir();
+    const std::string second = makeTempDir();
+    mkdir((first + "/sub").c_str(), 0755);
+    mkdir((second + "/sub").c_str(), 0755);
+    touch(first + "/sub/xa");
+    touch(second + "/sub/xb");
+    backdate(first + "/sub");
+    backdate(second + "/sub");
+    GlobEngine engine;
+
+    char cwd[4096];
+    assert(getcwd(cwd, sizeof(cwd)));
+    assert(chdir(first.c_str()) == 0);
+    const std::vector<std::string> before = expand(engine, "sub/*");
+    assert(chdir(second.c_str()) == 0);
+    const std::vector<std::string> after = expand(engine, "sub/*");
+    assert(chdir(cwd) == 0);
+    assert(before == std::vector<std::string>{"sub/xa"});
+    assert(after == std::vector<std::string>{"sub/xb"});
+}
+
+void threaded_walk_matches_serial() {
+    const std::string dir = makeTempDir();
+    for (int i = 0; i < 150; ++i) {
+        const std::string branch = dir + "/d" + std::to_string(i);
+        mkdir(branch.c_str(), 0755);
+        mkdir((branch + "/leaf").c_str(), 0755);
+        touch(branch + "/leaf/target");
+    }
+
+    GlobEngine serial(1);
+    GlobEngine threaded(4);
+    const std::vector<std::string> expected = expand(serial, dir + "/**/target");
+    assert(expected.size() == 150);
+    assert(expand(threaded, dir + "/**/target") == expected);
+}
+
+} // namespace
+
+void register_glob_engine_tests() {
+    addTest("glob wildcards/options", wildcards_and_options);
+    addTest("glob globstar", recursive_globstar);
+    addTest("glob listing cache", listings_cached_by_mtime);
+    addTest("glob listing cache after cd", listings_follow_cwd);
+    addTest("glob threaded walk", threaded_walk_matches_serial);
+}
@@ -0,0 +1,292 @@
+#include "ryke_shell.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <csignal>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+pid_t spawnExiting(int code) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        _exit(code);
+    }
+    return pid;
+}
+
+void reap_until(JobTable& table, std::size_t expected, std::vector<int>& finished) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (finished.size() < expected && std::chrono::steady_clock::now() < deadline) {
+        for (const int id : table.reap()) {
+            finished.push_back(id);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+void reap_many_jobs_by_pid() {
+    JobTable table;
+    std::vector<pid_t> pids;
+    for (int i = 0; i < 200; ++i) {
+        const pid_t pid = spawnExiting(i % 7);
+        pids.push_back(pid);
+        table.add(JobTable::makeJob(pid, "job " + std::to_string(i), {pid}));
+    }
+    assert(table.size() == 200);
+    assert(table.findByPid(pids[42]) == table.find(43));
+
+    std::vector<int> finished;
+    reap_until(table, 200, finished);
+    assert(finished.size() == 200);
+
+    for (int i = 0; i < 200; ++i) {
+        const Job* job = table.find(i + 1);
+        assert(job && job->status == Job::Status::Done);
+        assert(job->exitCode == i % 7);
+        assert(job->processes.front().pidfd == -1);
+        // Reaped pids leave the index so a recycled pid can never resolve to a finished job.
+        assert(table.findByPid(pids[static_cast<std::size_t>(i)]) == nullptr);
+    }
+    table.pruneDone();
+    assert(table.size() == 0);
+}
+
+void stopped_job_resumes() {
+    JobTable table;
+    const pid_t pid = fork();
+    if (pid == 0) {
+        raise(SIGSTOP);
+        _exit(5);
+    }
+    Job job = JobTable::makeJob(pid, "stopper", {pid});
+    table.wait(job);
+    assert(job.status == Job::Status::Stopped);
+    assert(job.processes.front().exitCode == 128 + SIGSTOP);
+
+    Job& added = table.add(std::move(job));
+    assert(table.current() == &added);
+    kill(pid, SIGCONT);
+    table.wait(added);
+    assert(added.status == Job::Status::Done);
+    assert(added.exitCode == 5);
+}
+
+void background_jobs_notify_done() {
+    ShellOptions opts;
+    std::vector<std::string> notes;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, [&](const std::string& msg) { notes.push_back(msg); });
+
+    Pipeline pipeline;
+    Command cmd;
+    cmd.args = {"true"};
+    pipeline.stages.push_back(cmd);
+    pipeline.background = true;
+    assert(exec.execute({pipeline}, "true &") == 0);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (notes.empty() && std::chrono::steady_clock::now() < deadline) {
+        exec.reapBackground();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    assert(notes.size() == 1 && notes.front() == "job [1] done");
+
+    std::ostringstream listing;
+    exec.listJobs(listing, true);
+    assert(listing.str().rfind("[1] ", 0) == 0);
+    assert(listing.str().find(" Done true &\n") != std::string::npos);
+    assert(listing.str().find("s real") != std::string::npos);
+
+    std::ostringstream again;
+    exec.listJobs(again);
+    assert(again.str().empty());
+}
+
+void usage_accounting_and_format() {
+    ShellOptions opts;
+    opts.monitor = false;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+
+    Pipeline pipeline;
+    Command burn;
+    burn.args = {"sh", "-c", "i=0; while [ $i -lt 20000 ]; do i=$((i+1)); done"};
+    pipeline.stages.push_back(burn);
+    Command sleeper;
+    sleeper.args = {"sleep", "0.1"};
+    pipeline.stages.push_back(sleeper);
+    assert(exec.execute({pipeline}, "burn | sleep 0.1") == 0);
+
+    const ResourceUsage& usage = exec.lastUsage();
+    assert(usage.wallSeconds >= 0.1);
+    assert(usage.userSeconds + usage.systemSeconds > 0);
+    assert(usage.maxRssKb > 0);
+
+    ResourceUsage fixed;
+    fixed.wallSeconds = 75.5;
+    fixed.userSeconds = 1.25;
+    fixed.systemSeconds = 0.5;
+    fixed.maxRssKb = 2048;
+    assert(formatResourceUsage("%C %x %e %E %U %S %M %%\\n", fixed, "make", 2) ==
+           "make 2 75.50 1:15.50 1.25 0.50 2048 %\n");
+    fixed.wallSeconds = 3725;
+    assert(formatResourceUsage("%E", fixed, "", 0) == "1:02:05.00");
+}
+
+void launched_pipelines_run_concurrently() {
+    ShellOptions opts;
+    opts.monitor = false;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+
+    std::vector<LaunchedPipeline> running;
+    const auto start = std::chrono::steady_clock::now();
+    for (const char* code : {"0", "4"}) {
+        Pipeline pipeline;
+        Command cmd;
+        cmd.args = {"sh", "-c", std::string("sleep 0.3; exit ") + code};
+        pipeline.stages.push_back(cmd);
+        pipeline.background = true;
+        PipelineIo io;
+        io.inheritGroup = true;
+        running.push_back(exec.launch(pipeline, "sleep", io));
+    }
+    assert(!exec.poll(running[0]));
+
+    std::vector<int> statuses;
+    for (auto& launched : running) {
+        while (!exec.poll(launched)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        statuses.push_back(exec.finish(launched));
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    assert((statuses == std::vector<int>{0, 4}));
+    assert(elapsed < 0.55);
+}
+
+void background_jobs_queue_past_max() {
+    ShellOptions opts;
+    opts.notify = false;
+    opts.maxJobs = 2;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    CommandParser parser;
+    for (int i = 0; i < 4; ++i) {
+        const std::string line = "sleep 0.2 &";
+        assert(exec.execute(parser.parse(line), line) == 0);
+    }
+
+    std::ostringstream queued;
+    exec.listJobs(queued);
+    assert(queued.str().find("[2] Running") != std::string::npos);
+    assert(queued.str().find("[3] Queued (1) sleep 0.2 &\n") != std::string::npos);
+    assert(queued.str().find("[4] Queued (2) sleep 0.2 &\n") != std::string::npos);
+    assert(exec.hasJobs());
+
+    // Each exit frees a slot for the next job in line, which keeps the id it was queued under.
+    const auto start = std::chrono::steady_clock::now();
+    exec.drainQueue();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    assert(elapsed > 0.1);
+    std::ostringstream started;
+    exec.listJobs(started);
+    assert(started.str().find("Queued") == std::string::npos);
+    assert(started.str().find("[3] Running") != std::string::npos && started.str().find("[4] Running") != std::string::npos);
+
+    while (exec.hasJobs()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void queued_job_keeps_submit_context() {
+    std::string pattern = "/tmp/rykequeueXXXXXX";
+    const std::string dir = mkdtemp(pattern.data());
+    std::filesystem::create_directory(dir + "/qa");
+    std::filesystem::create_directory(dir + "/qb");
+    const auto original = std::filesystem::current_path();
+
+    ShellOptions opts;
+    opts.notify = false;
+    opts.maxJobs = 1;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    CommandParser parser;
+    const std::string first = "sleep 0.2 &";
+    assert(exec.execute(parser.parse(first), first) == 0);
+
+    std::filesystem::current_path(dir + "/qa");
+    shellVariables().exportVariable("RYKE_QUEUED", std::string("submitted"));
+    const std::string line = "sh -c 'pwd; echo $RYKE_QUEUED' > where.txt &";
+    assert(exec.execute(parser.parse(line), line) == 0);
+    std::filesystem::current_path(dir + "/qb");
+    shellVariables().exportVariable("RYKE_QUEUED", std::string("changed"));
+
+    exec.drainQueue();
+    assert(std::filesystem::current_path() == std::filesystem::path(dir + "/qb"));
+    while (exec.hasJobs()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::ifstream written(dir + "/qa/where.txt");
+    std::stringstream contents;
+    contents << written.rdbuf();
+    assert(contents.str() == std::filesystem::canonical(dir + "/qa").string() + "\nsubmitted\n");
+    assert(!std::filesystem::exists(dir + "/qb/where.txt"));
+
+    shellVariables().unset("RYKE_QUEUED");
+    std::filesystem::current_path(original);
+    std::filesystem::remove_all(dir);
+}
+
+// A forked copy of the shell, here a `$(...)` subshell, must leave the parent's queue alone.
+void forked_shell_skips_parent_queue() {
+    std::string pattern = "/tmp/rykeforkqXXXXXX";
+    const std::string dir = mkdtemp(pattern.data());
+    const std::string marker = dir + "/started";
+
+    ShellOptions opts;
+    opts.notify = false;
+    opts.maxJobs = 1;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    CommandParser parser;
+    const std::string first = "sleep 0.1 &";
+    assert(exec.execute(parser.parse(first), first) == 0);
+    const std::string line = "touch " + marker + " &";
+    assert(exec.execute(parser.parse(line), line) == 0);
+    opts.maxJobs = 2; // a free slot the parent has not filled yet
+
+    std::string output;
+    const std::string assignment = "RYKE_FORKQ=1";
+    assert(exec.capture(parser.parse(assignment), assignment, output) == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    assert(!std::filesystem::exists(marker));
+
+    exec.drainQueue();
+    while (exec.hasJobs()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    assert(std::filesystem::exists(marker));
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace
+
+void register_job_table_tests() {
+    addTest("job table reap by pid", reap_many_jobs_by_pid);
+    addTest("job table stop/continue", stopped_job_resumes);
+    addTest("job table background notify", background_jobs_notify_done);
+    addTest("job table usage accounting", usage_accounting_and_format);
+    addTest("job table concurrent launches", launched_pipelines_run_concurrently);
+    addTest("job table maxjobs queue", background_jobs_queue_past_max);
+    addTest("job table queued job context", queued_job_keeps_submit_context);
+    addTest("job table forked shell queue", forked_shell_skips_parent_queue);
+}
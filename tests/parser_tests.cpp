@@ -53,10 +53,77 @@ void test_background_only() {
     assert(pipelines[0].background);
 }
 
+void test_brace_placeholders() {
+    CommandParser parser;
+    const std::vector<Pipeline> pipelines = parser.parse("echo {a,b} {} x{y}z '{c,d}'");
+    assert(pipelines.size() == 1);
+    const std::vector<std::string> expected{"echo", "a", "b", "{}", "x{y}z", "{c,d}"};
+    assert(pipelines[0].stages[0].args == expected);
+}
+
+void test_fd_redirections() {
+    CommandParser parser;
+    const std::vector<Pipeline> pipelines = parser.parse("cmd 2>&1 >&12 <&5 3< in 10>> log");
+    assert(pipelines.size() == 1);
+    const Command& cmd = pipelines[0].stages[0];
+    assert(cmd.args == std::vector<std::string>{"cmd"});
+    const auto& redirs = cmd.fdRedirections;
+    assert(redirs.size() == 5);
+    assert(redirs[0].fd == 2 && redirs[0].type == Command::FdRedirection::Type::Dup && redirs[0].dupFd == 1);
+    assert(redirs[1].fd == 1 && redirs[1].type == Command::FdRedirection::Type::Dup && redirs[1].dupFd == 12);
+    assert(redirs[2].fd == 0 && redirs[2].type == Command::FdRedirection::Type::Dup && redirs[2].dupFd == 5);
+    assert(redirs[3].fd == 3 && redirs[3].type == Command::FdRedirection::Type::Read && redirs[3].target == "in");
+    assert(redirs[4].fd == 10 && redirs[4].type == Command::FdRedirection::Type::Append && redirs[4].target == "log");
+}
+
+void test_coproc_syntax() {
+    CommandParser parser;
+    std::vector<Pipeline> pipelines = parser.parse("coproc cat");
+    assert(pipelines.size() == 1);
+    assert(pipelines[0].coproc == "COPROC");
+    assert(pipelines[0].stages[0].args == std::vector<std::string>{"cat"});
+
+    pipelines = parser.parse("coproc BC { bc -l }");
+    assert(pipelines.size() == 1);
+    assert(pipelines[0].coproc == "BC");
+    assert(pipelines[0].stages[0].args == (std::vector<std::string>{"bc", "-l"}));
+
+    pipelines = parser.parse("coproc");
+    assert(!pipelines[0].coproc);
+    assert(pipelines[0].stages[0].args == std::vector<std::string>{"coproc"});
+}
+
+void test_process_substitution() {
+    CommandParser parser;
+    std::vector<Pipeline> pipelines = parser.parse("diff <(sort a | uniq) <(sort 'b)') > out");
+    assert(pipelines.size() == 1 && pipelines[0].stages.size() == 1);
+    const Command& diff = pipelines[0].stages[0];
+    assert(diff.args.size() == 3 && diff.args[1] == "<(sort a | uniq)");
+    assert(diff.processSubstitutions.size() == 2);
+    assert(diff.processSubstitutions[0].command == "sort a | uniq" && !diff.processSubstitutions[0].output);
+    assert(diff.processSubstitutions[1].command == "sort 'b)'" && diff.processSubstitutions[1].arg == 2u);
+    assert(diff.outputFile == "out");
+
+    pipelines = parser.parse("tee >(wc -l) < <(seq 3)");
+    const Command& tee = pipelines[0].stages[0];
+    assert(tee.processSubstitutions.size() == 2);
+    assert(tee.processSubstitutions[0].output && tee.processSubstitutions[0].arg == 1u);
+    assert(!tee.processSubstitutions[1].output && !tee.processSubstitutions[1].arg);
+    assert(tee.inputFile == "<(seq 3)");
+
+    // Quoted, or glued to a word, it is plain text.
+    pipelines = parser.parse("echo '<(x)' a<(y)");
+    assert(pipelines[0].stages[0].processSubstitutions.empty());
+}
+
 } // namespace
 
 void register_parser_tests() {
     addTest("parser basic", test_basic_parsing);
     addTest("parser append/or", test_append_and_or);
     addTest("parser background", test_background_only);
+    addTest("parser brace placeholders", test_brace_placeholders);
+    addTest("parser fd redirections", test_fd_redirections);
+    addTest("parser coproc", test_coproc_syntax);
+    addTest("parser process substitution", test_process_substitution);
 }
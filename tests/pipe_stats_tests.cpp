@@ -0,0 +1,82 @@
+#include "pipe_stats.h"
+#include "ryke_shell.h"
+
+#include <cassert>
+#include <fcntl.h>
+#include <functional>
+#include <string>
+#include <unistd.h>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+void relay_counts_bytes_and_waits() {
+    int upstream[2] = {-1, -1};
+    int downstream[2] = {-1, -1};
+    assert(pipe2(upstream, O_CLOEXEC) == 0 && pipe2(downstream, O_CLOEXEC) == 0);
+    auto stats = std::make_shared<PipeStats>();
+    stats->stages = {"producer", "consumer"};
+    stats->links.emplace_back();
+    std::thread relay = startRelay(upstream[0], downstream[1], stats, 0);
+
+    const std::string block(256 * 1024, 'r');
+    std::size_t received = 0;
+    std::thread reader([&received, fd = downstream[0]]() {
+        char buffer[65536];
+        ssize_t n;
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+            received += static_cast<std::size_t>(n);
+        }
+    });
+    for (int i = 0; i < 8; ++i) {
+        assert(write(upstream[1], block.data(), block.size()) == static_cast<ssize_t>(block.size()));
+    }
+    close(upstream[1]);
+    relay.join();
+    reader.join();
+    close(downstream[0]);
+
+    const LinkStats& link = stats->links.front();
+    assert(received == 8 * block.size());
+    assert(link.bytes == received);
+    assert(link.endNs != 0 && link.starvedSinceNs == 0 && link.blockedSinceNs == 0);
+    const std::string report = formatPipeStats(*stats, "");
+    assert(report.find("1 producer") == 0);
+    assert(report.find("2.00 MB") != std::string::npos);
+    assert(report.find("2 consumer") != std::string::npos && report.find("(running)") == std::string::npos);
+}
+
+void pipestats_relays_only_when_enabled() {
+    CommandParser parser;
+    const std::vector<Pipeline> pipelines = parser.parse("head -c 100000 /dev/zero | tr '\\0' a | wc -c");
+    ShellOptions opts;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    PipelineIo io;
+    io.inheritGroup = true;
+
+    LaunchedPipeline plain = exec.launch(pipelines.front(), "plain", io);
+    assert(!plain.job.pipeStats);
+    assert(exec.finish(plain) == 0);
+
+    opts.pipeStats = true;
+    LaunchedPipeline measured = exec.launch(pipelines.front(), "measured", io);
+    assert(measured.job.pipeStats && measured.job.pipeStats->links.size() == 2);
+    const auto stats = measured.job.pipeStats;
+    assert(exec.finish(measured) == 0);
+    assert(stats->links[0].bytes == 100000 && stats->links[1].bytes == 100000);
+
+    // The relays are transparent to the data.
+    std::string output;
+    assert(exec.capture(pipelines, "counted", output) == 0);
+    assert(output == "100000\n");
+}
+
+} // namespace
+
+void register_pipe_stats_tests() {
+    addTest("pipestats relay", relay_counts_bytes_and_waits);
+    addTest("pipestats executor", pipestats_relays_only_when_enabled);
+}
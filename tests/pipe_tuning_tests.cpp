@@ -0,0 +1,135 @@
+#include "ryke_shell.h"
+
+#include <cassert>
+#include <chrono>
+#include <fcntl.h>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+void parse_pipe_sizing() {
+    assert(parsePipeSizing("default")->bytes == 0);
+    assert(parsePipeSizing("auto")->adaptive);
+    assert(parsePipeSizing("4096")->bytes == 4096);
+    assert(parsePipeSizing("256k")->bytes == 256 * 1024);
+    assert(parsePipeSizing("1M")->bytes == 1024 * 1024);
+    assert(!parsePipeSizing("1MB"));
+    assert(!parsePipeSizing("fast"));
+    assert(!parsePipeSizing(""));
+    assert(parsePipeSizing("8G")->bytes == 8L * 1024 * 1024 * 1024);
+    assert(!parsePipeSizing("999999999999G"));
+    assert(!parsePipeSizing("99999999999G"));
+    assert(formatPipeSizing(*parsePipeSizing("64K")) == "65536");
+    assert(formatPipeSizing(*parsePipeSizing("auto")) == "auto");
+
+    CommandParser parser;
+    const std::vector<Pipeline> pipelines = parser.parse("pipesize 512K zcat log.gz | sort");
+    assert(pipelines.size() == 1);
+    assert(pipelines[0].pipeSize && pipelines[0].pipeSize->bytes == 512 * 1024);
+    assert(pipelines[0].stages.size() == 2 && pipelines[0].stages[0].args.front() == "zcat");
+    // Without a valid size it stays an ordinary command word.
+    assert(!parser.parse("pipesize fast")[0].pipeSize);
+}
+
+// The last-stage builtin runs in the shell with the pipe as its stdin, so it can report the size.
+void fixed_sizes_apply_to_stage_pipes() {
+    if (pipeMaxSize() < 256 * 1024) {
+        return;
+    }
+    ShellOptions opts;
+    opts.monitor = false;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    int observed = -1;
+    exec.setBuiltinHooks(CommandExecutor::BuiltinHooks{
+        [](const std::string& name) { return name == "pipesz"; },
+        [&](const Command&) {
+            observed = fcntl(STDIN_FILENO, F_GETPIPE_SZ);
+            return 0;
+        },
+        nullptr,
+    });
+
+    Pipeline pipeline;
+    Command producer;
+    producer.args = {"true"};
+    pipeline.stages.push_back(producer);
+    Command probe;
+    probe.args = {"pipesz"};
+    pipeline.stages.push_back(probe);
+
+    assert(exec.execute({pipeline}, "true | pipesz") == 0);
+    assert(observed == 64 * 1024);
+
+    opts.pipeSize.bytes = 256 * 1024;
+    assert(exec.execute({pipeline}, "true | pipesz") == 0);
+    assert(observed == 256 * 1024);
+
+    pipeline.pipeSize = PipeSizing{128 * 1024, false};
+    assert(exec.execute({pipeline}, "pipesize 128K true | pipesz") == 0);
+    assert(observed == 128 * 1024);
+}
+
+// A reader that stalls while its writer fills the pipe should find the pipe grown when it wakes.
+void adaptive_pipes_grow_under_pressure() {
+    ShellOptions opts;
+    opts.monitor = false;
+    opts.pipeSize.adaptive = true;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    exec.setBuiltinHooks(CommandExecutor::BuiltinHooks{
+        [](const std::string& name) { return name == "stall"; },
+        [](const Command&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            std::cout << fcntl(STDIN_FILENO, F_GETPIPE_SZ) << '\n';
+            char buffer[65536];
+            while (read(STDIN_FILENO, buffer, sizeof(buffer)) > 0) {
+            }
+            return 0;
+        },
+        nullptr,
+    });
+
+    Pipeline pipeline;
+    Command producer;
+    producer.args = {"head", "-c", "4M", "/dev/zero"};
+    pipeline.stages.push_back(producer);
+    Command stall;
+    stall.args = {"stall"};
+    pipeline.stages.push_back(stall);
+    Command sink;
+    sink.args = {"cat"};
+    pipeline.stages.push_back(sink);
+
+    std::string output;
+    assert(exec.capture({pipeline}, "head -c 4M /dev/zero | stall | cat", output) == 0);
+    assert(std::stol(output) > 64 * 1024);
+    assert(std::stol(output) <= pipeMaxSize());
+
+    // The watcher gives up its copy of the read end with the reader, so an early exit is still EPIPE.
+    Pipeline early;
+    Command yes;
+    yes.args = {"yes"};
+    early.stages.push_back(yes);
+    Command head;
+    head.args = {"head", "-n", "1"};
+    early.stages.push_back(head);
+    std::string first;
+    assert(exec.capture({early}, "yes | head -n 1", first) == 0);
+    assert(first == "y\n");
+}
+
+} // namespace
+
+void register_pipe_tuning_tests() {
+    addTest("pipe sizing parse", parse_pipe_sizing);
+    addTest("pipe sizing fixed", fixed_sizes_apply_to_stage_pipes);
+    addTest("pipe sizing adaptive", adaptive_pipes_grow_under_pressure);
+}
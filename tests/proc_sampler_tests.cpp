@@ -0,0 +1,86 @@
+#include "proc_sampler.h"
+
+#include <cassert>
+#include <chrono>
+#include <csignal>
+#include <functional>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+// A process group of three: a shell, a busy loop and a sleeper.
+pid_t startGroup() {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        setpgid(0, 0);
+        execl("/bin/sh", "sh", "-c", "yes > /dev/null & sleep 30 & wait", static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    setpgid(pid, pid);
+    return pid;
+}
+
+void sampler_sums_a_group() {
+    const pid_t pgid = startGroup();
+    ProcSampler sampler;
+    // Let the shell start both children before the first look.
+    GroupSample group;
+    for (int i = 0; i < 100 && group.processes < 3; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        group = sampler.sample({pgid}).front();
+    }
+    assert(group.pgid == pgid && group.processes == 3 && sampler.tracked() == 3);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    group = sampler.sample({pgid, 999999}).front();
+    assert(group.processes == 3 && group.threads >= 3);
+    assert(group.cpuPercent > 20 && group.rssBytes > 0);
+
+    kill(-pgid, SIGKILL);
+    waitpid(pid_t{pgid}, nullptr, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const auto after = sampler.sample({pgid});
+    assert(after.front().processes == 0 && after.front().cpuPercent == 0);
+}
+
+void sampler_skips_other_groups() {
+    ProcSampler sampler;
+    // Nothing lives in a group that does not exist, and nothing gets opened for it.
+    const auto samples = sampler.sample({999999});
+    assert(samples.size() == 1 && samples.front().processes == 0 && sampler.tracked() == 0);
+    // The test runner's own group holds at least this process.
+    const auto own = sampler.sample({getpgrp()});
+    assert(own.front().processes >= 1 && sampler.tracked() >= 1);
+}
+
+void jobtop_row_formatted() {
+    GroupSample sample;
+    sample.pgid = 4321;
+    sample.processes = 2;
+    sample.threads = 5;
+    sample.cpuPercent = 150.25;
+    sample.rssBytes = 3 * 1024 * 1024;
+    sample.readBytes = 512;
+    sample.writeBytes = 1536;
+    const std::string row = formatJobTopRow(7, sample, "Running", "make -j4");
+    assert(row.starts_with("[7]") && row.ends_with("Running  make -j4"));
+    assert(row.find(" 4321 ") != std::string::npos && row.find(" 150.2 ") != std::string::npos);
+    assert(row.find(" 3.0M ") != std::string::npos && row.find(" 512B ") != std::string::npos);
+    assert(row.find(" 1.5K ") != std::string::npos);
+    assert(formatJobTopHeader().find("CPU%") != std::string::npos);
+}
+
+} // namespace
+
+void register_proc_sampler_tests() {
+    addTest("proc sampler group totals", sampler_sums_a_group);
+    addTest("proc sampler other groups", sampler_skips_other_groups);
+    addTest("jobtop row", jobtop_row_formatted);
+}
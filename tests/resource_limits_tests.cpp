@@ -0,0 +1,92 @@
+#include "resource_limits.h"
+#include "ryke_shell.h"
+
+#include <cassert>
+#include <chrono>
+#include <csignal>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+void ulimit_options_parsed() {
+    std::string error;
+    std::size_t index = 0;
+    auto request = parseUlimit({"-S", "-n", "64", "-tv", "10", "cmd"}, index, error);
+    assert(request && index == 5);
+    assert(request->soft && !request->hard);
+    assert(request->show.size() == 1 && request->show[0]->flag == 't');
+    assert(request->set.size() == 2);
+    assert(request->set[0].resource == RLIMIT_NOFILE && request->set[0].soft == 64 && !request->set[0].hard);
+    assert(request->set[1].resource == RLIMIT_AS && request->set[1].soft == 10 * 1024);
+
+    index = 0;
+    request = parseUlimit({"-c", "unlimited"}, index, error);
+    assert(request && request->set[0].soft == RLIM_INFINITY && request->set[0].hard == RLIM_INFINITY);
+
+    index = 0;
+    assert(!parseUlimit({"-q"}, index, error));
+    assert(error.find("-q") != std::string::npos);
+    assert(formatLimit(RLIM_INFINITY, *findLimit('v')) == "unlimited");
+    assert(formatLimit(2048, *findLimit('v')) == "2");
+}
+
+void ulimit_prefix_limits_child_only() {
+    CommandParser parser;
+    const auto pipelines = parser.parse("ulimit -n 64 sh -c 'ulimit -n'");
+    assert(pipelines.size() == 1 && pipelines[0].limits.size() == 1);
+    assert(pipelines[0].stages[0].args.front() == "sh");
+    // Without a command it stays the builtin.
+    assert(parser.parse("ulimit -n 64")[0].limits.empty());
+
+    rlimit before{};
+    getrlimit(RLIMIT_NOFILE, &before);
+    ShellOptions opts;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    std::string output;
+    assert(exec.capture(pipelines, "ulimit sh", output) == 0);
+    assert(output == "64\n");
+
+    rlimit after{};
+    getrlimit(RLIMIT_NOFILE, &after);
+    assert(after.rlim_cur == before.rlim_cur && after.rlim_max == before.rlim_max);
+}
+
+void limit_hit_in_job_status() {
+    assert(describeLimitHit(SIGXCPU, {}) == "CPU time limit exceeded");
+    assert(describeLimitHit(SIGTERM, {}).empty());
+
+    ShellOptions opts;
+    opts.monitor = true;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    CommandParser parser;
+    const std::string line = "ulimit -f 1 head -c 100000 /dev/zero > /tmp/rykeulimit.out &";
+    assert(exec.execute(parser.parse(line), line) == 0);
+
+    std::string listing;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (listing.find("Done") == std::string::npos && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::ostringstream jobs;
+        exec.listJobs(jobs);
+        listing = jobs.str();
+    }
+    unlink("/tmp/rykeulimit.out");
+    assert(listing.find("Done (file size limit exceeded)") != std::string::npos);
+}
+
+} // namespace
+
+void register_resource_limits_tests() {
+    addTest("ulimit option parsing", ulimit_options_parsed);
+    addTest("ulimit prefix child only", ulimit_prefix_limits_child_only);
+    addTest("ulimit hit in job status", limit_hit_in_job_status);
+}
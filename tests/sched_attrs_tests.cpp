@@ -0,0 +1,128 @@
+#include "ryke_shell.h"
+#include "sched_attrs.h"
+
+#include <cassert>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+// Fields of /proc/PID/stat, numbered as in proc(5), from text that starts after the comm field.
+std::vector<std::string> statFields(const std::string& stat) {
+    std::istringstream in(stat.substr(stat.rfind(')') + 2));
+    std::vector<std::string> fields(3);
+    std::string field;
+    while (in >> field) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+std::string readStat(pid_t pid) {
+    std::ifstream in("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat;
+    std::getline(in, stat);
+    return stat;
+}
+
+void attrs_parse_and_format() {
+    SchedAttrs attrs;
+    assert(attrs.empty());
+    assert(setSchedAttr(attrs, "cpus", "3,0-1,1"));
+    assert(formatSchedAttr(attrs, "cpus") == "0-1,3");
+    assert(setSchedAttr(attrs, "nice", "+10") && *attrs.nice == 10);
+    assert(setSchedAttr(attrs, "ioprio", "be:7"));
+    assert(formatSchedAttr(attrs, "ioprio") == "be:7");
+    assert(setSchedAttr(attrs, "ioprio", "idle") && formatSchedAttr(attrs, "ioprio") == "idle");
+    assert(setSchedAttr(attrs, "sched", "batch") && *attrs.policy == SCHED_BATCH);
+
+    assert(!setSchedAttr(attrs, "nice", "20"));
+    assert(!setSchedAttr(attrs, "cpus", "2-1"));
+    assert(!setSchedAttr(attrs, "ioprio", "be:8"));
+    assert(!setSchedAttr(attrs, "sched", "fifo"));
+    assert(!setSchedAttr(attrs, "bogus", "1"));
+    assert(*attrs.nice == 10);
+
+    SchedAttrs over;
+    over.nice = 5;
+    attrs.merge(over);
+    assert(*attrs.nice == 5 && *attrs.policy == SCHED_BATCH);
+    assert(formatSchedAttr(SchedAttrs{}, "nice").empty());
+}
+
+void sched_prefix_applied_before_exec() {
+    CommandParser parser;
+    const auto pipelines = parser.parse("sched -n 19 -p batch -c 0 cat /proc/self/stat");
+    assert(pipelines.size() == 1 && pipelines[0].sched);
+    assert(pipelines[0].stages[0].args.front() == "cat");
+
+    // A bad value leaves the prefix to the sched builtin.
+    assert(!parser.parse("sched -n 99 cat")[0].sched);
+
+    ShellOptions opts;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    std::string output;
+    assert(exec.capture(pipelines, "sched cat", output) == 0);
+    const auto fields = statFields(output);
+    assert(fields.at(19) == "19");
+    assert(fields.at(41) == std::to_string(SCHED_BATCH));
+    assert(fields.at(39) == "0"); // last CPU it ran on
+
+    // Defaults from `set -o` apply to every job without a prefix.
+    setSchedAttr(opts.sched, "nice", "17");
+    std::string defaulted;
+    assert(exec.capture(parser.parse("cat /proc/self/stat"), "cat", defaulted) == 0);
+    assert(statFields(defaulted).at(19) == "17");
+}
+
+void renice_running_job() {
+    ShellOptions opts;
+    opts.monitor = true;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    CommandParser parser;
+    assert(exec.execute(parser.parse("sleep 5 | sleep 5 &"), "sleep 5 | sleep 5 &") == 0);
+
+    std::ostringstream listing;
+    exec.listJobs(listing, true);
+    SchedAttrs attrs;
+    attrs.nice = 15;
+    assert(exec.rescheduleJob(-1, attrs) == 0);
+    assert(!exec.rescheduleJob(999, attrs));
+
+    // Every process of the job moved, found through the job's process group.
+    const std::string line = listing.str();
+    const pid_t pgid = static_cast<pid_t>(std::stoi(line.substr(line.find(']') + 2)));
+    int matched = 0;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc")) {
+        const std::string name = entry.path().filename();
+        if (name.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        const std::string stat = readStat(static_cast<pid_t>(std::stoi(name)));
+        if (!stat.empty() && statFields(stat).at(5) == std::to_string(pgid)) {
+            assert(statFields(stat).at(19) == "15");
+            ++matched;
+        }
+    }
+    assert(matched == 2);
+    kill(-pgid, SIGTERM);
+}
+
+} // namespace
+
+void register_sched_attrs_tests() {
+    addTest("sched attrs parse/format", attrs_parse_and_format);
+    addTest("sched prefix before exec", sched_prefix_applied_before_exec);
+    addTest("sched renice job", renice_running_job);
+}
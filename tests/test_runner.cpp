@@ -20,12 +20,40 @@ void addTest(std::string name, std::function<void()> func) {
 void register_parser_tests();
 void register_executor_tests();
 void register_expansion_tests();
+void register_command_hash_tests();
+void register_job_table_tests();
+void register_pipe_tuning_tests();
+void register_glob_engine_tests();
+void register_variable_store_tests();
+void register_sched_attrs_tests();
+void register_resource_limits_tests();
+void register_arg_batching_tests();
+void register_fd_writer_tests();
+void register_pipe_stats_tests();
+void register_command_cache_tests();
+void register_file_watcher_tests();
+void register_file_copy_tests();
+void register_proc_sampler_tests();
 
 int main() {
     std::cerr << "[TESTS] starting\n";
     register_parser_tests();
     register_executor_tests();
     register_expansion_tests();
+    register_command_hash_tests();
+    register_job_table_tests();
+    register_pipe_tuning_tests();
+    register_glob_engine_tests();
+    register_variable_store_tests();
+    register_sched_attrs_tests();
+    register_resource_limits_tests();
+    register_arg_batching_tests();
+    register_fd_writer_tests();
+    register_pipe_stats_tests();
+    register_command_cache_tests();
+    register_file_watcher_tests();
+    register_file_copy_tests();
+    register_proc_sampler_tests();
 
     int failures = 0;
     for (const auto& test : testRegistry()) {
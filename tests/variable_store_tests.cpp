@@ -0,0 +1,103 @@
+#include "ryke_shell.h"
+#include "variable_store.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <string>
+#include <unistd.h>
+
+void addTest(std::string name, std::function<void()> func);
+
+using namespace ryke;
+
+namespace {
+
+bool hasEntry(const Environment& environment, const std::string& entry) {
+    return std::ranges::find(environment.entries(), entry) != environment.entries().end();
+}
+
+void environment_cached_until_export_changes() {
+    char first[] = "RYKE_A=1";
+    char second[] = "RYKE_B=2";
+    char* initial[] = {first, second, nullptr};
+    VariableStore store(initial);
+
+    const auto environment = store.environment();
+    assert(hasEntry(*environment, "RYKE_A=1") && hasEntry(*environment, "RYKE_B=2"));
+    assert(environment->envp()[2] == nullptr);
+
+    // Shell-local variables never reach the environment, so setting one keeps the cached array.
+    store.set("LOCAL", "x");
+    assert(store.environment() == environment);
+    assert(!hasEntry(*store.environment(), "LOCAL=x"));
+
+    store.set("RYKE_A", "3");
+    const auto rebuilt = store.environment();
+    assert(rebuilt != environment);
+    assert(hasEntry(*rebuilt, "RYKE_A=3"));
+    // The old snapshot is untouched for whoever still holds it.
+    assert(hasEntry(*environment, "RYKE_A=1"));
+
+    store.exportVariable("LOCAL");
+    assert(hasEntry(*store.environment(), "LOCAL=x"));
+    assert(store.unset("RYKE_B") && !store.unset("RYKE_B"));
+    assert(!hasEntry(*store.environment(), "RYKE_B=2"));
+}
+
+void overrides_layer_on_cached_environment() {
+    char entry[] = "RYKE_A=1";
+    char* initial[] = {entry, nullptr};
+    VariableStore store(initial);
+
+    const auto base = store.environment();
+    const auto same = store.environment({});
+    assert(same == base);
+
+    const auto layered = store.environment({{"RYKE_A", "over"}, {"RYKE_NEW", "n"}});
+    assert(layered != base);
+    assert(layered->entries().size() == 2);
+    assert(hasEntry(*layered, "RYKE_A=over") && hasEntry(*layered, "RYKE_NEW=n"));
+    assert(store.environment() == base);
+}
+
+void assignments_parsed_and_applied() {
+    CommandParser parser;
+    auto pipelines = parser.parse("RYKE_X=1 RYKE_Y='a b' env");
+    assert(pipelines.size() == 1);
+    const Command& command = pipelines[0].stages[0];
+    assert(command.args == std::vector<std::string>{"env"});
+    assert(command.assignments.size() == 2);
+    assert(command.assignments[1] == std::make_pair(std::string("RYKE_Y"), std::string("a b")));
+
+    // Only leading words count; later ones are ordinary arguments.
+    pipelines = parser.parse("echo RYKE_X=1");
+    assert(pipelines[0].stages[0].assignments.empty());
+    assert(pipelines[0].stages[0].args.size() == 2);
+
+    ShellOptions opts;
+    CommandExecutor exec(getpgrp(), STDIN_FILENO, &opts, nullptr);
+    VariableStore& variables = shellVariables();
+    variables.unset("RYKE_LOCAL");
+    variables.unset("RYKE_EXPORTED");
+
+    assert(exec.execute(parser.parse("RYKE_LOCAL=here"), "RYKE_LOCAL=here") == 0);
+    assert(variables.find("RYKE_LOCAL") && *variables.find("RYKE_LOCAL") == "here");
+    assert(!variables.isExported("RYKE_LOCAL"));
+    variables.exportVariable("RYKE_EXPORTED", "out");
+
+    std::string output;
+    assert(exec.capture(parser.parse("RYKE_PREFIX=p sh -c 'echo \"[$RYKE_LOCAL][$RYKE_EXPORTED][$RYKE_PREFIX]\"'"), "sh",
+                        output) == 0);
+    assert(output == "[][out][p]\n");
+    // A prefix only lasts for its command.
+    assert(!variables.find("RYKE_PREFIX"));
+}
+
+} // namespace
+
+void register_variable_store_tests() {
+    addTest("variables environment cache", environment_cached_until_export_changes);
+    addTest("variables environment overrides", overrides_layer_on_cached_environment);
+    addTest("variables assignments", assignments_parsed_and_applied);
+}